@@ -0,0 +1,30 @@
+#pragma once
+
+// Included by the C files generated by the recompiler, every opcode of cpu_ops.h becomes an inline
+// function taking its immediate operand as a constant so the host compiler can fold it.
+// The functions return whether a conditional CALL/RET was taken.
+
+#include "cpu.h"
+#include "machine.h"
+
+#undef CPU_IMM8
+#undef CPU_IMM16
+#define CPU_IMM8() ((uint8_t) imm)
+#define CPU_IMM16() (imm)
+
+#define CPU_OP(name, ...) \
+  static inline __attribute__((always_inline, unused)) uint8_t aot_##name(cpu_state *state, uint16_t imm) { \
+    uint8_t branch_taken = 0; \
+    (void) imm; \
+    __VA_ARGS__ \
+    return branch_taken; \
+  }
+#include "cpu_ops.h"
+#undef CPU_OP
+
+#undef CPU_IMM8
+#undef CPU_IMM16
+
+// A store into the running block leaves it, the interpreter continues from the next instruction
+#define AOT_CHECK_WRITE(start) \
+  if (!state->aot_cache->entries[start]) return
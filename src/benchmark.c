@@ -0,0 +1,128 @@
+#include "benchmark.h"
+
+#define BENCHMARK_CYCLES 500000000
+
+#if CPU_JIT
+#define ENGINE_NAME "jit"
+#elif CPU_DISPATCH == CPU_DISPATCH_THREADED
+#define ENGINE_NAME "threaded"
+#elif CPU_DISPATCH == CPU_DISPATCH_TAIL_CALL
+#define ENGINE_NAME "tail call"
+#elif CPU_DISPATCH == CPU_DISPATCH_BLOCK
+#define ENGINE_NAME "block"
+#elif CPU_DISPATCH == CPU_DISPATCH_AOT
+#define ENGINE_NAME "aot"
+#else
+#define ENGINE_NAME "switch"
+#endif
+
+#if CPU_LAZY_FLAGS_CHECK
+#define FLAGS_NAME "lazy check"
+#elif CPU_LAZY_FLAGS
+#define FLAGS_NAME "lazy"
+#else
+#define FLAGS_NAME "eager"
+#endif
+
+#if CPU_DISPATCH == CPU_DISPATCH_AOT
+extern const cpu_aot_image aot_image_invaders;
+extern const cpu_aot_image aot_image_cpudiag;
+
+void attach_aot_image(cpu_state *state, const cpu_aot_image *image) {
+  if (!cpu_attach_aot_image(state, image)) {
+    printf("ROM DOES NOT MATCH THE RECOMPILED IMAGE: %s\n", image->name);
+    exit(1);
+  }
+}
+#endif
+
+uint8_t run(cpu_state *state, uint64_t cycle_target) {
+  uint8_t reason = cpu_run(state, cycle_target);
+
+  if (reason == CPU_STOP_UNIMPLEMENTED) {
+    cpu_unimplemented_op_code(state, cpu_read_byte(state, state->pc));
+    exit(1);
+  }
+
+  return reason;
+}
+
+void print_result(char *name, cpu_state *state, clock_t start_time) {
+  double seconds = (double) (clock() - start_time) / CLOCKS_PER_SEC;
+  printf("%-10s %-11s %-12s %" PRIu64 " cycles in %.2f s | %.1f MHz\n", ENGINE_NAME, FLAGS_NAME, name,
+         state->cycles, seconds, state->cycles / seconds / 1000000.0);
+  cpu_print_block_cache_info(state);
+}
+
+void benchmark_invaders() {
+  uint32_t file_size;
+  char *file_buffer = benchmark_load_file("../roms/invaders.rom", 0, &file_size);
+
+  machine_state machine;
+  machine_init(&machine);
+  cpu_state state = cpu_init(&machine, file_buffer, file_size);
+  machine_map_memory(state.memory, machine_load_rom(state.memory->arena, (uint8_t *) file_buffer, file_size));
+  free(file_buffer);
+
+#if CPU_DISPATCH == CPU_DISPATCH_AOT
+  attach_aot_image(&state, &aot_image_invaders);
+#endif
+
+  // The screen interrupts of the board, from the scheduler like in the emulator
+  cpu_start_video(&state);
+  clock_t start_time = clock();
+
+  while (state.cycles < BENCHMARK_CYCLES) {
+    scheduler_run(&machine.scheduler, state.cycles);
+
+    if (state.interrupt) {
+      cpu_handle_interrupt(&state);
+    }
+
+    run(&state, scheduler_next(&machine.scheduler));
+  }
+
+  print_result("invaders.rom", &state, start_time);
+  cpu_destroy(&state);
+}
+
+void benchmark_cpudiag() {
+  uint32_t file_size;
+  char *file_buffer = benchmark_load_file("../roms/cpudiag.rom", 0x100, &file_size);
+
+  machine_state machine;
+  machine_init(&machine);
+  cpu_state state = cpu_init(&machine, file_buffer, file_size);
+  free(file_buffer);
+
+  // CP/M warm boot halts, BDOS calls return immediately
+  cpu_write_byte(&state, 0x0000, HLT);
+  cpu_write_byte(&state, 0x0005, RET);
+
+#if CPU_DISPATCH == CPU_DISPATCH_AOT
+  attach_aot_image(&state, &aot_image_cpudiag);
+#endif
+
+  clock_t start_time = clock();
+
+  while (state.cycles < BENCHMARK_CYCLES) {
+    state.pc = 0x100;
+    state.halted = 0;
+
+    // Runs to the warm boot HLT or the end of the benchmark
+    run(&state, BENCHMARK_CYCLES);
+  }
+
+  print_result("cpudiag.rom", &state, start_time);
+  cpu_destroy(&state);
+}
+
+int main() {
+  if (cpu_check_flag_tables()) {
+    return 1;
+  }
+
+  benchmark_invaders();
+  benchmark_cpudiag();
+  return 0;
+}
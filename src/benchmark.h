@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdio.h>
+#include <time.h>
+
+#include "cpu.h"
+#include "machine.h"
+
+// Shared by the benchmark tools, which run from the build directory with the ROMs in ../roms.
+
+// Frames of the scripted player: a coin goes in on the coin frame and start is pressed this many frames later
+#define BENCHMARK_COIN_FRAME 30
+#define BENCHMARK_START_DELAY 20
+#define BENCHMARK_PRESS_FRAMES 5
+
+// The whole file at offset in a zeroed buffer, file_size includes the offset
+static inline char *benchmark_load_file(const char *path, uint32_t offset, uint32_t *file_size) {
+  FILE *file = fopen(path, "rb");
+
+  if (!file) {
+    printf("FILE COULD NOT BE LOADED: %s\n", path);
+    exit(1);
+  }
+
+  fseek(file, 0, SEEK_END);
+  uint32_t size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+
+  char *file_buffer = calloc(offset + size, sizeof(char));
+  fread(file_buffer + offset, 1, size, file);
+  fclose(file);
+
+  *file_size = offset + size;
+  return file_buffer;
+}
+
+static inline double benchmark_wall_seconds(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Space Invaders played by script: coin and start around the coin frame, left, right and fire from a hash of step.
+// step is the frame unless keys are held for longer or every lane plays its own game
+static inline void benchmark_set_keys(machine_state *machine, uint32_t frame, uint32_t coin_frame, uint32_t step) {
+  uint32_t seed = step * 2654435761u;
+  uint32_t start_frame = coin_frame + BENCHMARK_START_DELAY;
+
+  machine_set_key(machine, KEY_COIN, frame >= coin_frame && frame < coin_frame + BENCHMARK_PRESS_FRAMES);
+  machine_set_key(machine, KEY_P1_START, frame >= start_frame && frame < start_frame + BENCHMARK_PRESS_FRAMES);
+  machine_set_key(machine, KEY_P1_LEFT, (seed >> 16) & 0x1);
+  machine_set_key(machine, KEY_P1_RIGHT, (seed >> 17) & 0x1);
+  machine_set_key(machine, KEY_P1_FIRE, (seed >> 18) & 0x1);
+}
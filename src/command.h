@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stdint.h>
+
+// Commands from the display thread to the emulation thread, in a ring with one producer and one consumer. The
+// producer only writes tail and the consumer only writes head, each on a cache line of its own, so neither side
+// takes a lock. The emulation thread drains the ring between slices of the CPU loop, which is the only place the
+// machine changes on behalf of another thread, and waits for the producer when it has nothing else to do.
+
+// A power of two, far more than a frame of input
+#define COMMAND_RING_SIZE 256
+
+enum CommandTypes {
+  // Key and 1 when pressed, 0 when released
+  COMMAND_KEY = 0x0,
+  // Opcode of the interrupt to raise
+  COMMAND_INTERRUPT = 0x1,
+  // 1 to pause, 0 to resume
+  COMMAND_PAUSE = 0x2,
+  COMMAND_QUIT = 0x3,
+  // Saves the machine to a file
+  COMMAND_SNAPSHOT = 0x4,
+  // 1 while rewind is held
+  COMMAND_REWIND = 0x5,
+};
+
+typedef struct {
+  // Host milliseconds when it was sent
+  uint32_t time;
+  uint8_t type;
+  uint8_t key;
+  uint8_t value;
+} command;
+
+typedef struct {
+  command commands[COMMAND_RING_SIZE];
+
+  // Next command to read, written by the consumer
+  __attribute__((aligned(64))) uint32_t head;
+  // Next slot to write and commands that found the ring full, written by the producer
+  __attribute__((aligned(64))) uint32_t tail;
+  uint32_t dropped;
+} command_ring;
+
+static inline void command_init(command_ring *ring) {
+  ring->head = 0;
+  ring->tail = 0;
+  ring->dropped = 0;
+}
+
+// 0 when the ring is full, the command is dropped then
+static inline uint8_t command_push(command_ring *ring, uint8_t type, uint8_t key, uint8_t value, uint32_t time) {
+  uint32_t tail = ring->tail;
+
+  if (tail - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == COMMAND_RING_SIZE) {
+    ring->dropped++;
+    return 0;
+  }
+
+  command *next = &ring->commands[tail % COMMAND_RING_SIZE];
+  next->time = time;
+  next->type = type;
+  next->key = key;
+  next->value = value;
+  __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+  return 1;
+}
+
+// Commands the consumer has not taken yet
+static inline uint32_t command_pending(command_ring *ring) {
+  return __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) - ring->head;
+}
+
+// 0 when the ring is empty
+static inline uint8_t command_pop(command_ring *ring, command *next) {
+  uint32_t head = ring->head;
+
+  if (head == __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE)) {
+    return 0;
+  }
+
+  *next = ring->commands[head % COMMAND_RING_SIZE];
+  __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+  return 1;
+}
@@ -1,1608 +1,1895 @@
-#include "cpu.h"
-#include "machine.h"
-
-uint32_t debug_step_counter = 0;
-
-uint16_t cpu_compose(uint8_t high_byte, uint8_t low_byte) {
-  uint16_t ret = 0;
-  ret += high_byte;
-  ret <<= 8;
-  ret += low_byte;
-  return ret;
-}
-
-void cpu_split(uint16_t byte, uint8_t *high_byte, uint8_t *low_byte) {
-  *high_byte = (byte & 0xFF00) >> 8;
-  *low_byte = byte & 0x00FF;
-}
-
-uint8_t cpu_get_psw(cpu_state *state) {
-  uint8_t res = 0;
-  res += state->flags.s << 7;
-  res += state->flags.z << 6;
-  res += state->flags.ac << 4;
-  res += state->flags.p << 2;
-  res += 1 << 1;
-  res += state->flags.c;
-
-  return res;
-}
-
-void cpu_set_psw(cpu_state *state, uint8_t psw) {
-  state->flags.s = psw >> 7 & 0x1;
-  state->flags.z = psw >> 6 & 0x1;
-  state->flags.ac = psw >> 4 & 0x1;
-  state->flags.p = psw >> 2 & 0x1;
-  state->flags.c = psw & 0x1;
-}
-
-void cpu_handle_z_flag(cpu_state *state, uint16_t res) {
-  state->flags.z = (res & 0xFF) == 0x00;
-}
-
-void cpu_handle_s_flag(cpu_state *state, uint16_t res) {
-  state->flags.s = (res & 0x80) == 0x80;
-}
-
-void cpu_handle_p_flag(cpu_state *state, uint16_t res) {
-  int32_t parity = 0;
-
-  res = (res & ((1 << 8) - 1));
-  for (int i = 0; i < 8; i++) {
-
-    if (res & 0x1) {
-      parity++;
-    }
-
-    res = res >> 1;
-  }
-
-  state->flags.p = (parity & 0x1) == 0;
-}
-
-void cpu_handle_c_flag(cpu_state *state, uint16_t res) {
-  state->flags.c = res > 0xFF;
-}
-
-void cpu_handle_ac_flag(cpu_state *state, uint16_t res) {
-  state->flags.ac = res > 0x09;
-}
-
-void cpu_handle_all_flags(cpu_state *state, uint16_t res) {
-  cpu_handle_z_flag(state, res);
-  cpu_handle_s_flag(state, res);
-  cpu_handle_p_flag(state, res);
-  cpu_handle_c_flag(state, res);
-  cpu_handle_ac_flag(state, res);
-}
-
-cpu_state cpu_init(char *file_data, uint32_t file_size) {
-  cpu_state state;
-
-  state.a = 0;
-  state.b = 0;
-  state.c = 0;
-  state.d = 0;
-  state.e = 0;
-  state.h = 0;
-  state.l = 0;
-
-  state.pc = 0;
-  state.sp = 0; // TODO: The last memory address
-
-  state.flags.ac = 0;
-  state.flags.c = 0;
-  state.flags.p = 0;
-  state.flags.s = 0;
-  state.flags.z = 0;
-
-  state.interrupt_enable = 0;
-  state.interrupt = 0;
-
-  state.memory = malloc(16 * 16 * 16 * 16);
-
-  memset(state.memory, 0, 16 * 16 * 16 * 16);
-  memcpy(state.memory, file_data, file_size * sizeof(char));
-
-  return state;
-}
-
-void cpu_destroy(cpu_state *state) {
-  free(state->memory);
-}
-
-void cpu_print_debug_info(cpu_state *state) {
-  printf(
-    "Registers: PC - 0x%04x | SP - 0x%04x | A - 0x%02x | B - 0x%02x | C - 0x%02x | D - 0x%02x | E - 0x%02x | H - 0x%02x | L - 0x%02x\n",
-    state->pc, state->sp, state->a, state->b, state->c, state->d, state->e, state->h, state->l);
-  printf("Flags: Z - %d | S - %d | P - %d | C - %d | AC - %d\n", state->flags.z, state->flags.s, state->flags.p,
-         state->flags.c, state->flags.ac);
-}
-
-void cpu_print_dump(cpu_state *state) {
-  FILE *dump = fopen("../dump", "wb");
-  fwrite(state->memory, 1, 16 * 16 * 16 * 16, dump);
-  fclose(dump);
-}
-
-void cpu_print_disassembled_op_code(cpu_state *state, uint8_t op_code) {
-  if (disassemble_byte_length[op_code] == 3) {
-    printf(disassemble_table[op_code], *(state->memory + state->pc + 1), *(state->memory + state->pc));
-  } else {
-    printf(disassemble_table[op_code], *(state->memory + state->pc));
-  }
-
-  printf("\n");
-}
-
-uint8_t cpu_fetch(cpu_state *state) {
-  return state->memory[state->pc++];
-}
-
-uint16_t cpu_fetch_address(cpu_state *state) {
-  uint8_t low_register = cpu_fetch(state);
-  uint8_t high_register = cpu_fetch(state);
-  return cpu_compose(high_register, low_register);
-}
-
-void cpu_set_interrupt(cpu_state *state, uint8_t op_code) {
-  if (state->interrupt_enable) {
-    state->interrupt = op_code;
-  }
-}
-
-void cpu_start_emulation(cpu_state *state) {
-  while (is_running) {
-    uint8_t op_code = 0;
-
-    if (state->interrupt) {
-      op_code = state->interrupt;
-      state->interrupt = 0;
-    } else {
-      op_code = cpu_fetch(state);
-    }
-
-    if (op_code == HLT) {
-      break;
-    }
-
-#if CPU_DEBUG
-    cpu_print_debug_info(state);
-    cpu_print_disassembled_op_code(state, op_code);
-#endif
-
-    cpu_emulate_op_code(state, op_code);
-
-#if CPU_DEBUG
-    cpu_print_debug_info(state);
-
-    if (debug_step_counter == 0) {
-      char c = getchar();
-      if (c == 'd') {
-        cpu_print_dump(state);
-      } else if (c == '1') {
-        cpu_set_interrupt(state, RST_1);
-      } else if (c == '2') {
-        cpu_set_interrupt(state, RST_2);
-      } else if (c == 's') {
-        debug_step_counter = 100;
-      } else if (c == 'm') {
-        debug_step_counter = 1000;
-      } else if(c == 'z') {
-        debug_step_counter = 10000;
-      }
-    } else {
-      debug_step_counter --;
-    }
-
-    printf("\n");
-#endif
-  }
-
-  is_running = 0;
-}
-
-void cpu_emulate_op_code(cpu_state *state, uint8_t op_code) {
-  uint8_t high_byte, low_byte;
-
-  switch (op_code) {
-    case NOP:
-      break;
-
-    case LXI_B:
-      cpu_execute_lxi(state, &state->b, &state->c);
-      break;
-
-    case STAX_B:
-      cpu_execute_stax(state, state->b, state->c);
-      break;
-
-    case INX_B:
-      cpu_execute_inx(&state->b, &state->c);
-      break;
-
-    case INR_B:
-      cpu_execute_inr(state, &state->b);
-      break;
-
-    case DCR_B:
-      cpu_execute_dcr(state, &state->b);
-      break;
-
-    case MVI_B_D8:
-      cpu_execute_mvi(state, &state->b);
-      break;
-
-    case RLC:
-      cpu_execute_rlc(state);
-      break;
-
-    case DAD_B:
-      cpu_execute_dad(state, &state->b, &state->c);
-      break;
-
-    case LDAX_B:
-      cpu_execute_ldax(state, state->b, state->c);
-      break;
-
-    case DCX_B:
-      cpu_execute_dcx(&state->b, &state->c);
-      break;
-
-    case INR_C:
-      cpu_execute_inr(state, &state->c);
-      break;
-
-    case DCR_C:
-      cpu_execute_dcr(state, &state->c);
-      break;
-
-    case MVI_C_D8:
-      cpu_execute_mvi(state, &state->c);
-      break;
-
-    case RRC:
-      cpu_execute_rrc(state);
-      break;
-
-    case LXI_D:
-      cpu_execute_lxi(state, &state->d, &state->e);
-      break;
-
-    case STAX_D:
-      cpu_execute_stax(state, state->d, state->e);
-      break;
-
-    case INX_D:
-      cpu_execute_inx(&state->d, &state->e);
-      break;
-
-    case INR_D:
-      cpu_execute_inr(state, &state->d);
-      break;
-
-    case DCR_D:
-      cpu_execute_dcr(state, &state->d);
-      break;
-
-    case MVI_D_D8:
-      cpu_execute_mvi(state, &state->d);
-      break;
-
-    case RAL:
-      cpu_execute_ral(state);
-      break;
-
-    case DAD_D:
-      cpu_execute_dad(state, &state->d, &state->e);
-      break;
-
-    case LDAX_D:
-      cpu_execute_ldax(state, state->d, state->e);
-      break;
-
-    case DCX_D:
-      cpu_execute_dcx(&state->d, &state->e);
-      break;
-
-    case INR_E:
-      cpu_execute_inr(state, &state->e);
-      break;
-
-    case DCR_E:
-      cpu_execute_dcr(state, &state->e);
-      break;
-
-    case MVI_E_D8:
-      cpu_execute_mvi(state, &state->e);
-      break;
-
-    case RAR:
-      cpu_execute_rar(state);
-      break;
-
-    case LXI_H:
-      cpu_execute_lxi(state, &state->h, &state->l);
-      break;
-
-    case SHLD:
-      cpu_execute_shld(state);
-      break;
-
-    case INX_H:
-      cpu_execute_inx(&state->h, &state->l);
-      break;
-
-    case INR_H:
-      cpu_execute_inr(state, &state->h);
-      break;
-
-    case DCR_H:
-      cpu_execute_dcr(state, &state->h);
-      break;
-
-    case MVI_H_D8:
-      cpu_execute_mvi(state, &state->h);
-      break;
-
-    case DAA:
-      cpu_execute_daa(state);
-      break;
-
-    case DAD_H:
-      cpu_execute_dad(state, &state->h, &state->l);
-      break;
-
-    case LHLD:
-      cpu_execute_lhld(state);
-      break;
-
-    case DCX_H:
-      cpu_execute_dcx(&state->h, &state->l);
-      break;
-
-    case INR_L:
-      cpu_execute_inr(state, &state->l);
-      break;
-
-    case DCR_L:
-      cpu_execute_dcr(state, &state->l);
-      break;
-
-    case MVI_L_D8:
-      cpu_execute_mvi(state, &state->l);
-      break;
-
-    case CMA:
-      cpu_execute_cma(state);
-      break;
-
-    case LXI_SP:
-      cpu_split(state->sp, &high_byte, &low_byte);
-      cpu_execute_lxi(state, &high_byte, &low_byte);
-      state->sp = cpu_compose(high_byte, low_byte);
-      break;
-
-    case STA:
-      cpu_execute_sta(state);
-      break;
-
-    case INX_SP:
-      cpu_split(state->sp, &high_byte, &low_byte);
-      cpu_execute_inx(&high_byte, &low_byte);
-      state->sp = cpu_compose(high_byte, low_byte);
-      break;
-
-    case INR_M:
-      cpu_execute_inr_m(state);
-      break;
-
-    case DCR_M:
-      cpu_execute_dcr_m(state);
-      break;
-
-    case MVI_M_D8:
-      cpu_execute_mvi_m(state);
-      break;
-
-    case STC:
-      cpu_execute_stc(state);
-      break;
-
-    case DAD_SP:
-      cpu_split(state->sp, &high_byte, &low_byte);
-      cpu_execute_dad(state, &high_byte, &low_byte);
-      break;
-
-    case LDA:
-      cpu_execute_lda(state);
-      break;
-
-    case DCX_SP:
-      cpu_split(state->sp, &high_byte, &low_byte);
-      cpu_execute_dcx(&high_byte, &low_byte);
-      state->sp = cpu_compose(high_byte, low_byte);
-      break;
-
-    case INR_A:
-      cpu_execute_inr(state, &state->a);
-      break;
-
-    case DCR_A:
-      cpu_execute_dcr(state, &state->a);
-      break;
-
-    case MVI_A_D8:
-      cpu_execute_mvi(state, &state->a);
-      break;
-
-    case CMC:
-      cpu_execute_cmc(state);
-      break;
-
-    case MOV_B_B:
-      cpu_execute_mov_r_r(state, &state->b, &state->b);
-      break;
-
-    case MOV_B_C:
-      cpu_execute_mov_r_r(state, &state->b, &state->c);
-      break;
-
-    case MOV_B_D:
-      cpu_execute_mov_r_r(state, &state->b, &state->d);
-      break;
-
-    case MOV_B_E:
-      cpu_execute_mov_r_r(state, &state->b, &state->e);
-      break;
-
-    case MOV_B_H:
-      cpu_execute_mov_r_r(state, &state->b, &state->h);
-      break;
-
-    case MOV_B_L:
-      cpu_execute_mov_r_r(state, &state->b, &state->l);
-      break;
-
-    case MOV_B_M:
-      cpu_execute_mov_r_m(state, &state->b);
-      break;
-
-    case MOV_B_A:
-      cpu_execute_mov_r_r(state, &state->b, &state->a);
-      break;
-
-    case MOV_C_B:
-      cpu_execute_mov_r_r(state, &state->c, &state->b);
-      break;
-
-    case MOV_C_C:
-      cpu_execute_mov_r_r(state, &state->c, &state->c);
-      break;
-
-    case MOV_C_D:
-      cpu_execute_mov_r_r(state, &state->c, &state->d);
-      break;
-
-    case MOV_C_E:
-      cpu_execute_mov_r_r(state, &state->c, &state->e);
-      break;
-
-    case MOV_C_H:
-      cpu_execute_mov_r_r(state, &state->c, &state->h);
-      break;
-
-    case MOV_C_L:
-      cpu_execute_mov_r_r(state, &state->c, &state->l);
-      break;
-
-    case MOV_C_M:
-      cpu_execute_mov_r_m(state, &state->c);
-      break;
-
-    case MOV_C_A:
-      cpu_execute_mov_r_r(state, &state->c, &state->a);
-      break;
-
-    case MOV_D_B:
-      cpu_execute_mov_r_r(state, &state->d, &state->b);
-      break;
-
-    case MOV_D_C:
-      cpu_execute_mov_r_r(state, &state->d, &state->c);
-      break;
-
-    case MOV_D_D:
-      cpu_execute_mov_r_r(state, &state->d, &state->d);
-      break;
-
-    case MOV_D_E:
-      cpu_execute_mov_r_r(state, &state->d, &state->e);
-      break;
-
-    case MOV_D_H:
-      cpu_execute_mov_r_r(state, &state->d, &state->h);
-      break;
-
-    case MOV_D_L:
-      cpu_execute_mov_r_r(state, &state->d, &state->l);
-      break;
-
-    case MOV_D_M:
-      cpu_execute_mov_r_m(state, &state->d);
-      break;
-
-    case MOV_D_A:
-      cpu_execute_mov_r_r(state, &state->d, &state->a);
-      break;
-
-    case MOV_E_B:
-      cpu_execute_mov_r_r(state, &state->e, &state->b);
-      break;
-
-    case MOV_E_C:
-      cpu_execute_mov_r_r(state, &state->e, &state->c);
-      break;
-
-    case MOV_E_D:
-      cpu_execute_mov_r_r(state, &state->e, &state->d);
-      break;
-
-    case MOV_E_E:
-      cpu_execute_mov_r_r(state, &state->e, &state->e);
-      break;
-
-    case MOV_E_H:
-      cpu_execute_mov_r_r(state, &state->e, &state->h);
-      break;
-
-    case MOV_E_L:
-      cpu_execute_mov_r_r(state, &state->e, &state->l);
-      break;
-
-    case MOV_E_M:
-      cpu_execute_mov_r_m(state, &state->e);
-      break;
-
-    case MOV_E_A:
-      cpu_execute_mov_r_r(state, &state->e, &state->a);
-      break;
-
-    case MOV_H_B:
-      cpu_execute_mov_r_r(state, &state->h, &state->b);
-      break;
-
-    case MOV_H_C:
-      cpu_execute_mov_r_r(state, &state->h, &state->c);
-      break;
-
-    case MOV_H_D:
-      cpu_execute_mov_r_r(state, &state->h, &state->d);
-      break;
-
-    case MOV_H_E:
-      cpu_execute_mov_r_r(state, &state->h, &state->e);
-      break;
-
-    case MOV_H_H:
-      cpu_execute_mov_r_r(state, &state->h, &state->h);
-      break;
-
-    case MOV_H_L:
-      cpu_execute_mov_r_r(state, &state->h, &state->l);
-      break;
-
-    case MOV_H_M:
-      cpu_execute_mov_r_m(state, &state->h);
-      break;
-
-    case MOV_H_A:
-      cpu_execute_mov_r_r(state, &state->h, &state->a);
-      break;
-
-    case MOV_L_B:
-      cpu_execute_mov_r_r(state, &state->l, &state->b);
-      break;
-
-    case MOV_L_C:
-      cpu_execute_mov_r_r(state, &state->l, &state->c);
-      break;
-
-    case MOV_L_D:
-      cpu_execute_mov_r_r(state, &state->l, &state->d);
-      break;
-
-    case MOV_L_E:
-      cpu_execute_mov_r_r(state, &state->l, &state->e);
-      break;
-
-    case MOV_L_H:
-      cpu_execute_mov_r_r(state, &state->l, &state->h);
-      break;
-
-    case MOV_L_L:
-      cpu_execute_mov_r_r(state, &state->l, &state->l);
-      break;
-
-    case MOV_L_M:
-      cpu_execute_mov_r_m(state, &state->l);
-      break;
-
-    case MOV_L_A:
-      cpu_execute_mov_r_r(state, &state->l, &state->a);
-      break;
-
-    case MOV_M_B:
-      cpu_execute_mov_m_r(state, &state->b);
-      break;
-
-    case MOV_M_C:
-      cpu_execute_mov_m_r(state, &state->c);
-      break;
-
-    case MOV_M_D:
-      cpu_execute_mov_m_r(state, &state->d);
-      break;
-
-    case MOV_M_E:
-      cpu_execute_mov_m_r(state, &state->e);
-      break;
-
-    case MOV_M_H:
-      cpu_execute_mov_m_r(state, &state->h);
-      break;
-
-    case MOV_M_L:
-      cpu_execute_mov_m_r(state, &state->l);
-      break;
-
-    case MOV_M_A:
-      cpu_execute_mov_m_r(state, &state->a);
-      break;
-
-    case MOV_A_B:
-      cpu_execute_mov_r_r(state, &state->a, &state->b);
-      break;
-
-    case MOV_A_C:
-      cpu_execute_mov_r_r(state, &state->a, &state->c);
-      break;
-
-    case MOV_A_D:
-      cpu_execute_mov_r_r(state, &state->a, &state->d);
-      break;
-
-    case MOV_A_E:
-      cpu_execute_mov_r_r(state, &state->a, &state->e);
-      break;
-
-    case MOV_A_H:
-      cpu_execute_mov_r_r(state, &state->a, &state->h);
-      break;
-
-    case MOV_A_L:
-      cpu_execute_mov_r_r(state, &state->a, &state->l);
-      break;
-
-    case MOV_A_M:
-      cpu_execute_mov_r_m(state, &state->a);
-      break;
-
-    case MOV_A_A:
-      cpu_execute_mov_r_r(state, &state->a, &state->a);
-      break;
-
-    case ADD_B:
-      cpu_execute_add_r(state, state->b);
-      break;
-
-    case ADD_C:
-      cpu_execute_add_r(state, state->c);
-      break;
-
-    case ADD_D:
-      cpu_execute_add_r(state, state->d);
-      break;
-
-    case ADD_E:
-      cpu_execute_add_r(state, state->e);
-      break;
-
-    case ADD_H:
-      cpu_execute_add_r(state, state->h);
-      break;
-
-    case ADD_L:
-      cpu_execute_add_r(state, state->l);
-      break;
-
-    case ADD_M:
-      cpu_execute_add_m(state);
-      break;
-
-    case ADD_A:
-      cpu_execute_add_r(state, state->a);
-      break;
-
-    case ADC_B:
-      cpu_execute_adc_r(state, state->b);
-      break;
-
-    case ADC_C:
-      cpu_execute_adc_r(state, state->c);
-      break;
-
-    case ADC_D:
-      cpu_execute_adc_r(state, state->d);
-      break;
-
-    case ADC_E:
-      cpu_execute_adc_r(state, state->e);
-      break;
-
-    case ADC_H:
-      cpu_execute_adc_r(state, state->h);
-      break;
-
-    case ADC_L:
-      cpu_execute_adc_r(state, state->l);
-      break;
-
-    case ADC_M:
-      cpu_execute_adc_m(state);
-      break;
-
-    case ADC_A:
-      cpu_execute_adc_r(state, state->a);
-      break;
-
-    case SUB_B:
-      cpu_execute_sub_r(state, state->b);
-      break;
-
-    case SUB_C:
-      cpu_execute_sub_r(state, state->c);
-      break;
-
-    case SUB_D:
-      cpu_execute_sub_r(state, state->d);
-      break;
-
-    case SUB_E:
-      cpu_execute_sub_r(state, state->e);
-      break;
-
-    case SUB_H:
-      cpu_execute_sub_r(state, state->h);
-      break;
-
-    case SUB_L:
-      cpu_execute_sub_r(state, state->l);
-      break;
-
-    case SUB_M:
-      cpu_execute_sub_m(state);
-      break;
-
-    case SUB_A:
-      cpu_execute_sub_r(state, state->a);
-      break;
-
-    case SBB_B:
-      cpu_execute_sbb_r(state, state->b);
-      break;
-
-    case SBB_C:
-      cpu_execute_sbb_r(state, state->c);
-      break;
-
-    case SBB_D:
-      cpu_execute_sbb_r(state, state->d);
-      break;
-
-    case SBB_E:
-      cpu_execute_sbb_r(state, state->e);
-      break;
-
-    case SBB_H:
-      cpu_execute_sbb_r(state, state->h);
-      break;
-
-    case SBB_L:
-      cpu_execute_sbb_r(state, state->l);
-      break;
-
-    case SBB_M:
-      cpu_execute_sbb_m(state);
-      break;
-
-    case SBB_A:
-      cpu_execute_sbb_r(state, state->a);
-      break;
-
-    case ANA_B:
-      cpu_execute_ana_r(state, state->b);
-      break;
-
-    case ANA_C:
-      cpu_execute_ana_r(state, state->c);
-      break;
-
-    case ANA_D:
-      cpu_execute_ana_r(state, state->d);
-      break;
-
-    case ANA_E:
-      cpu_execute_ana_r(state, state->e);
-      break;
-
-    case ANA_H:
-      cpu_execute_ana_r(state, state->h);
-      break;
-
-    case ANA_L:
-      cpu_execute_ana_r(state, state->l);
-      break;
-
-    case ANA_M:
-      cpu_execute_ana_m(state);
-      break;
-
-    case ANA_A:
-      cpu_execute_ana_r(state, state->a);
-      break;
-
-    case XRA_B:
-      cpu_execute_xra_r(state, state->b);
-      break;
-
-    case XRA_C:
-      cpu_execute_xra_r(state, state->c);
-      break;
-
-    case XRA_D:
-      cpu_execute_xra_r(state, state->d);
-      break;
-
-    case XRA_E:
-      cpu_execute_xra_r(state, state->e);
-      break;
-
-    case XRA_H:
-      cpu_execute_xra_r(state, state->h);
-      break;
-
-    case XRA_L:
-      cpu_execute_xra_r(state, state->l);
-      break;
-
-    case XRA_M:
-      cpu_execute_xra_m(state);
-      break;
-
-    case XRA_A:
-      cpu_execute_xra_r(state, state->a);
-      break;
-
-    case ORA_B:
-      cpu_execute_ora_r(state, state->b);
-      break;
-
-    case ORA_C:
-      cpu_execute_ora_r(state, state->c);
-      break;
-
-    case ORA_D:
-      cpu_execute_ora_r(state, state->d);
-      break;
-
-    case ORA_E:
-      cpu_execute_ora_r(state, state->e);
-      break;
-
-    case ORA_H:
-      cpu_execute_ora_r(state, state->h);
-      break;
-
-    case ORA_L:
-      cpu_execute_ora_r(state, state->l);
-      break;
-
-    case ORA_M:
-      cpu_execute_ora_m(state);
-      break;
-
-    case ORA_A:
-      cpu_execute_ora_r(state, state->a);
-      break;
-
-    case CMP_B:
-      cpu_execute_cmp_r(state, state->b);
-      break;
-
-    case CMP_C:
-      cpu_execute_cmp_r(state, state->c);
-      break;
-
-    case CMP_D:
-      cpu_execute_cmp_r(state, state->d);
-      break;
-
-    case CMP_E:
-      cpu_execute_cmp_r(state, state->e);
-      break;
-
-    case CMP_H:
-      cpu_execute_cmp_r(state, state->h);
-      break;
-
-    case CMP_L:
-      cpu_execute_cmp_r(state, state->l);
-      break;
-
-    case CMP_M:
-      cpu_execute_cmp_m(state);
-      break;
-
-    case CMP_A:
-      cpu_execute_ora_r(state, state->a);
-      break;
-
-    case RNZ:
-      cpu_execute_ret(state, !state->flags.z);
-      break;
-
-    case POP_B:
-      cpu_execute_pop(state, &state->b, &state->c);
-      break;
-
-    case JNZ:
-      cpu_execute_jmp(state, !state->flags.z);
-      break;
-
-    case JMP:
-      cpu_execute_jmp(state, 1);
-      break;
-
-    case CNZ:
-      cpu_execute_call(state, !state->flags.z);
-      break;
-
-    case PUSH_B:
-      cpu_execute_push(state, state->b, state->c);
-      break;
-
-    case ADI_D8:
-      cpu_execute_adi(state);
-      break;
-
-    case RST_0:
-      cpu_execute_rst(state, 0x00);
-      break;
-
-    case RZ:
-      cpu_execute_ret(state, state->flags.z);
-      break;
-
-    case RET:
-      cpu_execute_ret(state, 1);
-      break;
-
-    case JZ:
-      cpu_execute_jmp(state, state->flags.z);
-      break;
-
-    case CZ:
-      cpu_execute_call(state, state->flags.z);
-      break;
-
-    case CALL:
-      cpu_execute_call(state, 1);
-      break;
-
-    case ACI_D8:
-      cpu_execute_aci(state);
-      break;
-
-    case RST_1:
-      cpu_execute_rst(state, 0x08);
-      break;
-
-    case RNC:
-      cpu_execute_ret(state, !state->flags.c);
-      break;
-
-    case POP_D:
-      cpu_execute_pop(state, &state->d, &state->e);
-      break;
-
-    case JNC:
-      cpu_execute_jmp(state, !state->flags.c);
-      break;
-
-    case CNC:
-      cpu_execute_call(state, !state->flags.c);
-      break;
-
-    case PUSH_D:
-      cpu_execute_push(state, state->d, state->e);
-      break;
-
-    case SUI_D8:
-      cpu_execute_sui(state);
-      break;
-
-    case RST_2:
-      cpu_execute_rst(state, 0x10);
-      break;
-
-    case RC:
-      cpu_execute_ret(state, state->flags.c);
-      break;
-
-    case JC:
-      cpu_execute_jmp(state, state->flags.c);
-      break;
-
-    case CC:
-      cpu_execute_call(state, state->flags.c);
-      break;
-
-    case SBI_D8:
-      cpu_execute_sbi(state);
-      break;
-
-    case RST_3:
-      cpu_execute_rst(state, 0x18);
-      break;
-
-    case RPO:
-      cpu_execute_ret(state, !state->flags.p);
-      break;
-
-    case POP_H:
-      cpu_execute_pop(state, &state->h, &state->l);
-      break;
-
-    case JPO:
-      cpu_execute_jmp(state, !state->flags.p);
-      break;
-
-    case XTHL:
-      cpu_execute_xthl(state);
-      break;
-
-    case CPO:
-      cpu_execute_call(state, !state->flags.p);
-      break;
-
-    case PUSH_H:
-      cpu_execute_push(state, state->h, state->l);
-      break;
-
-    case ANI_D8:
-      cpu_execute_ani(state);
-      break;
-
-    case RST_4:
-      cpu_execute_rst(state, 0x20);
-      break;
-
-    case RPE:
-      cpu_execute_ret(state, state->flags.p);
-      break;
-
-    case PCHL:
-      cpu_execute_pchl(state);
-      break;
-
-    case JPE:
-      cpu_execute_jmp(state, state->flags.p);
-      break;
-
-    case XCHG:
-      cpu_execute_xchg(state);
-      break;
-
-    case CPE:
-      cpu_execute_call(state, state->flags.p);
-      break;
-
-    case XRI_D8:
-      cpu_execute_xri(state);
-      break;
-
-    case RST_5:
-      cpu_execute_rst(state, 0x28);
-      break;
-
-    case RP:
-      cpu_execute_ret(state, !state->flags.s);
-      break;
-
-    case POP_PSW:
-      uint8_t psw = 0;
-      cpu_execute_pop(state, &state->a, &psw);
-      cpu_set_psw(state, psw);
-      break;
-
-    case JP:
-      cpu_execute_jmp(state, !state->flags.s);
-      break;
-
-    case DI:
-      cpu_execute_di(state);
-      break;
-
-    case CP:
-      cpu_execute_call(state, !state->flags.s);
-      break;
-
-    case PUSH_PSW:
-      cpu_execute_push(state, state->a, cpu_get_psw(state));
-      break;
-
-    case ORI_D8:
-      cpu_execute_ori(state);
-      break;
-
-    case RST_6:
-      cpu_execute_rst(state, 0x30);
-      break;
-
-    case RM:
-      cpu_execute_ret(state, state->flags.s);
-      break;
-
-    case SPHL:
-      cpu_execute_sphl(state);
-      break;
-
-    case JM:
-      cpu_execute_jmp(state, state->flags.s);
-      break;
-
-    case EI:
-      cpu_execute_ei(state);
-      break;
-
-    case CM:
-      cpu_execute_call(state, state->flags.s);
-      break;
-
-    case CPI_D8:
-      cpu_execute_cpi(state);
-      break;
-
-    case RST_7:
-      cpu_execute_rst(state, 0x38);
-      break;
-
-    case OUT:
-      machine_out(cpu_fetch(state), state->a);
-      break;
-
-    case IN:
-      machine_in(cpu_fetch(state), &state->a);
-      break;
-
-    default:
-      cpu_print_debug_info(state);
-      cpu_print_dump(state);
-      printf("UNIMPLEMENTED INSTRUCTION: 0x%02x", op_code);
-      exit(1);
-  }
-}
-
-void cpu_execute_lxi(cpu_state *state, uint8_t *high_register, uint8_t *low_register) {
-  *low_register = cpu_fetch(state);
-  *high_register = cpu_fetch(state);
-}
-
-void cpu_execute_stax(cpu_state *state, uint8_t high_register, uint8_t low_register) {
-  uint16_t location = cpu_compose(high_register, low_register);
-  state->memory[location] = state->a;
-}
-
-void cpu_execute_inx(uint8_t *high_register, uint8_t *low_register) {
-  uint16_t byte = cpu_compose(*high_register, *low_register);
-  byte++;
-
-  cpu_split(byte, high_register, low_register);
-}
-
-void cpu_execute_inr(cpu_state *state, uint8_t *reg) {
-  uint16_t res = *reg;
-  res++;
-  *reg = res & 0x00FF;
-
-  cpu_handle_z_flag(state, res);
-  cpu_handle_s_flag(state, res);
-  cpu_handle_p_flag(state, res);
-  cpu_handle_ac_flag(state, res);
-}
-
-void cpu_execute_dcr(cpu_state *state, uint8_t *reg) {
-  uint16_t res = *reg;
-  res--;
-  *reg = res & 0x00FF;
-
-  cpu_handle_z_flag(state, res);
-  cpu_handle_s_flag(state, res);
-  cpu_handle_p_flag(state, res);
-  cpu_handle_ac_flag(state, res);
-}
-
-void cpu_execute_mvi(cpu_state *state, uint8_t *reg) {
-  *reg = cpu_fetch(state);
-}
-
-void cpu_execute_rlc(cpu_state *state) {
-  state->flags.c = state->a >> 7 != 0;
-  state->a = state->a << 1 | state->a >> 7;
-}
-
-void cpu_execute_dad(cpu_state *state, uint8_t *high_register, uint8_t *low_register) {
-  uint16_t reg = cpu_compose(*high_register, *low_register);
-  uint16_t hl = cpu_compose(state->h, state->l);
-
-  uint32_t res = hl + reg;
-
-  state->flags.c = (res & 0xFFFF0000) > 0;
-
-  cpu_split((uint32_t) res, &state->h, &state->l);
-}
-
-void cpu_execute_ldax(cpu_state *state, uint8_t high_register, uint8_t low_register) {
-  uint16_t location = cpu_compose(high_register, low_register);
-  state->a = state->memory[location];
-}
-
-void cpu_execute_dcx(uint8_t *high_register, uint8_t *low_register) {
-  uint16_t byte = cpu_compose(*high_register, *low_register);
-  byte--;
-
-  cpu_split(byte, high_register, low_register);
-}
-
-void cpu_execute_rrc(cpu_state *state) {
-  uint8_t temp = state->a;
-  state->a = temp >> 1 | temp << 7;
-  state->flags.c = ((state->a >> 7) > 0);
-}
-
-void cpu_execute_ral(cpu_state *state) {
-  uint8_t new_carry = state->a >> 7;
-  state->a = (state->a << 1) | state->flags.c;
-  state->flags.c = new_carry;
-}
-
-void cpu_execute_rar(cpu_state *state) {
-  uint8_t new_carry = ((uint8_t) (state->a << 7)) >> 7;
-  state->a = (state->a >> 1) | (state->flags.c << 7);
-  state->flags.c = new_carry;
-}
-
-void cpu_execute_shld(cpu_state *state) {
-  uint16_t address = cpu_fetch_address(state);
-  state->memory[address] = state->l;
-  state->memory[address + 1] = state->h;
-}
-
-void cpu_execute_lhld(cpu_state *state) {
-  uint16_t address = cpu_fetch_address(state);
-  state->l = state->memory[address];
-  state->h = state->memory[address + 1];
-}
-
-void cpu_execute_cma(cpu_state *state) {
-  state->a = ~state->a;
-}
-
-void cpu_execute_sta(cpu_state *state) {
-  uint16_t address = cpu_fetch_address(state);
-  state->memory[address] = state->a;
-}
-
-void cpu_execute_inr_m(cpu_state *state) {
-  uint16_t address = cpu_compose(state->h, state->l);
-  state->memory[address]++;
-
-  cpu_handle_z_flag(state, state->memory[address]);
-  cpu_handle_s_flag(state, state->memory[address]);
-  cpu_handle_p_flag(state, state->memory[address]);
-  cpu_handle_ac_flag(state, state->memory[address]);
-}
-
-void cpu_execute_dcr_m(cpu_state *state) {
-  uint16_t address = cpu_compose(state->h, state->l);
-  state->memory[address]--;
-
-  cpu_handle_z_flag(state, state->memory[address]);
-  cpu_handle_s_flag(state, state->memory[address]);
-  cpu_handle_p_flag(state, state->memory[address]);
-  cpu_handle_ac_flag(state, state->memory[address]);
-}
-
-void cpu_execute_mvi_m(cpu_state *state) {
-  uint16_t address = cpu_compose(state->h, state->l);
-  state->memory[address] = cpu_fetch(state);
-}
-
-void cpu_execute_stc(cpu_state *state) {
-  state->flags.c = 1;
-}
-
-void cpu_execute_lda(cpu_state *state) {
-  uint16_t address = cpu_fetch_address(state);
-  state->a = state->memory[address];
-}
-
-void cpu_execute_cmc(cpu_state *state) {
-  state->flags.c = !state->flags.c;
-}
-
-void cpu_execute_mov_r_r(cpu_state *state, uint8_t *src_register, uint8_t *dest_register) {
-  *src_register = *dest_register;
-}
-
-void cpu_execute_mov_r_m(cpu_state *state, uint8_t *src_register) {
-  uint16_t address = cpu_compose(state->h, state->l);
-  *src_register = state->memory[address];
-}
-
-void cpu_execute_mov_m_r(cpu_state *state, uint8_t *src_register) {
-  uint16_t address = cpu_compose(state->h, state->l);
-  state->memory[address] = *src_register;
-}
-
-void cpu_execute_add_r(cpu_state *state, uint8_t target_register) {
-  uint16_t res = state->a + target_register;
-  cpu_handle_all_flags(state, res);
-  state->a = res & 0xFF;
-}
-
-void cpu_execute_add_m(cpu_state *state) {
-  uint16_t address = cpu_compose(state->h, state->l);
-  uint16_t res = state->a + state->memory[address];
-  cpu_handle_all_flags(state, res);
-  state->a = res & 0xFF;
-}
-
-void cpu_execute_adc_r(cpu_state *state, uint8_t target_register) {
-  uint16_t res = state->a + target_register + state->flags.c;
-  cpu_handle_all_flags(state, res);
-  state->a = res & 0xFF;
-}
-
-void cpu_execute_adc_m(cpu_state *state) {
-  uint16_t address = cpu_compose(state->h, state->l);
-  uint16_t res = state->a + state->memory[address] + state->flags.c;
-  cpu_handle_all_flags(state, res);
-  state->a = res & 0xFF;
-}
-
-void cpu_execute_sub_r(cpu_state *state, uint8_t target_register) {
-  uint16_t res = state->a - target_register;
-  cpu_handle_all_flags(state, res);
-  state->a = res & 0xFF;
-}
-
-void cpu_execute_sub_m(cpu_state *state) {
-  uint16_t address = cpu_compose(state->h, state->l);
-  uint16_t res = state->a - state->memory[address];
-  cpu_handle_all_flags(state, res);
-  state->a = res & 0xFF;
-}
-
-void cpu_execute_sbb_r(cpu_state *state, uint8_t target_register) {
-  uint16_t res = state->a - target_register - state->flags.c;
-  cpu_handle_all_flags(state, res);
-  state->a = res & 0xFF;
-}
-
-void cpu_execute_sbb_m(cpu_state *state) {
-  uint16_t address = cpu_compose(state->h, state->l);
-  uint16_t res = state->a - state->memory[address] - state->flags.c;
-  cpu_handle_all_flags(state, res);
-  state->a = res & 0xFF;
-}
-
-void cpu_execute_ana_r(cpu_state *state, uint8_t target_register) {
-  uint16_t res = state->a & target_register;
-  cpu_handle_all_flags(state, res);
-  state->a = res & 0xFF;
-}
-
-void cpu_execute_ana_m(cpu_state *state) {
-  uint16_t address = cpu_compose(state->h, state->l);
-  uint16_t res = state->a & state->memory[address];
-  cpu_handle_all_flags(state, res);
-  state->a = res & 0xFF;
-}
-
-void cpu_execute_xra_r(cpu_state *state, uint8_t target_register) {
-  uint16_t res = state->a ^target_register;
-  cpu_handle_all_flags(state, res);
-  state->a = res & 0xFF;
-}
-
-void cpu_execute_xra_m(cpu_state *state) {
-  uint16_t address = cpu_compose(state->h, state->l);
-  uint16_t res = state->a ^state->memory[address];
-  cpu_handle_all_flags(state, res);
-  state->a = res & 0xFF;
-}
-
-void cpu_execute_ora_r(cpu_state *state, uint8_t target_register) {
-  uint16_t res = state->a | target_register;
-  cpu_handle_all_flags(state, res);
-  state->a = res & 0xFF;
-}
-
-void cpu_execute_ora_m(cpu_state *state) {
-  uint16_t address = cpu_compose(state->h, state->l);
-  uint16_t res = state->a | state->memory[address];
-  cpu_handle_all_flags(state, res);
-  state->a = res & 0xFF;
-}
-
-void cpu_execute_cmp_r(cpu_state *state, uint8_t target_register) {
-  uint16_t res = state->a - target_register;
-  cpu_handle_all_flags(state, res);
-}
-
-void cpu_execute_cmp_m(cpu_state *state) {
-  uint16_t address = cpu_compose(state->h, state->l);
-  uint16_t res = state->a - state->memory[address];
-  cpu_handle_all_flags(state, res);
-}
-
-void cpu_execute_jmp(cpu_state *state, uint8_t condition) {
-  uint16_t address = cpu_fetch_address(state);
-
-  if (condition) {
-    state->pc = address;
-  }
-}
-
-void cpu_execute_ei(cpu_state *state) {
-  state->interrupt_enable = 1;
-}
-
-void cpu_execute_di(cpu_state *state) {
-  state->interrupt_enable = 0;
-}
-
-void cpu_execute_call(cpu_state *state, uint8_t condition) {
-  uint16_t address = cpu_fetch_address(state);
-  uint8_t high_byte, low_byte;
-  cpu_split(state->pc, &high_byte, &low_byte);
-
-  if (condition) {
-    state->memory[state->sp - 1] = high_byte;
-    state->memory[state->sp - 2] = low_byte;
-    state->sp -= 2;
-    state->pc = address;
-  }
-}
-
-void cpu_execute_ret(cpu_state *state, uint8_t condition) {
-  if (condition) {
-    uint16_t address = cpu_compose(state->memory[state->sp + 1], state->memory[state->sp]);
-    state->sp += 2;
-    state->pc = address;
-  }
-}
-
-void cpu_execute_rst(cpu_state *state, uint8_t address) {
-  uint8_t high_byte, low_byte;
-  cpu_split(state->pc, &high_byte, &low_byte);
-
-  state->memory[state->sp - 1] = high_byte;
-  state->memory[state->sp - 2] = low_byte;
-  state->sp -= 2;
-  state->pc = address;
-}
-
-void cpu_execute_push(cpu_state *state, uint8_t high_register, uint8_t low_register) {
-  state->memory[state->sp - 1] = high_register;
-  state->memory[state->sp - 2] = low_register;
-  state->sp -= 2;
-}
-
-void cpu_execute_pop(cpu_state *state, uint8_t *high_register, uint8_t *low_register) {
-  *high_register = state->memory[state->sp + 1];
-  *low_register = state->memory[state->sp];
-  state->sp += 2;
-}
-
-void cpu_execute_pchl(cpu_state *state) {
-  state->pc = cpu_compose(state->h, state->l);
-}
-
-void cpu_execute_sphl(cpu_state *state) {
-  state->sp = cpu_compose(state->h, state->l);
-}
-
-void cpu_execute_xthl(cpu_state *state) {
-  uint8_t temp;
-  temp = state->memory[state->sp + 1];
-  state->memory[state->sp + 1] = state->h;
-  state->h = temp;
-
-  temp = state->memory[state->sp];
-  state->memory[state->sp] = state->l;
-  state->l = temp;
-}
-
-void cpu_execute_xchg(cpu_state *state) {
-  uint8_t temp;
-  temp = state->d;
-  state->d = state->h;
-  state->h = temp;
-
-  temp = state->e;
-  state->e = state->l;
-  state->l = temp;
-}
-
-void cpu_execute_adi(cpu_state *state) {
-  uint16_t res = state->a + cpu_fetch(state);
-  cpu_handle_all_flags(state, res);
-  state->a = res & 0xFF;
-}
-
-void cpu_execute_aci(cpu_state *state) {
-  uint16_t res = state->a + cpu_fetch(state) + state->flags.c;
-  cpu_handle_all_flags(state, res);
-  state->a = res & 0xFF;
-}
-
-void cpu_execute_sui(cpu_state *state) {
-  uint16_t res = state->a - cpu_fetch(state);
-  cpu_handle_all_flags(state, res);
-  state->a = res & 0xFF;
-}
-
-void cpu_execute_sbi(cpu_state *state) {
-  uint16_t res = state->a - cpu_fetch(state) - state->flags.c;
-  cpu_handle_all_flags(state, res);
-  state->a = res & 0xFF;
-}
-
-void cpu_execute_ani(cpu_state *state) {
-  uint16_t res = state->a & cpu_fetch(state);
-  cpu_handle_all_flags(state, res);
-  state->a = res & 0xFF;
-}
-
-void cpu_execute_xri(cpu_state *state) {
-  uint16_t res = state->a ^cpu_fetch(state);
-  cpu_handle_all_flags(state, res);
-  state->a = res & 0xFF;
-}
-
-void cpu_execute_ori(cpu_state *state) {
-  uint16_t res = state->a | cpu_fetch(state);
-  cpu_handle_all_flags(state, res);
-  state->a = res & 0xFF;
-}
-
-void cpu_execute_cpi(cpu_state *state) {
-  uint16_t res = state->a - cpu_fetch(state);
-  cpu_handle_all_flags(state, res);
-}
-
-void cpu_execute_daa(cpu_state *state) {
-  if ((state->a & 0xf) > 0x9) {
-    state->a += 0x6;
-  }
-
-  if ((state->a & 0xf0) > 0x90) {
-    uint16_t res = (uint16_t) state->a + 0x60;
-    state->a = res & 0xff;
-    cpu_handle_all_flags(state, res);
-  }
-}
-
+#include "cpu.h"
+#include "machine.h"
+
+#include <stddef.h>
+
+#if CPU_JIT
+#include "jit.h"
+#endif
+
+#define CPU_SLICE_CYCLES 1000
+
+// The last hot field of cpu_state ends within the first cache line
+_Static_assert(offsetof(cpu_state, machine) + sizeof(machine_state *) + sizeof(void *) <= 64,
+               "cpu_state hot fields do not fit in a cache line");
+_Static_assert(MEMORY_PAGES <= 16, "cpu_state keeps one bit per page in slow_writes");
+
+// Immediate operands of the instruction being executed, engines that predecode redefine these
+#define CPU_IMM8() cpu_fetch(state)
+#define CPU_IMM16() cpu_fetch_address(state)
+
+static uint8_t cpu_run_engine(cpu_state *state, uint64_t cycle_target, uint64_t count);
+
+// Reads are inlined into every engine, without read handlers they are one load from the guest view
+#define CPU_ACCESSOR inline __attribute__((always_inline))
+
+uint16_t cpu_compose(uint8_t high_byte, uint8_t low_byte) {
+  uint16_t ret = 0;
+  ret += high_byte;
+  ret <<= 8;
+  ret += low_byte;
+  return ret;
+}
+
+void cpu_split(uint16_t byte, uint8_t *high_byte, uint8_t *low_byte) {
+  *high_byte = (byte & 0xFF00) >> 8;
+  *low_byte = byte & 0x00FF;
+}
+
+CPU_ACCESSOR uint8_t cpu_read_byte(cpu_state *state, uint16_t address) {
+#if MEMORY_READ_HANDLERS
+  if (state->memory->slow_reads >> (address >> MEMORY_PAGE_SHIFT) & 1) {
+    return memory_read_slow(state->memory, address);
+  }
+#endif
+
+  return state->data[address];
+}
+
+static void cpu_invalidate_code(cpu_state *state, uint16_t address) {
+#if CPU_DISPATCH == CPU_DISPATCH_BLOCK
+  if (state->block_cache->code_refs[address]) {
+    cpu_invalidate_blocks(state->block_cache, address);
+  }
+#elif CPU_DISPATCH == CPU_DISPATCH_AOT
+  if (state->aot_cache->code_refs[address]) {
+    cpu_invalidate_aot_blocks(state->aot_cache, address);
+  }
+#endif
+}
+
+// Dropped writes to ROM leave its code alone, handler pages are not expected to hold code. Inlined like the reads,
+// the check for those pages is one bit test on the way to the store
+CPU_ACCESSOR void cpu_write_byte(cpu_state *state, uint16_t address, uint8_t value) {
+  if (__builtin_expect(state->slow_writes >> (address >> MEMORY_PAGE_SHIFT) & 1, 0)) {
+    memory_write_slow(state->memory, address, value);
+
+#if MEMORY_PORTABLE
+    // Mirrored RAM is stored to by the slow path when the mirrors are copies
+    if (state->memory->write[address >> MEMORY_PAGE_SHIFT] == state->data) {
+      cpu_invalidate_code(state, address);
+    }
+#endif
+
+    return;
+  }
+
+  state->data[address] = value;
+  cpu_invalidate_code(state, address);
+}
+
+CPU_ACCESSOR uint16_t cpu_read_word(cpu_state *state, uint16_t address) {
+  uint16_t next = address + 1;
+
+#if MEMORY_READ_HANDLERS
+  uint32_t pages = 1u << (address >> MEMORY_PAGE_SHIFT) | 1u << (next >> MEMORY_PAGE_SHIFT);
+
+  if (state->memory->slow_reads & pages) {
+    return memory_read_word_slow(state->memory, address);
+  }
+#endif
+
+  return state->data[address] | state->data[next] << 8;
+}
+
+// Every way into the opcode bodies calls this first
+static inline void cpu_sync_memory(cpu_state *state) {
+  state->slow_writes = state->memory->slow_writes;
+}
+
+void cpu_write_word(cpu_state *state, uint16_t address, uint16_t value) {
+  cpu_write_byte(state, address, value & 0x00FF);
+  cpu_write_byte(state, address + 1, value >> 8);
+}
+
+uint16_t cpu_get_psw(cpu_state *state) {
+  cpu_get_flags(state);
+  return state->psw;
+}
+
+void cpu_set_psw(cpu_state *state, uint16_t psw) {
+  state->psw = (psw & 0xFF00) | (psw & (FLAG_S | FLAG_Z | FLAG_AC | FLAG_P | FLAG_C)) | FLAG_ALWAYS_ONE;
+
+  state->lazy_flags.op = FLAGS_NONE;
+#if CPU_LAZY_FLAGS_CHECK
+  state->shadow_flags = state->f;
+#endif
+}
+
+void cpu_compute_zsp_flags(uint8_t *flags, uint8_t res) {
+  *flags = (*flags & (FLAG_AC | FLAG_C)) | zsp_table[res] | FLAG_ALWAYS_ONE;
+}
+
+void cpu_compute_inr_flags(uint8_t *flags, uint8_t res) {
+  *flags = (*flags & FLAG_C) | inr_flags_table[res] | FLAG_ALWAYS_ONE;
+}
+
+void cpu_compute_dcr_flags(uint8_t *flags, uint8_t res) {
+  *flags = (*flags & FLAG_C) | dcr_flags_table[res] | FLAG_ALWAYS_ONE;
+}
+
+uint8_t cpu_carry_index(uint8_t first, uint8_t second, uint8_t res) {
+  return ((first & 0x88) >> 1) | ((second & 0x88) >> 2) | ((res & 0x88) >> 3);
+}
+
+void cpu_compute_add_flags(uint8_t *flags, uint8_t first, uint8_t second, uint8_t res) {
+  uint8_t index = cpu_carry_index(first, second, res);
+  *flags = zsp_table[res] | add_carry_table[index & 0x7] << 4 | add_carry_table[index >> 4] | FLAG_ALWAYS_ONE;
+}
+
+void cpu_compute_sub_flags(uint8_t *flags, uint8_t first, uint8_t second, uint8_t res) {
+  uint8_t index = cpu_carry_index(first, second, res);
+  *flags = zsp_table[res] | sub_carry_table[index & 0x7] << 4 | !sub_carry_table[index >> 4] | FLAG_ALWAYS_ONE;
+}
+
+void cpu_compute_logic_flags(uint8_t *flags, uint8_t res, uint8_t ac) {
+  *flags = zsp_table[res] | (ac ? FLAG_AC : 0) | FLAG_ALWAYS_ONE;
+}
+
+void cpu_compute_flags(uint8_t *flags, uint8_t op, uint8_t first, uint8_t second, uint8_t res) {
+  switch (op) {
+    case FLAGS_ADD:
+      cpu_compute_add_flags(flags, first, second, res);
+      break;
+
+    case FLAGS_SUB:
+      cpu_compute_sub_flags(flags, first, second, res);
+      break;
+
+    case FLAGS_AND:
+      cpu_compute_logic_flags(flags, res, ((first | second) & 0x08) != 0);
+      break;
+
+    case FLAGS_LOGIC:
+      cpu_compute_logic_flags(flags, res, 0);
+      break;
+
+    case FLAGS_INR:
+      cpu_compute_inr_flags(flags, res);
+      break;
+
+    case FLAGS_DCR:
+      cpu_compute_dcr_flags(flags, res);
+      break;
+
+    default:
+      break;
+  }
+}
+
+void cpu_handle_flags(cpu_state *state, uint8_t op, uint8_t first, uint8_t second, uint8_t res) {
+#if CPU_LAZY_FLAGS_CHECK
+  cpu_compute_flags(&state->shadow_flags, op, first, second, res);
+#endif
+
+#if CPU_LAZY_FLAGS
+  if (op == FLAGS_INR || op == FLAGS_DCR) {
+    state->f = (state->f & ~FLAG_C) | cpu_get_carry(state);
+  }
+
+  state->lazy_flags.op = op;
+  state->lazy_flags.first = first;
+  state->lazy_flags.second = second;
+  state->lazy_flags.res = res;
+#else
+  cpu_compute_flags(&state->f, op, first, second, res);
+#endif
+}
+
+uint8_t cpu_get_flags(cpu_state *state) {
+#if CPU_LAZY_FLAGS
+  cpu_lazy_flags *lazy = &state->lazy_flags;
+
+  if (lazy->op != FLAGS_NONE) {
+    cpu_compute_flags(&state->f, lazy->op, lazy->first, lazy->second, lazy->res);
+    lazy->op = FLAGS_NONE;
+  }
+
+#if CPU_LAZY_FLAGS_CHECK
+  cpu_check_lazy_flags(state, state->f);
+#endif
+#endif
+
+  return state->f;
+}
+
+uint8_t cpu_get_carry(cpu_state *state) {
+#if CPU_LAZY_FLAGS
+  cpu_lazy_flags *lazy = &state->lazy_flags;
+  uint8_t carry = state->f & FLAG_C;
+
+  switch (lazy->op) {
+    case FLAGS_ADD:
+      carry = add_carry_table[cpu_carry_index(lazy->first, lazy->second, lazy->res) >> 4];
+      break;
+
+    case FLAGS_SUB:
+      carry = !sub_carry_table[cpu_carry_index(lazy->first, lazy->second, lazy->res) >> 4];
+      break;
+
+    case FLAGS_AND:
+    case FLAGS_LOGIC:
+      carry = 0;
+      break;
+
+    default:
+      break;
+  }
+
+#if CPU_LAZY_FLAGS_CHECK
+  cpu_check_lazy_flags(state, (state->shadow_flags & ~FLAG_C) | carry);
+#endif
+
+  return carry;
+#else
+  return state->f & FLAG_C;
+#endif
+}
+
+void cpu_set_carry(cpu_state *state, uint8_t carry) {
+  state->f = (cpu_get_flags(state) & ~FLAG_C) | (carry != 0);
+
+#if CPU_LAZY_FLAGS_CHECK
+  state->shadow_flags = state->f;
+#endif
+}
+
+#if CPU_LAZY_FLAGS_CHECK
+void cpu_check_lazy_flags(cpu_state *state, uint8_t flags) {
+  if (flags != state->shadow_flags) {
+    printf("LAZY FLAGS MISMATCH AT 0x%04x\n", state->pc);
+    printf("Lazy: 0x%02x | Eager: 0x%02x\n", flags, state->shadow_flags);
+    cpu_print_dump(state);
+    exit(1);
+  }
+}
+#endif
+
+uint8_t cpu_parity(uint8_t value) {
+  uint8_t parity = 0;
+
+  for (int i = 0; i < 8; i++) {
+    parity ^= (value >> i) & 0x1;
+  }
+
+  return parity == 0;
+}
+
+uint32_t cpu_check_flags(uint8_t flags, uint8_t res, uint8_t c, uint8_t ac) {
+  uint8_t expected = (res & FLAG_S) | (res == 0 ? FLAG_Z : 0) | (ac ? FLAG_AC : 0) | (cpu_parity(res) ? FLAG_P : 0) |
+                     FLAG_ALWAYS_ONE | (c ? FLAG_C : 0);
+  return flags != expected;
+}
+
+#if CPU_JIT_CHECK
+void cpu_check_jit(cpu_state *state, cpu_state *expected, cpu_block *block, uint8_t count) {
+  for (uint8_t i = 0; i < count; i++) {
+    cpu_emulate_op_code(expected, cpu_fetch(expected));
+  }
+
+  if (state->psw != cpu_get_psw(expected) || state->bc != expected->bc || state->de != expected->de ||
+      state->hl != expected->hl || state->sp != expected->sp || state->pc != expected->pc ||
+      state->cycles != expected->cycles || state->interrupt_enable != expected->interrupt_enable ||
+      memcmp(state->memory->data, expected->memory->data, 16 * 16 * 16 * 16)) {
+    printf("JIT MISMATCH IN BLOCK 0x%04x AFTER %u INSTRUCTIONS\n", block->start, count);
+    printf("Native: ");
+    cpu_print_debug_info(state);
+    printf("Interpreter: ");
+    cpu_print_debug_info(expected);
+    cpu_print_dump(state);
+    exit(1);
+  }
+}
+#endif
+
+uint32_t cpu_check_flag_tables() {
+  uint8_t flags = FLAG_ALWAYS_ONE;
+  uint32_t errors = 0;
+
+  for (uint32_t first = 0; first < 256; first++) {
+    for (uint32_t second = 0; second < 256; second++) {
+      for (uint32_t carry = 0; carry < 2; carry++) {
+        uint8_t res = first + second + carry;
+        cpu_compute_add_flags(&flags, first, second, res);
+        errors += cpu_check_flags(flags, res, first + second + carry > 0xFF,
+                                  (first & 0xF) + (second & 0xF) + carry > 0xF);
+
+        res = first - second - carry;
+        cpu_compute_sub_flags(&flags, first, second, res);
+        errors += cpu_check_flags(flags, res, first < second + carry,
+                                  (first & 0xF) + (~second & 0xF) + !carry > 0xF);
+      }
+    }
+
+    uint8_t res = first;
+    flags = FLAG_ALWAYS_ONE;
+
+    cpu_compute_inr_flags(&flags, res);
+    errors += cpu_check_flags(flags, res, 0, (res & 0xF) == 0x0);
+
+    cpu_compute_dcr_flags(&flags, res);
+    errors += cpu_check_flags(flags, res, 0, (res & 0xF) != 0xF);
+  }
+
+  if (errors) {
+    printf("FLAG TABLES DO NOT MATCH THE REFERENCE: %u errors\n", errors);
+  }
+
+  return errors;
+}
+
+// Power-on registers and counters, memory and the code caches are left alone
+void cpu_reset(cpu_state *state) {
+  state->psw = FLAG_ALWAYS_ONE;
+  state->bc = 0;
+  state->de = 0;
+  state->hl = 0;
+
+  state->pc = 0;
+  state->sp = 0; // TODO: The last memory address
+
+  state->lazy_flags.op = FLAGS_NONE;
+#if CPU_LAZY_FLAGS_CHECK
+  state->shadow_flags = state->f;
+#endif
+
+  state->interrupt_enable = 0;
+  state->interrupt = 0;
+  state->halted = 0;
+  state->stop_reason = CPU_STOP_NONE;
+
+  state->cycles = 0;
+
+#if CPU_IDLE_SKIP
+  state->idle_cycles = 0;
+  state->idle = 0;
+#endif
+
+  state->instructions = 0;
+}
+
+cpu_state cpu_init(machine_state *machine, char *file_data, uint32_t file_size) {
+  memory_map *memory = malloc(sizeof(memory_map));
+  memory_init(memory, NULL);
+  memcpy(memory->data, file_data, file_size * sizeof(char));
+
+  cpu_state state = cpu_init_memory(machine, memory);
+  state.owns_memory = 1;
+
+  return state;
+}
+
+cpu_state cpu_init_memory(machine_state *machine, memory_map *memory) {
+  cpu_state state;
+  cpu_reset(&state);
+
+  state.breakpoints = NULL;
+  state.io_traps = NULL;
+  state.trap_count = 0;
+  state.trap_resume = 0;
+  state.interpreter = cpu_run_engine;
+  state.frame_handler = NULL;
+  state.frame_context = NULL;
+  state.interrupt_handler = NULL;
+  state.interrupt_context = NULL;
+  state.poll_handler = NULL;
+  state.poll_context = NULL;
+  state.video = 0;
+
+#if CPU_DISPATCH == CPU_DISPATCH_BLOCK
+  state.block_cache = calloc(1, sizeof(cpu_block_cache));
+#endif
+
+#if CPU_JIT
+  jit_init(state.block_cache);
+#endif
+
+#if CPU_DISPATCH == CPU_DISPATCH_AOT
+  state.aot_cache = calloc(1, sizeof(cpu_aot_cache));
+#endif
+
+  state.machine = machine;
+  state.memory = memory;
+  state.data = memory->data;
+  cpu_sync_memory(&state);
+  state.owns_memory = 0;
+
+#if CPU_DISPATCH == CPU_DISPATCH_BLOCK
+  state.block_cache->memory = state.memory;
+#endif
+
+  return state;
+}
+
+// Whether any cached block covers a byte of the page
+static uint8_t cpu_page_has_code(cpu_state *state, uint32_t page) {
+#if CPU_DISPATCH == CPU_DISPATCH_BLOCK || CPU_DISPATCH == CPU_DISPATCH_AOT
+#if CPU_DISPATCH == CPU_DISPATCH_BLOCK
+  const uint8_t *refs = state->block_cache->code_refs + (page << MEMORY_PAGE_SHIFT);
+#else
+  const uint8_t *refs = state->aot_cache->code_refs + (page << MEMORY_PAGE_SHIFT);
+#endif
+  uint64_t any = 0;
+
+  for (uint32_t offset = 0; offset < MEMORY_PAGE_SIZE; offset += 8) {
+    uint64_t word;
+    memcpy(&word, refs + offset, 8);
+    any |= word;
+  }
+
+  return any != 0;
+#else
+  return 0;
+#endif
+}
+
+// Cached code is only dropped where the bytes change
+static void cpu_load_page(cpu_state *state, uint32_t page, const uint8_t *bytes) {
+  uint8_t *data = state->data + (page << MEMORY_PAGE_SHIFT);
+
+  if (!cpu_page_has_code(state, page)) {
+    memcpy(data, bytes, MEMORY_PAGE_SIZE);
+  } else {
+    for (uint32_t offset = 0; offset < MEMORY_PAGE_SIZE; offset++) {
+      if (data[offset] != bytes[offset]) {
+        data[offset] = bytes[offset];
+        cpu_invalidate_code(state, (page << MEMORY_PAGE_SHIFT) | offset);
+      }
+    }
+  }
+
+  memory_update_mirrors(state->memory, page);
+}
+
+// Replaces the pages this map owns, shared ROM stays and mirrors keep showing the pages they repeat
+void cpu_load_memory(cpu_state *state, const uint8_t *memory) {
+  for (uint32_t page = 0; page < MEMORY_PAGES; page++) {
+    if (state->memory->private_pages >> page & 1) {
+      cpu_load_page(state, page, memory + (page << MEMORY_PAGE_SHIFT));
+    }
+  }
+}
+
+void cpu_load_pages(cpu_state *state, uint32_t pages, const uint8_t *data) {
+  for (uint32_t page = 0; page < MEMORY_PAGES; page++) {
+    if (pages >> page & 1) {
+      cpu_load_page(state, page, data);
+      data += MEMORY_PAGE_SIZE;
+    }
+  }
+}
+
+void cpu_destroy(cpu_state *state) {
+  free(state->breakpoints);
+  free(state->io_traps);
+
+#if CPU_JIT
+  jit_destroy(state->block_cache);
+#endif
+
+#if CPU_JIT_CHECK
+  if (state->block_cache->jit_check_memory) {
+    memory_destroy(state->block_cache->jit_check_memory);
+  }
+
+  free(state->block_cache->jit_check_memory);
+  free(state->block_cache->jit_check_cache);
+#endif
+
+#if CPU_DISPATCH == CPU_DISPATCH_BLOCK
+  cpu_flush_block_cache(state->block_cache);
+  free(state->block_cache);
+#endif
+
+#if CPU_DISPATCH == CPU_DISPATCH_AOT
+  free(state->aot_cache);
+#endif
+
+  // Last, the check map above takes its pages from the same arena
+  if (state->owns_memory) {
+    memory_destroy(state->memory);
+    free(state->memory);
+  }
+}
+
+void cpu_print_debug_info(cpu_state *state) {
+  printf(
+    "Registers: PC - 0x%04x | SP - 0x%04x | A - 0x%02x | B - 0x%02x | C - 0x%02x | D - 0x%02x | E - 0x%02x | H - 0x%02x | L - 0x%02x\n",
+    state->pc, state->sp, state->a, state->b, state->c, state->d, state->e, state->h, state->l);
+  uint8_t flags = cpu_get_flags(state);
+  printf("Flags: Z - %d | S - %d | P - %d | C - %d | AC - %d\n", (flags & FLAG_Z) != 0, (flags & FLAG_S) != 0,
+         (flags & FLAG_P) != 0, (flags & FLAG_C) != 0, (flags & FLAG_AC) != 0);
+}
+
+void cpu_print_dump(cpu_state *state) {
+  FILE *dump = fopen("../dump", "wb");
+  fwrite(state->memory->data, 1, 16 * 16 * 16 * 16, dump);
+  fclose(dump);
+}
+
+void cpu_print_cycle_info(cpu_state *state, uint32_t elapsed_ms) {
+  double mhz = elapsed_ms ? (double) state->cycles / (elapsed_ms * 1000.0) : 0;
+  printf("Cycles: %" PRIu64 " in %u ms | %.2f MHz equivalent\n", state->cycles, elapsed_ms, mhz);
+
+  if (state->instructions) {
+    printf("Instructions: %" PRIu64 " | %.2f cycles per instruction\n", state->instructions,
+           (double) state->cycles / state->instructions);
+  }
+
+  cpu_print_block_cache_info(state);
+}
+
+void cpu_print_block_cache_info(cpu_state *state) {
+#if CPU_DISPATCH == CPU_DISPATCH_BLOCK
+  cpu_block_cache *cache = state->block_cache;
+  uint64_t lookups = cache->hits + cache->misses;
+  double hit_rate = lookups ? 100.0 * cache->hits / lookups : 0;
+  printf("Blocks: %" PRIu64 " hits | %" PRIu64 " misses | %" PRIu64 " invalidations | %.2f%% hit rate\n", cache->hits,
+         cache->misses, cache->invalidations, hit_rate);
+#endif
+
+#if CPU_JIT
+  printf("JIT: %" PRIu64 " blocks compiled | %" PRIu64 " native runs | %u bytes of code\n",
+         state->block_cache->jit_blocks, state->block_cache->jit_runs, state->block_cache->jit_used);
+#endif
+
+#if CPU_IDLE_SKIP
+  double idle_share = state->cycles ? 100.0 * state->idle_cycles / state->cycles : 0;
+  printf("Idle loops: %" PRIu64 " cycles skipped | %.2f%% of all cycles\n", state->idle_cycles, idle_share);
+#endif
+
+#if CPU_DISPATCH == CPU_DISPATCH_AOT
+  cpu_aot_cache *aot = state->aot_cache;
+  printf("AOT: %s | %" PRIu64 " block runs | %" PRIu64 " interpreted instructions | %" PRIu64 " invalidations\n",
+         aot->image ? aot->image->name : "no image", aot->runs, aot->interpreted, aot->invalidations);
+#endif
+}
+
+// One line per instruction, printed before it executes
+void cpu_print_trace(cpu_state *state) {
+  uint8_t op_code = cpu_read_byte(state, state->pc);
+  uint8_t first = cpu_read_byte(state, state->pc + 1);
+  uint8_t second = cpu_read_byte(state, state->pc + 2);
+  char text[32];
+
+  if (disassemble_byte_length[op_code] == 3) {
+    snprintf(text, sizeof(text), disassemble_table[op_code], second, first);
+  } else {
+    snprintf(text, sizeof(text), disassemble_table[op_code], first);
+  }
+
+  printf("%04x  %-16s A=%02x F=%02x BC=%04x DE=%04x HL=%04x SP=%04x\n", state->pc, text, state->a,
+         cpu_get_flags(state), state->bc, state->de, state->hl, state->sp);
+}
+
+void cpu_print_disassembled_op_code(cpu_state *state, uint8_t op_code) {
+  if (disassemble_byte_length[op_code] == 3) {
+    printf(disassemble_table[op_code], cpu_read_byte(state, state->pc + 1), cpu_read_byte(state, state->pc));
+  } else {
+    printf(disassemble_table[op_code], cpu_read_byte(state, state->pc));
+  }
+
+  printf("\n");
+}
+
+// Code comes straight from the guest view of memory, it is never fetched from handler pages
+CPU_ACCESSOR uint8_t cpu_fetch(cpu_state *state) {
+  return state->data[state->pc++];
+}
+
+CPU_ACCESSOR uint16_t cpu_fetch_address(cpu_state *state) {
+  uint16_t address = state->data[state->pc] | state->data[(uint16_t)(state->pc + 1)] << 8;
+  state->pc += 2;
+  return address;
+}
+
+void cpu_set_interrupt(cpu_state *state, uint8_t op_code) {
+  state->interrupt = op_code;
+}
+
+void cpu_handle_interrupt(cpu_state *state) {
+  uint8_t op_code = state->interrupt;
+  uint64_t cycle = state->cycles;
+  state->interrupt = 0;
+
+  if (state->interrupt_enable) {
+    state->halted = 0;
+    cpu_emulate_op_code(state, op_code);
+  }
+
+  if (state->interrupt_handler) {
+    state->interrupt_handler(state->interrupt_context, state, op_code, cycle);
+  }
+}
+
+uint8_t cpu_ends_block(uint8_t op_code) {
+  switch (op_code) {
+    case JMP: case JNZ: case JZ: case JNC: case JC: case JPO: case JPE: case JP: case JM:
+    case CALL: case CNZ: case CZ: case CNC: case CC: case CPO: case CPE: case CP: case CM:
+    case RET: case RNZ: case RZ: case RNC: case RC: case RPO: case RPE: case RP: case RM:
+    case RST_0: case RST_1: case RST_2: case RST_3: case RST_4: case RST_5: case RST_6: case RST_7:
+    case PCHL:
+    case HLT:
+      return 1;
+
+    default:
+      return 0;
+  }
+}
+
+uint8_t cpu_is_pure(uint8_t op_code) {
+  switch (op_code) {
+    case STAX_B: case STAX_D: case SHLD: case STA: case INR_M: case DCR_M: case MVI_M_D8:
+    case MOV_M_B: case MOV_M_C: case MOV_M_D: case MOV_M_E: case MOV_M_H: case MOV_M_L: case MOV_M_A:
+    case PUSH_B: case PUSH_D: case PUSH_H: case PUSH_PSW: case XTHL:
+    case CALL: case CNZ: case CZ: case CNC: case CC: case CPO: case CPE: case CP: case CM:
+    case RST_0: case RST_1: case RST_2: case RST_3: case RST_4: case RST_5: case RST_6: case RST_7:
+    case IN: case OUT: case EI: case DI: case HLT:
+      return 0;
+
+    default:
+      return 1;
+  }
+}
+
+#if CPU_FUSION
+enum CpuFusions {
+#define CPU_FUSION2(name, a, b) FUSION_##name,
+#define CPU_FUSION3(name, a, b, c) FUSION_##name,
+#define CPU_FUSION4(name, a, b, c, d) FUSION_##name,
+#include "cpu_fusions.h"
+#undef CPU_FUSION2
+#undef CPU_FUSION3
+#undef CPU_FUSION4
+  CPU_FUSION_COUNT,
+};
+
+static const struct {
+  uint8_t count;
+  uint8_t op_codes[4];
+} cpu_fusions[CPU_FUSION_COUNT] = {
+#define CPU_FUSION2(name, a, b) {2, {a, b}},
+#define CPU_FUSION3(name, a, b, c) {3, {a, b, c}},
+#define CPU_FUSION4(name, a, b, c, d) {4, {a, b, c, d}},
+#include "cpu_fusions.h"
+#undef CPU_FUSION2
+#undef CPU_FUSION3
+#undef CPU_FUSION4
+};
+
+// The handlers of fused sequences follow the 256 opcode handlers, the other instructions keep their own
+static void cpu_fuse_block(cpu_block *block, void *const *handlers) {
+  for (uint8_t i = 0; i < block->count; i++) {
+    for (uint8_t fusion = 0; fusion < CPU_FUSION_COUNT; fusion++) {
+      uint8_t count = cpu_fusions[fusion].count;
+      uint8_t matched = 0;
+
+      while (matched < count && i + matched < block->count &&
+             block->ops[i + matched].op_code == cpu_fusions[fusion].op_codes[matched]) {
+        matched++;
+      }
+
+      if (matched < count) {
+        continue;
+      }
+
+      cpu_micro_op *op = &block->ops[i];
+      op->handler = handlers[256 + fusion];
+      op->fused_guard = 0;
+
+      for (uint8_t j = 0; j < count - 1; j++) {
+        op->fused_guard += block->ops[i + j].cycles;
+      }
+
+      i += count - 1;
+      break;
+    }
+  }
+}
+#endif
+
+// Adds delta to the count of every address of the code and of its mirrors
+static void cpu_count_code(cpu_block_cache *cache, uint16_t start, uint8_t size, int8_t delta) {
+  for (uint8_t i = 0; i < size; i++) {
+    uint16_t address = start + i;
+    uint16_t alias = address;
+
+    do {
+      cache->code_refs[alias] += delta;
+      alias = memory_next_alias(cache->memory->aliases, alias);
+    } while (alias != address);
+  }
+}
+
+cpu_block *cpu_decode_block(cpu_block_cache *cache, memory_map *memory, uint16_t start, void *const *handlers) {
+  cpu_block *block = malloc(sizeof(cpu_block));
+  block->start = start;
+  block->size = 0;
+  block->count = 0;
+  block->pure = 1;
+  block->link = NULL;
+  block->link_epoch = cache->epoch - 1;
+
+#if CPU_JIT
+  block->hotness = 0;
+  block->native = NULL;
+#endif
+
+  uint16_t pc = start;
+  uint8_t op_code;
+
+  do {
+    op_code = memory_read(memory, pc);
+    cpu_micro_op *op = &block->ops[block->count++];
+
+    op->handler = handlers[op_code];
+    op->op_code = op_code;
+    op->length = disassemble_byte_length[op_code];
+    op->cycles = cycles_per_instruction[op_code];
+    op->imm = op->length == 3 ? cpu_compose(memory_read(memory, pc + 2), memory_read(memory, pc + 1))
+                              : memory_read(memory, pc + 1);
+
+    block->pure &= cpu_is_pure(op_code);
+    block->size += op->length;
+    pc += op->length;
+  } while (!cpu_ends_block(op_code) && block->count < CPU_BLOCK_MAX_OPS);
+
+#if CPU_FUSION
+  cpu_fuse_block(block, handlers);
+#endif
+
+  cpu_count_code(cache, start, block->size, 1);
+  cache->blocks[start] = block;
+  return block;
+}
+
+static void cpu_free_retired_blocks(cpu_block_cache *cache) {
+  while (cache->retired) {
+    cpu_block *block = cache->retired;
+    cache->retired = block->next_retired;
+    free(block);
+  }
+}
+
+cpu_block *cpu_lookup_block(cpu_block_cache *cache, memory_map *memory, uint16_t pc, void *const *handlers) {
+  cpu_free_retired_blocks(cache);
+
+  cpu_block *block = cache->blocks[pc];
+
+  if (block) {
+    cache->hits++;
+    return block;
+  }
+
+  cache->misses++;
+  return cpu_decode_block(cache, memory, pc, handlers);
+}
+
+static void cpu_invalidate_blocks_at(cpu_block_cache *cache, uint16_t address) {
+  for (uint8_t offset = 0; offset < CPU_BLOCK_MAX_BYTES; offset++) {
+    uint16_t start = address - offset;
+    cpu_block *block = cache->blocks[start];
+
+    if (!block || block->size <= offset) {
+      continue;
+    }
+
+    cpu_count_code(cache, start, block->size, -1);
+
+    // The running block may be the one being overwritten, so blocks are freed on the next lookup
+    if (block == cache->current) {
+      cache->current = NULL;
+    }
+
+    cache->blocks[start] = NULL;
+    block->next_retired = cache->retired;
+    cache->retired = block;
+    cache->invalidations++;
+    cache->epoch++;
+  }
+}
+
+// A write through a mirror also changes the code decoded at the other addresses of the byte
+void cpu_invalidate_blocks(cpu_block_cache *cache, uint16_t address) {
+  uint16_t alias = address;
+
+  do {
+    cpu_invalidate_blocks_at(cache, alias);
+    alias = memory_next_alias(cache->memory->aliases, alias);
+  } while (alias != address);
+}
+
+void cpu_flush_block_cache(cpu_block_cache *cache) {
+  for (uint32_t start = 0; start < 0x10000; start++) {
+    free(cache->blocks[start]);
+    cache->blocks[start] = NULL;
+  }
+
+  memset(cache->code_refs, 0, sizeof(cache->code_refs));
+  cache->current = NULL;
+  cache->epoch++;
+  cpu_free_retired_blocks(cache);
+
+#if CPU_JIT
+  jit_reset(cache);
+#endif
+}
+
+uint8_t cpu_attach_aot_image(cpu_state *state, const cpu_aot_image *image) {
+#if CPU_DISPATCH == CPU_DISPATCH_AOT
+  cpu_aot_cache *cache = state->aot_cache;
+
+  // The translation is only valid for the exact image it was generated from
+  if (image->start + image->size > 0x10000 || memcmp(state->memory->data + image->start, image->rom, image->size)) {
+    return 0;
+  }
+
+  for (uint32_t i = 0; i < image->block_count; i++) {
+    const cpu_aot_block *block = &image->blocks[i];
+    cache->entries[block->start] = block;
+
+    for (uint16_t offset = 0; offset < block->size; offset++) {
+      cache->code_refs[(uint16_t) (block->start + offset)]++;
+    }
+  }
+
+  cache->image = image;
+  return 1;
+#else
+  return 0;
+#endif
+}
+
+void cpu_invalidate_aot_blocks(cpu_aot_cache *cache, uint16_t address) {
+  for (uint8_t offset = 0; offset < CPU_BLOCK_MAX_BYTES; offset++) {
+    uint16_t start = address - offset;
+    const cpu_aot_block *block = cache->entries[start];
+
+    if (!block || block->size <= offset) {
+      continue;
+    }
+
+    for (uint16_t i = 0; i < block->size; i++) {
+      cache->code_refs[(uint16_t) (start + i)]--;
+    }
+
+    // Overwritten code is interpreted from now on
+    cache->entries[start] = NULL;
+    cache->invalidations++;
+  }
+}
+
+// First cycle from cycle on at which the beam reaches the scanline
+static uint64_t cpu_next_scanline(uint64_t cycle, uint32_t scanline) {
+  uint64_t next = cycle - cycle % MACHINE_FRAME_CYCLES + scanline * MACHINE_SCANLINE_CYCLES;
+  return next < cycle ? next + MACHINE_FRAME_CYCLES : next;
+}
+
+static void cpu_raise_midscreen(void *context, uint64_t cycle) {
+  cpu_state *state = context;
+  cpu_set_interrupt(state, RST_1);
+  scheduler_add(&state->machine->scheduler, cycle + MACHINE_FRAME_CYCLES, cpu_raise_midscreen, state);
+}
+
+static void cpu_raise_vblank(void *context, uint64_t cycle) {
+  cpu_state *state = context;
+  cpu_set_interrupt(state, RST_2);
+  scheduler_add(&state->machine->scheduler, cycle + MACHINE_FRAME_CYCLES, cpu_raise_vblank, state);
+}
+
+void cpu_start_video(cpu_state *state) {
+  scheduler_state *scheduler = &state->machine->scheduler;
+  scheduler_remove(scheduler, cpu_raise_midscreen, state);
+  scheduler_remove(scheduler, cpu_raise_vblank, state);
+
+  scheduler_add(scheduler, cpu_next_scanline(state->cycles, MACHINE_MIDSCREEN_SCANLINE), cpu_raise_midscreen, state);
+  scheduler_add(scheduler, cpu_next_scanline(state->cycles, MACHINE_VBLANK_SCANLINE), cpu_raise_vblank, state);
+  state->video = 1;
+}
+
+// Runs on guest time from one scheduled event to the next, a halted or idle CPU skips to the next one
+void cpu_start_emulation(cpu_state *state) {
+  scheduler_state *scheduler = &state->machine->scheduler;
+
+  while (state->machine->running) {
+    scheduler_run(scheduler, state->cycles);
+
+    // The host changes the machine between slices
+    if (state->poll_handler) {
+      state->poll_handler(state->poll_context, state, 0);
+    }
+
+    // Events and host commands may stop the emulation
+    if (!state->machine->running) {
+      break;
+    }
+
+    if (state->interrupt) {
+      // RST 2 comes at vblank, a frame is over whether or not the guest takes it
+      uint8_t vblank = state->interrupt == RST_2;
+      cpu_handle_interrupt(state);
+
+      if (vblank && state->frame_handler) {
+        state->frame_handler(state->frame_context, state);
+      }
+
+      // The frame handler may have stopped the emulation, it stops right at the end of the frame
+      if (!state->machine->running) {
+        break;
+      }
+    }
+
+    uint64_t next_event = scheduler_next(scheduler);
+    uint64_t target = state->cycles + CPU_SLICE_CYCLES;
+
+    if (state->halted) {
+      // Nothing can wake a CPU halted with interrupts disabled
+      if (!state->interrupt_enable) {
+        break;
+      }
+
+      // Without events an interrupt can only come from the host, and without a host nothing can wake it either
+      if (next_event == SCHEDULER_NEVER) {
+        if (!state->poll_handler) {
+          break;
+        }
+
+        state->poll_handler(state->poll_context, state, 1);
+        continue;
+      }
+    }
+
+    // A halted CPU passes the cycles up to the event at once
+    if (state->halted) {
+      target = next_event;
+    }
+
+#if CPU_IDLE_SKIP
+    // So does a guest polling memory that only an interrupt handler can change, its loop is skipped
+    if (state->idle && next_event != SCHEDULER_NEVER) {
+      target = next_event;
+    }
+#endif
+
+    if (cpu_run(state, next_event < target ? next_event : target) == CPU_STOP_UNIMPLEMENTED) {
+      cpu_unimplemented_op_code(state, cpu_read_byte(state, state->pc));
+      break;
+    }
+
+#if CPU_IDLE_SKIP
+    if (state->idle && next_event == SCHEDULER_NEVER && state->poll_handler) {
+      state->poll_handler(state->poll_context, state, 1);
+    }
+#endif
+  }
+
+  state->machine->running = 0;
+}
+
+void cpu_unimplemented_op_code(cpu_state *state, uint8_t op_code) {
+  cpu_print_debug_info(state);
+  cpu_print_dump(state);
+  printf("UNIMPLEMENTED INSTRUCTION: 0x%02x at 0x%04x\n", op_code, state->pc);
+}
+
+uint8_t cpu_emulate_op_code(cpu_state *state, uint8_t op_code) {
+  uint8_t branch_taken = 0;
+  cpu_sync_memory(state);
+
+  switch (op_code) {
+#define CPU_OP(name, ...) \
+    case name: \
+      __VA_ARGS__ \
+      break;
+#include "cpu_ops.h"
+#undef CPU_OP
+
+    // No instruction takes zero cycles, the caller reports the opcode
+    default:
+      return 0;
+  }
+
+  uint8_t cycles = branch_taken ? cycles_per_instruction_taken[op_code] : cycles_per_instruction[op_code];
+  state->cycles += cycles;
+
+  return cycles;
+}
+
+#if CPU_DISPATCH == CPU_DISPATCH_THREADED
+
+__attribute__((flatten)) static void cpu_run_threaded(cpu_state *shared, uint64_t cycle_target) {
+  static void *op_labels[256] = {
+    [0 ... 255] = &&op_unimplemented,
+#define CPU_OP(name, ...) [name] = &&op_##name,
+#include "cpu_ops.h"
+#undef CPU_OP
+    [HLT] = &&op_halt,
+  };
+
+  cpu_state local = *shared;
+  cpu_state *state = &local;
+  uint8_t op_code;
+  uint8_t branch_taken;
+
+#define CPU_DISPATCH_NEXT() \
+  if (state->cycles >= cycle_target || shared->interrupt) goto done; \
+  op_code = cpu_fetch(state); \
+  goto *op_labels[op_code]
+
+  CPU_DISPATCH_NEXT();
+
+#define CPU_OP(name, ...) \
+  op_##name: \
+  branch_taken = 0; \
+  __VA_ARGS__ \
+  state->cycles += branch_taken ? cycles_per_instruction_taken[name] : cycles_per_instruction[name]; \
+  CPU_DISPATCH_NEXT();
+#include "cpu_ops.h"
+#undef CPU_OP
+#undef CPU_DISPATCH_NEXT
+
+op_halt:
+  state->halted = 1;
+  goto done;
+
+op_unimplemented:
+  state->pc--;
+  state->stop_reason = CPU_STOP_UNIMPLEMENTED;
+
+done:
+  local.interrupt = shared->interrupt;
+  *shared = local;
+}
+
+#elif CPU_DISPATCH == CPU_DISPATCH_TAIL_CALL
+
+#if defined(__has_attribute)
+#if __has_attribute(musttail)
+#define CPU_MUSTTAIL __attribute__((musttail))
+#endif
+#endif
+
+#ifndef CPU_MUSTTAIL
+#define CPU_MUSTTAIL
+#endif
+
+typedef void (*cpu_tail_handler)(cpu_state *state, cpu_state *shared, uint64_t cycle_target);
+
+static const cpu_tail_handler cpu_tail_handlers[256];
+
+#define CPU_TAIL_DISPATCH_NEXT() \
+  if (state->cycles >= cycle_target || shared->interrupt) return; \
+  uint8_t next_op_code = cpu_fetch(state); \
+  CPU_MUSTTAIL return cpu_tail_handlers[next_op_code](state, shared, cycle_target)
+
+#define CPU_OP(name, ...) \
+  static void cpu_tail_##name(cpu_state *state, cpu_state *shared, uint64_t cycle_target) { \
+    uint8_t branch_taken = 0; \
+    __VA_ARGS__ \
+    state->cycles += branch_taken ? cycles_per_instruction_taken[name] : cycles_per_instruction[name]; \
+    CPU_TAIL_DISPATCH_NEXT(); \
+  }
+#include "cpu_ops.h"
+#undef CPU_OP
+#undef CPU_TAIL_DISPATCH_NEXT
+
+static void cpu_tail_halt(cpu_state *state, cpu_state *shared, uint64_t cycle_target) {
+  state->halted = 1;
+}
+
+static void cpu_tail_unimplemented(cpu_state *state, cpu_state *shared, uint64_t cycle_target) {
+  state->pc--;
+  state->stop_reason = CPU_STOP_UNIMPLEMENTED;
+}
+
+static const cpu_tail_handler cpu_tail_handlers[256] = {
+  [0 ... 255] = cpu_tail_unimplemented,
+#define CPU_OP(name, ...) [name] = cpu_tail_##name,
+#include "cpu_ops.h"
+#undef CPU_OP
+  [HLT] = cpu_tail_halt,
+};
+
+static void cpu_run_tail_call(cpu_state *shared, uint64_t cycle_target) {
+  cpu_state local = *shared;
+
+  // Chains are restarted every slice so the stack stays bounded when musttail is unavailable
+  while (!local.halted && !local.stop_reason && local.cycles < cycle_target && !shared->interrupt) {
+    uint64_t slice_target = local.cycles + CPU_SLICE_CYCLES;
+    uint8_t op_code = cpu_fetch(&local);
+    cpu_tail_handlers[op_code](&local, shared, slice_target < cycle_target ? slice_target : cycle_target);
+  }
+
+  local.interrupt = shared->interrupt;
+  *shared = local;
+}
+
+#elif CPU_DISPATCH == CPU_DISPATCH_BLOCK
+
+#if CPU_JIT
+static uint8_t cpu_run_native(cpu_state *state, cpu_block *block) {
+  // Translated code reads and writes the flags in f
+#if CPU_LAZY_FLAGS
+  cpu_get_flags(state);
+#endif
+
+#if CPU_JIT_CHECK
+  cpu_block_cache *cache = state->block_cache;
+
+  if (!cache->jit_check_memory) {
+    cache->jit_check_memory = malloc(sizeof(memory_map));
+    memory_init(cache->jit_check_memory, state->memory->arena);
+    cache->jit_check_cache = calloc(1, sizeof(cpu_block_cache));
+  }
+
+  cpu_state expected = *state;
+  expected.memory = cache->jit_check_memory;
+  expected.data = expected.memory->data;
+  expected.block_cache = cache->jit_check_cache;
+  expected.block_cache->memory = expected.memory;
+  memory_copy(expected.memory, state->memory);
+#endif
+
+  uint8_t count = block->native(state);
+  state->block_cache->jit_runs++;
+
+#if CPU_LAZY_FLAGS_CHECK
+  state->shadow_flags = state->f;
+#endif
+
+#if CPU_JIT_CHECK
+  cpu_check_jit(state, &expected, block, count);
+#endif
+
+  return count;
+}
+#endif
+
+#if CPU_FUSION
+#undef CPU_IMM8
+#undef CPU_IMM16
+#define CPU_IMM8() ((uint8_t) op->imm)
+#define CPU_IMM16() (op->imm)
+
+// Opcode bodies as functions, so fused handlers can run several of them in a row
+#define CPU_OP(name, ...) \
+  static inline __attribute__((always_inline, unused)) uint8_t cpu_block_##name(cpu_state *state, \
+                                                                               const cpu_micro_op *op) { \
+    uint8_t branch_taken = 0; \
+    __VA_ARGS__ \
+    return branch_taken; \
+  }
+#include "cpu_ops.h"
+#undef CPU_OP
+
+#undef CPU_IMM8
+#undef CPU_IMM16
+#define CPU_IMM8() cpu_fetch(state)
+#define CPU_IMM16() cpu_fetch_address(state)
+#else
+#define CPU_FUSION_COUNT 0
+#endif
+
+#if CPU_IDLE_SKIP
+typedef struct {
+  cpu_block *block;
+  uint64_t start;
+  uint16_t registers[5];
+} cpu_idle_loop;
+
+// A pure block that branched back to itself without changing any register repeats until an interrupt
+// changes memory, so every whole iteration that ends before the cycle target can be skipped
+static void cpu_skip_idle_loop(cpu_state *state, cpu_idle_loop *loop, cpu_block *block, uint64_t cycle_target) {
+  uint16_t registers[5] = {cpu_get_psw(state), state->bc, state->de, state->hl, state->sp};
+
+  if (loop->block == block && !memcmp(registers, loop->registers, sizeof(registers))) {
+    uint64_t iteration = state->cycles - loop->start;
+    uint64_t skipped = (cycle_target - 1 - state->cycles) / iteration * iteration;
+
+    state->cycles += skipped;
+    state->idle_cycles += skipped;
+    state->idle = 1;
+  }
+
+  loop->block = block;
+  loop->start = state->cycles;
+  memcpy(loop->registers, registers, sizeof(registers));
+}
+#endif
+
+__attribute__((flatten)) static void cpu_run_block(cpu_state *shared, uint64_t cycle_target) {
+  static void *op_labels[256 + CPU_FUSION_COUNT] = {
+    [0 ... 255] = &&op_unimplemented,
+#define CPU_OP(name, ...) [name] = &&op_##name,
+#include "cpu_ops.h"
+#undef CPU_OP
+    [HLT] = &&op_halt,
+#if CPU_FUSION
+#define CPU_FUSION2(name, a, b) [256 + FUSION_##name] = &&op_fused_##name,
+#define CPU_FUSION3(name, a, b, c) [256 + FUSION_##name] = &&op_fused_##name,
+#define CPU_FUSION4(name, a, b, c, d) [256 + FUSION_##name] = &&op_fused_##name,
+#include "cpu_fusions.h"
+#undef CPU_FUSION2
+#undef CPU_FUSION3
+#undef CPU_FUSION4
+#endif
+  };
+
+  cpu_state local = *shared;
+  cpu_state *state = &local;
+  cpu_block_cache *cache = state->block_cache;
+  cpu_block *block;
+  const cpu_micro_op *op;
+  const cpu_micro_op *end;
+  uint8_t branch_taken;
+
+#if CPU_IDLE_SKIP
+  cpu_idle_loop idle_loop = {NULL};
+  local.idle = 0;
+#endif
+
+#undef CPU_IMM8
+#undef CPU_IMM16
+#define CPU_IMM8() ((uint8_t) op->imm)
+#define CPU_IMM16() (op->imm)
+
+#define CPU_DISPATCH_OP() \
+  state->pc += op->length; \
+  goto *op->handler
+
+  // A block is left early when an interrupt is pending or when it overwrote itself
+#define CPU_DISPATCH_NEXT() \
+  if (++op == end || !cache->current) goto next_block; \
+  if (state->cycles >= cycle_target || shared->interrupt) goto done; \
+  CPU_DISPATCH_OP()
+
+next_block:
+  if (state->cycles >= cycle_target || shared->interrupt) goto done;
+  block = cache->current;
+
+  // Blocks remember their last successor, any invalidation bumps the epoch and drops every link
+  if (block && block->link_pc == state->pc && block->link_epoch == cache->epoch) {
+    cache->current = block->link;
+    cache->hits++;
+  } else {
+    cache->current = cpu_lookup_block(cache, state->memory, state->pc, op_labels);
+
+    if (block) {
+      block->link = cache->current;
+      block->link_pc = state->pc;
+      block->link_epoch = cache->epoch;
+    }
+  }
+
+#if CPU_IDLE_SKIP
+  if (block == cache->current && block->pure) {
+    cpu_skip_idle_loop(state, &idle_loop, block, cycle_target);
+  } else {
+    idle_loop.block = NULL;
+  }
+#endif
+
+  block = cache->current;
+  end = block->ops + block->count;
+
+#if CPU_JIT
+  // Translated code only runs when the interpreter would not have stopped inside it
+  // Translated code that stopped before its first instruction leaves the whole block to the interpreter
+  if (block->native && state->cycles + block->native_guard < cycle_target) {
+    uint8_t native_count = cpu_run_native(state, block);
+
+    if (native_count) {
+      op = block->ops + native_count - 1;
+      CPU_DISPATCH_NEXT();
+    }
+  }
+
+  if (!block->native && ++block->hotness == CPU_JIT_THRESHOLD) {
+    jit_compile_block(cache, block);
+  }
+#endif
+
+  op = block->ops;
+  CPU_DISPATCH_OP();
+
+#define CPU_OP(name, ...) \
+  op_##name: \
+  branch_taken = 0; \
+  __VA_ARGS__ \
+  state->cycles += branch_taken ? cycles_per_instruction_taken[name] : op->cycles; \
+  CPU_DISPATCH_NEXT();
+#include "cpu_ops.h"
+#undef CPU_OP
+
+#if CPU_FUSION
+  // A fused sequence only runs as a whole when the interpreter would not have stopped inside it
+#define CPU_FUSED_ENTER() \
+  if (state->cycles + op->fused_guard >= cycle_target) goto *op_labels[op->op_code]
+
+#define CPU_FUSED_OP(name) \
+  state->cycles += cpu_block_##name(state, op) ? cycles_per_instruction_taken[name] : op->cycles
+
+#define CPU_FUSED_NEXT() \
+  if (!cache->current) goto next_block; \
+  op++; \
+  state->pc += op->length
+
+#define CPU_FUSION2(name, a, b) \
+  op_fused_##name: \
+  CPU_FUSED_ENTER(); \
+  CPU_FUSED_OP(a); CPU_FUSED_NEXT(); \
+  CPU_FUSED_OP(b); \
+  CPU_DISPATCH_NEXT();
+#define CPU_FUSION3(name, a, b, c) \
+  op_fused_##name: \
+  CPU_FUSED_ENTER(); \
+  CPU_FUSED_OP(a); CPU_FUSED_NEXT(); \
+  CPU_FUSED_OP(b); CPU_FUSED_NEXT(); \
+  CPU_FUSED_OP(c); \
+  CPU_DISPATCH_NEXT();
+#define CPU_FUSION4(name, a, b, c, d) \
+  op_fused_##name: \
+  CPU_FUSED_ENTER(); \
+  CPU_FUSED_OP(a); CPU_FUSED_NEXT(); \
+  CPU_FUSED_OP(b); CPU_FUSED_NEXT(); \
+  CPU_FUSED_OP(c); CPU_FUSED_NEXT(); \
+  CPU_FUSED_OP(d); \
+  CPU_DISPATCH_NEXT();
+#include "cpu_fusions.h"
+#undef CPU_FUSION2
+#undef CPU_FUSION3
+#undef CPU_FUSION4
+#undef CPU_FUSED_ENTER
+#undef CPU_FUSED_OP
+#undef CPU_FUSED_NEXT
+#endif
+
+#undef CPU_DISPATCH_NEXT
+#undef CPU_DISPATCH_OP
+
+#undef CPU_IMM8
+#undef CPU_IMM16
+#define CPU_IMM8() cpu_fetch(state)
+#define CPU_IMM16() cpu_fetch_address(state)
+
+op_halt:
+  state->halted = 1;
+  goto done;
+
+op_unimplemented:
+  state->pc -= op->length;
+  state->stop_reason = CPU_STOP_UNIMPLEMENTED;
+
+done:
+  cache->current = NULL;
+  local.interrupt = shared->interrupt;
+  *shared = local;
+}
+
+#endif
+
+#if CPU_DISPATCH == CPU_DISPATCH_AOT
+
+static void cpu_run_aot(cpu_state *state, uint64_t cycle_target) {
+  cpu_aot_cache *cache = state->aot_cache;
+
+  while (state->cycles < cycle_target && !state->interrupt) {
+    const cpu_aot_block *block = cache->entries[state->pc];
+
+    // Translated blocks only run when the interpreter would not have stopped inside them
+    if (block && state->cycles + block->guard < cycle_target) {
+      block->run(state);
+      cache->runs++;
+      continue;
+    }
+
+    uint8_t op_code = cpu_fetch(state);
+
+    if (op_code == HLT) {
+      state->halted = 1;
+      return;
+    }
+
+    if (!cpu_emulate_op_code(state, op_code)) {
+      state->pc--;
+      state->stop_reason = CPU_STOP_UNIMPLEMENTED;
+      return;
+    }
+
+    cache->interpreted++;
+  }
+}
+
+#endif
+
+#define CPU_INTERPRETER_NAME cpu_interpret_plain
+#define CPU_INTERPRETER_BEFORE(op_code)
+#include "cpu_interpreter.h"
+
+#define CPU_INTERPRETER_NAME cpu_interpret_counting
+#define CPU_INTERPRETER_BEFORE(op_code) state->instructions++
+#include "cpu_interpreter.h"
+
+#define CPU_INTERPRETER_NAME cpu_interpret_tracing
+#define CPU_INTERPRETER_BEFORE(op_code) cpu_print_trace(state)
+#include "cpu_interpreter.h"
+
+// Breakpoints and trapped IN/OUT stop before the instruction runs. Only the instruction the last trap stopped on
+// runs through when it is the first one after resuming, any other first instruction is checked like the rest.
+static inline uint8_t cpu_check_traps(cpu_state *state, uint8_t op_code) {
+  if (state->trap_resume) {
+    state->trap_resume = 0;
+
+    if (state->pc == state->trap_pc) {
+      return CPU_STOP_NONE;
+    }
+  }
+
+  uint8_t trap = CPU_STOP_NONE;
+
+  if (state->breakpoints && state->breakpoints[state->pc]) {
+    trap = CPU_STOP_BREAKPOINT;
+  } else if (state->io_traps && (op_code == IN || op_code == OUT) &&
+             state->io_traps[cpu_read_byte(state, state->pc + 1)]) {
+    trap = CPU_STOP_IO_TRAP;
+  }
+
+  if (trap) {
+    state->trap_resume = 1;
+    state->trap_pc = state->pc;
+  }
+
+  return trap;
+}
+
+#define CPU_INTERPRETER_NAME cpu_interpret_breakpoints
+#define CPU_INTERPRETER_BEFORE(op_code) \
+  uint8_t trap = cpu_check_traps(state, op_code); \
+  if (trap) return trap
+#include "cpu_interpreter.h"
+
+// The plain variant is the engine selected with CPU_DISPATCH, it ignores the instruction count
+static uint8_t cpu_run_engine(cpu_state *state, uint64_t cycle_target, uint64_t count) {
+#if CPU_DISPATCH == CPU_DISPATCH_THREADED
+  cpu_run_threaded(state, cycle_target);
+#elif CPU_DISPATCH == CPU_DISPATCH_TAIL_CALL
+  cpu_run_tail_call(state, cycle_target);
+#elif CPU_DISPATCH == CPU_DISPATCH_BLOCK
+  cpu_run_block(state, cycle_target);
+#elif CPU_DISPATCH == CPU_DISPATCH_AOT
+  cpu_run_aot(state, cycle_target);
+#else
+  return cpu_interpret_plain(state, cycle_target, count);
+#endif
+
+  uint8_t reason = state->stop_reason;
+  state->stop_reason = CPU_STOP_NONE;
+
+  if (reason) {
+    return reason;
+  }
+
+  if (state->halted) {
+    return CPU_STOP_HALT;
+  }
+
+  return state->cycles >= cycle_target ? CPU_STOP_BUDGET : CPU_STOP_INTERRUPT;
+}
+
+static const cpu_interpreter cpu_interpreters[] = {
+  [CPU_INTERPRETER_PLAIN] = cpu_run_engine,
+  [CPU_INTERPRETER_COUNTING] = cpu_interpret_counting,
+  [CPU_INTERPRETER_TRACING] = cpu_interpret_tracing,
+  [CPU_INTERPRETER_BREAKPOINTS] = cpu_interpret_breakpoints,
+};
+
+void cpu_set_frame_handler(cpu_state *state, cpu_frame_handler handler, void *context) {
+  state->frame_handler = handler;
+  state->frame_context = context;
+}
+
+void cpu_set_interrupt_handler(cpu_state *state, cpu_interrupt_handler handler, void *context) {
+  state->interrupt_handler = handler;
+  state->interrupt_context = context;
+}
+
+void cpu_set_poll_handler(cpu_state *state, cpu_poll_handler handler, void *context) {
+  state->poll_handler = handler;
+  state->poll_context = context;
+}
+
+// Breakpoints and I/O traps need the breakpoint variant, the plain one is switched back in once they are cleared
+void cpu_set_interpreter(cpu_state *state, uint8_t interpreter) {
+  if (interpreter == CPU_INTERPRETER_PLAIN && state->trap_count) {
+    interpreter = CPU_INTERPRETER_BREAKPOINTS;
+  }
+
+  state->interpreter = cpu_interpreters[interpreter];
+}
+
+static void cpu_update_traps(cpu_state *state) {
+  if (state->interpreter == cpu_run_engine || state->interpreter == cpu_interpret_breakpoints) {
+    cpu_set_interpreter(state, CPU_INTERPRETER_PLAIN);
+  }
+}
+
+void cpu_set_breakpoint(cpu_state *state, uint16_t address, uint8_t enabled) {
+  if (!state->breakpoints) {
+    state->breakpoints = calloc(0x10000, sizeof(uint8_t));
+  }
+
+  state->trap_count += (enabled != 0) - state->breakpoints[address];
+  state->breakpoints[address] = enabled != 0;
+  cpu_update_traps(state);
+}
+
+void cpu_set_io_trap(cpu_state *state, uint8_t port, uint8_t enabled) {
+  if (!state->io_traps) {
+    state->io_traps = calloc(0x100, sizeof(uint8_t));
+  }
+
+  state->trap_count += (enabled != 0) - state->io_traps[port];
+  state->io_traps[port] = enabled != 0;
+  cpu_update_traps(state);
+}
+
+uint8_t cpu_run_instructions(cpu_state *state, uint64_t count) {
+  if (state->halted) {
+    return CPU_STOP_HALT;
+  }
+
+  cpu_sync_memory(state);
+
+  // Only the generated loops can stop after a number of instructions
+  cpu_interpreter interpreter = state->interpreter == cpu_run_engine ? cpu_interpret_plain : state->interpreter;
+  return interpreter(state, UINT64_MAX, count);
+}
+
+// Runs until the cycle target is reached or something the host has to handle happens
+uint8_t cpu_run(cpu_state *state, uint64_t cycle_target) {
+  // A halted CPU idles until an interrupt is accepted, so the cycles up to the target pass at once
+  if (state->halted) {
+    if (state->cycles < cycle_target) {
+      state->cycles = cycle_target;
+    }
+
+    return CPU_STOP_HALT;
+  }
+
+  cpu_sync_memory(state);
+  return state->interpreter(state, cycle_target, UINT64_MAX);
+}
+
+void cpu_execute_lxi(uint16_t *pair, uint16_t value) {
+  *pair = value;
+}
+
+void cpu_execute_stax(cpu_state *state, uint16_t address) {
+  cpu_write_byte(state, address, state->a);
+}
+
+void cpu_execute_inx(uint16_t *pair) {
+  (*pair)++;
+}
+
+void cpu_execute_inr(cpu_state *state, uint8_t *reg) {
+  (*reg)++;
+  cpu_handle_flags(state, FLAGS_INR, 0, 0, *reg);
+}
+
+void cpu_execute_dcr(cpu_state *state, uint8_t *reg) {
+  (*reg)--;
+  cpu_handle_flags(state, FLAGS_DCR, 0, 0, *reg);
+}
+
+void cpu_execute_mvi(uint8_t *reg, uint8_t value) {
+  *reg = value;
+}
+
+void cpu_execute_rlc(cpu_state *state) {
+  cpu_set_carry(state, state->a >> 7 != 0);
+  state->a = state->a << 1 | state->a >> 7;
+}
+
+void cpu_execute_dad(cpu_state *state, uint16_t pair) {
+  uint32_t res = state->hl + pair;
+
+  cpu_set_carry(state, (res & 0xFFFF0000) > 0);
+
+  state->hl = res;
+}
+
+void cpu_execute_ldax(cpu_state *state, uint16_t address) {
+  state->a = cpu_read_byte(state, address);
+}
+
+void cpu_execute_dcx(uint16_t *pair) {
+  (*pair)--;
+}
+
+void cpu_execute_rrc(cpu_state *state) {
+  uint8_t temp = state->a;
+  state->a = temp >> 1 | temp << 7;
+  cpu_set_carry(state, (state->a >> 7) > 0);
+}
+
+void cpu_execute_ral(cpu_state *state) {
+  uint8_t new_carry = state->a >> 7;
+  state->a = (state->a << 1) | cpu_get_carry(state);
+  cpu_set_carry(state, new_carry);
+}
+
+void cpu_execute_rar(cpu_state *state) {
+  uint8_t new_carry = ((uint8_t) (state->a << 7)) >> 7;
+  state->a = (state->a >> 1) | (cpu_get_carry(state) << 7);
+  cpu_set_carry(state, new_carry);
+}
+
+void cpu_execute_shld(cpu_state *state, uint16_t address) {
+  cpu_write_word(state, address, state->hl);
+}
+
+void cpu_execute_lhld(cpu_state *state, uint16_t address) {
+  state->hl = cpu_read_word(state, address);
+}
+
+void cpu_execute_cma(cpu_state *state) {
+  state->a = ~state->a;
+}
+
+void cpu_execute_sta(cpu_state *state, uint16_t address) {
+  cpu_write_byte(state, address, state->a);
+}
+
+void cpu_execute_inr_m(cpu_state *state) {
+  uint8_t value = cpu_read_byte(state, state->hl);
+  cpu_execute_inr(state, &value);
+  cpu_write_byte(state, state->hl, value);
+}
+
+void cpu_execute_dcr_m(cpu_state *state) {
+  uint8_t value = cpu_read_byte(state, state->hl);
+  cpu_execute_dcr(state, &value);
+  cpu_write_byte(state, state->hl, value);
+}
+
+void cpu_execute_mvi_m(cpu_state *state, uint8_t value) {
+  cpu_write_byte(state, state->hl, value);
+}
+
+void cpu_execute_stc(cpu_state *state) {
+  cpu_set_carry(state, 1);
+}
+
+void cpu_execute_lda(cpu_state *state, uint16_t address) {
+  state->a = cpu_read_byte(state, address);
+}
+
+void cpu_execute_cmc(cpu_state *state) {
+  cpu_set_carry(state, !cpu_get_carry(state));
+}
+
+void cpu_execute_mov_r_r(cpu_state *state, uint8_t *src_register, uint8_t *dest_register) {
+  *src_register = *dest_register;
+}
+
+void cpu_execute_mov_r_m(cpu_state *state, uint8_t *src_register) {
+  *src_register = cpu_read_byte(state, state->hl);
+}
+
+void cpu_execute_mov_m_r(cpu_state *state, uint8_t *src_register) {
+  cpu_write_byte(state, state->hl, *src_register);
+}
+
+void cpu_execute_add_r(cpu_state *state, uint8_t target_register) {
+  uint8_t res = state->a + target_register;
+  cpu_handle_flags(state, FLAGS_ADD, state->a, target_register, res);
+  state->a = res;
+}
+
+void cpu_execute_add_m(cpu_state *state) {
+  cpu_execute_add_r(state, cpu_read_byte(state, state->hl));
+}
+
+void cpu_execute_adc_r(cpu_state *state, uint8_t target_register) {
+  uint8_t res = state->a + target_register + cpu_get_carry(state);
+  cpu_handle_flags(state, FLAGS_ADD, state->a, target_register, res);
+  state->a = res;
+}
+
+void cpu_execute_adc_m(cpu_state *state) {
+  cpu_execute_adc_r(state, cpu_read_byte(state, state->hl));
+}
+
+void cpu_execute_sub_r(cpu_state *state, uint8_t target_register) {
+  uint8_t res = state->a - target_register;
+  cpu_handle_flags(state, FLAGS_SUB, state->a, target_register, res);
+  state->a = res;
+}
+
+void cpu_execute_sub_m(cpu_state *state) {
+  cpu_execute_sub_r(state, cpu_read_byte(state, state->hl));
+}
+
+void cpu_execute_sbb_r(cpu_state *state, uint8_t target_register) {
+  uint8_t res = state->a - target_register - cpu_get_carry(state);
+  cpu_handle_flags(state, FLAGS_SUB, state->a, target_register, res);
+  state->a = res;
+}
+
+void cpu_execute_sbb_m(cpu_state *state) {
+  cpu_execute_sbb_r(state, cpu_read_byte(state, state->hl));
+}
+
+void cpu_execute_ana_r(cpu_state *state, uint8_t target_register) {
+  uint8_t res = state->a & target_register;
+  cpu_handle_flags(state, FLAGS_AND, state->a, target_register, res);
+  state->a = res;
+}
+
+void cpu_execute_ana_m(cpu_state *state) {
+  cpu_execute_ana_r(state, cpu_read_byte(state, state->hl));
+}
+
+void cpu_execute_xra_r(cpu_state *state, uint8_t target_register) {
+  state->a ^= target_register;
+  cpu_handle_flags(state, FLAGS_LOGIC, 0, 0, state->a);
+}
+
+void cpu_execute_xra_m(cpu_state *state) {
+  cpu_execute_xra_r(state, cpu_read_byte(state, state->hl));
+}
+
+void cpu_execute_ora_r(cpu_state *state, uint8_t target_register) {
+  state->a |= target_register;
+  cpu_handle_flags(state, FLAGS_LOGIC, 0, 0, state->a);
+}
+
+void cpu_execute_ora_m(cpu_state *state) {
+  cpu_execute_ora_r(state, cpu_read_byte(state, state->hl));
+}
+
+void cpu_execute_cmp_r(cpu_state *state, uint8_t target_register) {
+  uint8_t res = state->a - target_register;
+  cpu_handle_flags(state, FLAGS_SUB, state->a, target_register, res);
+}
+
+void cpu_execute_cmp_m(cpu_state *state) {
+  cpu_execute_cmp_r(state, cpu_read_byte(state, state->hl));
+}
+
+void cpu_execute_jmp(cpu_state *state, uint16_t address, uint8_t condition) {
+  if (condition) {
+    state->pc = address;
+  }
+}
+
+void cpu_execute_ei(cpu_state *state) {
+  state->interrupt_enable = 1;
+}
+
+void cpu_execute_di(cpu_state *state) {
+  state->interrupt_enable = 0;
+}
+
+uint8_t cpu_execute_call(cpu_state *state, uint16_t address, uint8_t condition) {
+  if (condition) {
+    cpu_execute_push(state, state->pc);
+    state->pc = address;
+  }
+
+  return condition;
+}
+
+uint8_t cpu_execute_ret(cpu_state *state, uint8_t condition) {
+  if (condition) {
+    cpu_execute_pop(state, &state->pc);
+  }
+
+  return condition;
+}
+
+void cpu_execute_rst(cpu_state *state, uint8_t address) {
+  cpu_execute_push(state, state->pc);
+  state->pc = address;
+}
+
+void cpu_execute_push(cpu_state *state, uint16_t pair) {
+  state->sp -= 2;
+  cpu_write_word(state, state->sp, pair);
+}
+
+void cpu_execute_pop(cpu_state *state, uint16_t *pair) {
+  *pair = cpu_read_word(state, state->sp);
+  state->sp += 2;
+}
+
+void cpu_execute_pchl(cpu_state *state) {
+  state->pc = state->hl;
+}
+
+void cpu_execute_sphl(cpu_state *state) {
+  state->sp = state->hl;
+}
+
+void cpu_execute_xthl(cpu_state *state) {
+  uint16_t temp = cpu_read_word(state, state->sp);
+  cpu_write_word(state, state->sp, state->hl);
+  state->hl = temp;
+}
+
+void cpu_execute_xchg(cpu_state *state) {
+  uint16_t temp = state->de;
+  state->de = state->hl;
+  state->hl = temp;
+}
+
+void cpu_execute_adi(cpu_state *state, uint8_t value) {
+  cpu_execute_add_r(state, value);
+}
+
+void cpu_execute_aci(cpu_state *state, uint8_t value) {
+  cpu_execute_adc_r(state, value);
+}
+
+void cpu_execute_sui(cpu_state *state, uint8_t value) {
+  cpu_execute_sub_r(state, value);
+}
+
+void cpu_execute_sbi(cpu_state *state, uint8_t value) {
+  cpu_execute_sbb_r(state, value);
+}
+
+void cpu_execute_ani(cpu_state *state, uint8_t value) {
+  cpu_execute_ana_r(state, value);
+}
+
+void cpu_execute_xri(cpu_state *state, uint8_t value) {
+  cpu_execute_xra_r(state, value);
+}
+
+void cpu_execute_ori(cpu_state *state, uint8_t value) {
+  cpu_execute_ora_r(state, value);
+}
+
+void cpu_execute_cpi(cpu_state *state, uint8_t value) {
+  cpu_execute_cmp_r(state, value);
+}
+
+void cpu_execute_daa(cpu_state *state) {
+  uint8_t flags = cpu_get_flags(state);
+  uint8_t correction = 0;
+  uint8_t carry = flags & FLAG_C;
+
+  if ((state->a & 0x0F) > 0x09 || (flags & FLAG_AC)) {
+    correction += 0x06;
+  }
+
+  if (state->a > 0x99 || carry) {
+    correction += 0x60;
+    carry = 1;
+  }
+
+  cpu_execute_add_r(state, correction);
+  cpu_set_carry(state, carry);
+}
@@ -1,129 +1,456 @@
-#pragma once
-
-#include "definitions.h"
-
-#include <stdint.h>
-#include <stdlib.h>
-#include <stdio.h>
-#include <string.h>
-
-typedef struct {
-  uint8_t c;
-  uint8_t z;
-  uint8_t s;
-  uint8_t p;
-  uint8_t ac;
-} cpu_flags;
-
-typedef struct {
-  uint8_t a;
-  uint8_t b;
-  uint8_t c;
-  uint8_t d;
-  uint8_t e;
-  uint8_t h;
-  uint8_t l;
-
-  uint16_t pc;
-  uint16_t sp;
-
-  uint8_t interrupt_enable;
-
-  cpu_flags flags;
-  uint8_t *memory;
-
-  uint8_t interrupt;
-} cpu_state;
-
-extern uint8_t is_running;
-
-uint16_t cpu_compose(uint8_t high_byte, uint8_t low_byte);
-void cpu_split(uint16_t byte, uint8_t *high_byte, uint8_t *low_byte);
-uint8_t cpu_get_psw(cpu_state *state);
-void cpu_set_psw(cpu_state *state, uint8_t psw);
-
-void cpu_handle_z_flag(cpu_state *state, uint16_t res);
-void cpu_handle_s_flag(cpu_state *state, uint16_t res);
-void cpu_handle_p_flag(cpu_state *state, uint16_t res);
-void cpu_handle_c_flag(cpu_state *state, uint16_t res);
-void cpu_handle_ac_flag(cpu_state *state, uint16_t res);
-void cpu_handle_all_flags(cpu_state *state, uint16_t res);
-
-cpu_state cpu_init(char *file_data, uint32_t file_size);
-void cpu_destroy(cpu_state *state);
-
-void cpu_print_debug_info(cpu_state *state);
-void cpu_print_dump(cpu_state *state);
-void cpu_print_disassembled_op_code(cpu_state *state, uint8_t op_code);
-
-uint8_t cpu_fetch(cpu_state *state);
-uint16_t cpu_fetch_address(cpu_state *state);
-
-void cpu_set_interrupt(cpu_state* state, uint8_t op_code);
-
-void cpu_start_emulation(cpu_state *state);
-void cpu_emulate_op_code(cpu_state *state, uint8_t op_code);
-
-void cpu_execute_lxi(cpu_state *state, uint8_t *high_register, uint8_t *low_register);
-void cpu_execute_stax(cpu_state *state, uint8_t high_register, uint8_t low_register);
-void cpu_execute_inx(uint8_t *high_register, uint8_t *low_register);
-void cpu_execute_inr(cpu_state *state, uint8_t *reg);
-void cpu_execute_dcr(cpu_state *state, uint8_t *reg);
-void cpu_execute_mvi(cpu_state *state, uint8_t *reg);
-void cpu_execute_rlc(cpu_state *state);
-void cpu_execute_dad(cpu_state *state, uint8_t *high_register, uint8_t *low_register);
-void cpu_execute_ldax(cpu_state *state, uint8_t high_register, uint8_t low_register);
-void cpu_execute_dcx(uint8_t *high_register, uint8_t *low_register);
-void cpu_execute_rrc(cpu_state *state);
-void cpu_execute_ral(cpu_state *state);
-void cpu_execute_rar(cpu_state *state);
-void cpu_execute_shld(cpu_state *state);
-void cpu_execute_lhld(cpu_state *state);
-void cpu_execute_cma(cpu_state *state);
-void cpu_execute_sta(cpu_state *state);
-void cpu_execute_inr_m(cpu_state *state);
-void cpu_execute_dcr_m(cpu_state *state);
-void cpu_execute_mvi_m(cpu_state *state);
-void cpu_execute_stc(cpu_state *state);
-void cpu_execute_lda(cpu_state *state);
-void cpu_execute_cmc(cpu_state *state);
-void cpu_execute_mov_r_r(cpu_state *state, uint8_t *src_register, uint8_t *dest_register);
-void cpu_execute_mov_r_m(cpu_state *state, uint8_t *src_register);
-void cpu_execute_mov_m_r(cpu_state *state, uint8_t *src_register);
-void cpu_execute_add_r(cpu_state *state, uint8_t target_register);
-void cpu_execute_add_m(cpu_state *state);
-void cpu_execute_adc_r(cpu_state *state, uint8_t target_register);
-void cpu_execute_adc_m(cpu_state *state);
-void cpu_execute_sub_r(cpu_state *state, uint8_t target_register);
-void cpu_execute_sub_m(cpu_state *state);
-void cpu_execute_sbb_r(cpu_state *state, uint8_t target_register);
-void cpu_execute_sbb_m(cpu_state *state);
-void cpu_execute_ana_r(cpu_state *state, uint8_t target_register);
-void cpu_execute_ana_m(cpu_state *state);
-void cpu_execute_xra_r(cpu_state *state, uint8_t target_register);
-void cpu_execute_xra_m(cpu_state *state);
-void cpu_execute_ora_r(cpu_state *state, uint8_t target_register);
-void cpu_execute_ora_m(cpu_state *state);
-void cpu_execute_cmp_r(cpu_state *state, uint8_t target_register);
-void cpu_execute_cmp_m(cpu_state *state);
-void cpu_execute_jmp(cpu_state *state, uint8_t condition);
-void cpu_execute_ei(cpu_state *state);
-void cpu_execute_di(cpu_state *state);
-void cpu_execute_call(cpu_state *state, uint8_t condition);
-void cpu_execute_ret(cpu_state *state, uint8_t condition);
-void cpu_execute_rst(cpu_state *state, uint8_t address);
-void cpu_execute_push(cpu_state *state, uint8_t high_register, uint8_t low_register);
-void cpu_execute_pop(cpu_state *state, uint8_t *high_register, uint8_t *low_register);
-void cpu_execute_pchl(cpu_state *state);
-void cpu_execute_sphl(cpu_state *state);
-void cpu_execute_xthl(cpu_state *state);
-void cpu_execute_xchg(cpu_state *state);
-void cpu_execute_adi(cpu_state *state);
-void cpu_execute_aci(cpu_state *state);
-void cpu_execute_sui(cpu_state *state);
-void cpu_execute_sbi(cpu_state *state);
-void cpu_execute_ani(cpu_state *state);
-void cpu_execute_xri(cpu_state *state);
-void cpu_execute_ori(cpu_state *state);
-void cpu_execute_cpi(cpu_state *state);
-void cpu_execute_daa(cpu_state *state);
+#pragma once
+
+#include "definitions.h"
+#include "machine.h"
+#include "memory.h"
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define CPU_DISPATCH_SWITCH 0
+#define CPU_DISPATCH_THREADED 1
+#define CPU_DISPATCH_TAIL_CALL 2
+#define CPU_DISPATCH_BLOCK 3
+#define CPU_DISPATCH_AOT 4
+
+#ifndef CPU_JIT_CHECK
+#define CPU_JIT_CHECK 0
+#endif
+
+#if CPU_JIT_CHECK
+#undef CPU_JIT
+#define CPU_JIT 1
+#endif
+
+#ifndef CPU_JIT
+#define CPU_JIT 0
+#endif
+
+// The JIT promotes hot blocks of the block cache engine
+#if CPU_JIT
+#undef CPU_DISPATCH
+#define CPU_DISPATCH CPU_DISPATCH_BLOCK
+#endif
+
+#ifndef CPU_DISPATCH
+#define CPU_DISPATCH CPU_DISPATCH_SWITCH
+#endif
+
+// Polling loops of the block engine are fast-forwarded to the cycle target
+#ifndef CPU_IDLE_SKIP
+#define CPU_IDLE_SKIP 1
+#endif
+
+#if CPU_DISPATCH != CPU_DISPATCH_BLOCK
+#undef CPU_IDLE_SKIP
+#define CPU_IDLE_SKIP 0
+#endif
+
+// Superinstructions of the block engine, see cpu_fusions.h
+#ifndef CPU_FUSION
+#define CPU_FUSION 1
+#endif
+
+#define CPU_JIT_THRESHOLD 64
+#define CPU_JIT_CODE_SIZE (4 * 1024 * 1024)
+
+#ifndef CPU_LAZY_FLAGS_CHECK
+#define CPU_LAZY_FLAGS_CHECK 0
+#endif
+
+#if CPU_LAZY_FLAGS_CHECK
+#undef CPU_LAZY_FLAGS
+#define CPU_LAZY_FLAGS 1
+#endif
+
+#ifndef CPU_LAZY_FLAGS
+#define CPU_LAZY_FLAGS 0
+#endif
+
+enum FlagOperations {
+  FLAGS_NONE = 0x0,
+  FLAGS_ADD = 0x1,
+  FLAGS_SUB = 0x2,
+  FLAGS_AND = 0x3,
+  FLAGS_LOGIC = 0x4,
+  FLAGS_INR = 0x5,
+  FLAGS_DCR = 0x6,
+};
+
+// Why cpu_run returned, the pc is left on the instruction that stopped it
+enum StopReasons {
+  CPU_STOP_NONE = 0x0,
+  CPU_STOP_BUDGET = 0x1,
+  CPU_STOP_INTERRUPT = 0x2,
+  CPU_STOP_HALT = 0x3,
+  CPU_STOP_BREAKPOINT = 0x4,
+  CPU_STOP_UNIMPLEMENTED = 0x5,
+  CPU_STOP_IO_TRAP = 0x6,
+};
+
+// Loops cpu_run can be switched to at runtime, all generated from cpu_ops.h by cpu_interpreter.h
+enum Interpreters {
+  CPU_INTERPRETER_PLAIN = 0x0,
+  CPU_INTERPRETER_COUNTING = 0x1,
+  CPU_INTERPRETER_TRACING = 0x2,
+  CPU_INTERPRETER_BREAKPOINTS = 0x3,
+};
+
+typedef struct {
+  uint8_t op;
+  uint8_t first;
+  uint8_t second;
+  uint8_t res;
+} cpu_lazy_flags;
+
+#define CPU_BLOCK_MAX_OPS 32
+#define CPU_BLOCK_MAX_BYTES (CPU_BLOCK_MAX_OPS * 3)
+
+struct cpu_state;
+
+// Runs a translated prefix of a block and returns how many of its micro-ops were executed
+typedef uint8_t (*cpu_native_block)(struct cpu_state *state);
+
+// One predecoded instruction, the handler is the engine's label for the opcode
+typedef struct {
+  const void *handler;
+  uint16_t imm;
+  uint8_t op_code;
+  uint8_t length;
+  uint8_t cycles;
+  // Cycles spent before the last instruction of the fused sequence starting here
+  uint8_t fused_guard;
+} cpu_micro_op;
+
+// Straight-line code from start up to and including the first control transfer
+typedef struct cpu_block {
+  uint16_t start;
+  uint8_t size;
+  uint8_t count;
+  // No instruction writes memory, does I/O or changes the interrupt state
+  uint8_t pure;
+  struct cpu_block *next_retired;
+
+  struct cpu_block *link;
+  uint16_t link_pc;
+  uint32_t link_epoch;
+
+#if CPU_JIT
+  uint32_t hotness;
+  // Cycles spent before the last translated instruction
+  uint32_t native_guard;
+  cpu_native_block native;
+#endif
+  cpu_micro_op ops[CPU_BLOCK_MAX_OPS];
+} cpu_block;
+
+typedef struct cpu_block_cache {
+  cpu_block *blocks[0x10000];
+  // Code is counted at every mirror of its bytes, remapping memory needs a flush
+  memory_map *memory;
+  // Number of cached blocks covering each address, writes to a covered address invalidate them
+  uint8_t code_refs[0x10000];
+
+  cpu_block *current;
+  cpu_block *retired;
+  uint32_t epoch;
+
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t invalidations;
+
+#if CPU_JIT
+  uint8_t *jit_code;
+  uint32_t jit_used;
+  uint64_t jit_blocks;
+  uint64_t jit_runs;
+#endif
+#if CPU_JIT_CHECK
+  memory_map *jit_check_memory;
+  struct cpu_block_cache *jit_check_cache;
+#endif
+} cpu_block_cache;
+
+// Runs up to cycle_target or count instructions and returns a stop reason
+typedef uint8_t (*cpu_interpreter)(struct cpu_state *state, uint64_t cycle_target, uint64_t count);
+
+// Called by cpu_start_emulation on the emulation thread
+typedef void (*cpu_frame_handler)(void *context, struct cpu_state *state);
+
+// Called by cpu_handle_interrupt with the interrupt it took and the cycle it came at, whether or not the guest
+// accepted it
+typedef void (*cpu_interrupt_handler)(void *context, struct cpu_state *state, uint8_t op_code, uint64_t cycle);
+
+// Called by cpu_start_emulation between slices, the only place the host changes the machine. wait is set when
+// nothing on guest time can wake the CPU, it is halted or idling with no event scheduled: the handler then blocks
+// until the host raised an interrupt or stopped the machine
+typedef void (*cpu_poll_handler)(void *context, struct cpu_state *state, uint8_t wait);
+
+// Straight-line code of a known ROM translated to C by the recompiler
+typedef void (*cpu_aot_function)(struct cpu_state *state);
+
+typedef struct {
+  uint16_t start;
+  uint16_t size;
+  // Cycles spent before the last instruction of the block
+  uint32_t guard;
+  cpu_aot_function run;
+} cpu_aot_block;
+
+typedef struct {
+  const char *name;
+  uint16_t start;
+  uint32_t size;
+  const uint8_t *rom;
+  const cpu_aot_block *blocks;
+  uint32_t block_count;
+} cpu_aot_image;
+
+typedef struct {
+  const cpu_aot_block *entries[0x10000];
+  // Number of translated blocks covering each address, writes to a covered address invalidate them
+  uint8_t code_refs[0x10000];
+
+  const cpu_aot_image *image;
+
+  uint64_t runs;
+  uint64_t interpreted;
+  uint64_t invalidations;
+} cpu_aot_cache;
+
+// Register pairs alias their 8-bit halves, so BC/DE/HL/PSW are plain host words
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define CPU_REGISTER_PAIR(pair, high, low) \
+  union {                                  \
+    uint16_t pair;                         \
+    struct {                               \
+      uint8_t high;                        \
+      uint8_t low;                         \
+    };                                     \
+  }
+#else
+#define CPU_REGISTER_PAIR(pair, high, low) \
+  union {                                  \
+    uint16_t pair;                         \
+    struct {                               \
+      uint8_t low;                         \
+      uint8_t high;                        \
+    };                                     \
+  }
+#endif
+
+// Hot fields first: the registers, flags, sp, pc, cycles and what the inlined accessors and the engine's cache
+// need fit in the first 64 bytes. Everything after them is only touched between runs or on a slow path.
+typedef struct cpu_state {
+  CPU_REGISTER_PAIR(psw, a, f);
+  CPU_REGISTER_PAIR(bc, b, c);
+  CPU_REGISTER_PAIR(de, d, e);
+  CPU_REGISTER_PAIR(hl, h, l);
+
+  uint16_t sp;
+  uint16_t pc;
+
+  uint8_t interrupt_enable;
+  uint8_t interrupt;
+  // Set by HLT until an interrupt is accepted
+  uint8_t halted;
+  // Set by an engine that stopped before its cycle target for a reason it cannot tell otherwise
+  uint8_t stop_reason;
+
+  cpu_lazy_flags lazy_flags;
+#if CPU_LAZY_FLAGS_CHECK
+  uint8_t shadow_flags;
+#endif
+  // memory->slow_writes, copied whenever the CPU starts running since maps only change between runs. Saves every
+  // store a load through the map
+  uint16_t slow_writes;
+
+  uint64_t cycles;
+
+  memory_map *memory;
+  // memory->data, kept here so the inlined accessors skip the map
+  uint8_t *data;
+  // Devices behind IN and OUT, only touched on the emulation thread: the host changes them from its poll handler
+  machine_state *machine;
+#if CPU_DISPATCH == CPU_DISPATCH_BLOCK
+  cpu_block_cache *block_cache;
+#endif
+#if CPU_DISPATCH == CPU_DISPATCH_AOT
+  cpu_aot_cache *aot_cache;
+#endif
+
+  // Cold fields
+#if CPU_IDLE_SKIP
+  // Cycles fast-forwarded in polling loops, idle is set when the last run skipped any
+  uint64_t idle_cycles;
+  uint8_t idle;
+#endif
+
+  // Flags per address and per port, cpu_run steps one instruction at a time while any is set
+  uint8_t *breakpoints;
+  uint8_t *io_traps;
+  uint32_t trap_count;
+  // Set on the pc a breakpoint or I/O trap stopped on, the next run executes that instruction instead of stopping
+  uint8_t trap_resume;
+  uint16_t trap_pc;
+
+  // Loop run by cpu_run, see cpu_set_interpreter
+  cpu_interpreter interpreter;
+  // Only counted by the counting interpreter
+  uint64_t instructions;
+  // Set when cpu_init made the map, cpu_destroy then frees it
+  uint8_t owns_memory;
+  // Run after every vblank interrupt, see cpu_set_frame_handler
+  cpu_frame_handler frame_handler;
+  void *frame_context;
+  cpu_interrupt_handler interrupt_handler;
+  void *interrupt_context;
+  cpu_poll_handler poll_handler;
+  void *poll_context;
+  // Set by cpu_start_video, the screen interrupts are events of the machine scheduler
+  uint8_t video;
+} cpu_state;
+
+uint16_t cpu_compose(uint8_t high_byte, uint8_t low_byte);
+void cpu_split(uint16_t byte, uint8_t *high_byte, uint8_t *low_byte);
+uint8_t cpu_read_byte(cpu_state *state, uint16_t address);
+void cpu_write_byte(cpu_state *state, uint16_t address, uint8_t value);
+uint16_t cpu_read_word(cpu_state *state, uint16_t address);
+void cpu_write_word(cpu_state *state, uint16_t address, uint16_t value);
+uint16_t cpu_get_psw(cpu_state *state);
+void cpu_set_psw(cpu_state *state, uint16_t psw);
+
+void cpu_compute_zsp_flags(uint8_t *flags, uint8_t res);
+void cpu_compute_inr_flags(uint8_t *flags, uint8_t res);
+void cpu_compute_dcr_flags(uint8_t *flags, uint8_t res);
+uint8_t cpu_carry_index(uint8_t first, uint8_t second, uint8_t res);
+void cpu_compute_add_flags(uint8_t *flags, uint8_t first, uint8_t second, uint8_t res);
+void cpu_compute_sub_flags(uint8_t *flags, uint8_t first, uint8_t second, uint8_t res);
+void cpu_compute_logic_flags(uint8_t *flags, uint8_t res, uint8_t ac);
+void cpu_compute_flags(uint8_t *flags, uint8_t op, uint8_t first, uint8_t second, uint8_t res);
+
+void cpu_handle_flags(cpu_state *state, uint8_t op, uint8_t first, uint8_t second, uint8_t res);
+uint8_t cpu_get_flags(cpu_state *state);
+uint8_t cpu_get_carry(cpu_state *state);
+void cpu_set_carry(cpu_state *state, uint8_t carry);
+void cpu_check_lazy_flags(cpu_state *state, uint8_t flags);
+
+uint8_t cpu_parity(uint8_t value);
+uint32_t cpu_check_flags(uint8_t flags, uint8_t res, uint8_t c, uint8_t ac);
+uint32_t cpu_check_flag_tables();
+void cpu_check_jit(cpu_state *state, cpu_state *expected, cpu_block *block, uint8_t count);
+
+cpu_state cpu_init(machine_state *machine, char *file_data, uint32_t file_size);
+// Runs on a map set up by the caller, which outlives the state
+cpu_state cpu_init_memory(machine_state *machine, memory_map *memory);
+void cpu_reset(cpu_state *state);
+void cpu_load_memory(cpu_state *state, const uint8_t *memory);
+// The pages set in pages from consecutive bytes of data, in ascending order
+void cpu_load_pages(cpu_state *state, uint32_t pages, const uint8_t *data);
+void cpu_destroy(cpu_state *state);
+
+void cpu_print_debug_info(cpu_state *state);
+void cpu_print_dump(cpu_state *state);
+void cpu_print_cycle_info(cpu_state *state, uint32_t elapsed_ms);
+void cpu_print_disassembled_op_code(cpu_state *state, uint8_t op_code);
+void cpu_print_trace(cpu_state *state);
+void cpu_print_block_cache_info(cpu_state *state);
+
+uint8_t cpu_fetch(cpu_state *state);
+uint16_t cpu_fetch_address(cpu_state *state);
+
+void cpu_set_interrupt(cpu_state* state, uint8_t op_code);
+void cpu_handle_interrupt(cpu_state *state);
+
+uint8_t cpu_ends_block(uint8_t op_code);
+cpu_block *cpu_decode_block(cpu_block_cache *cache, memory_map *memory, uint16_t start, void *const *handlers);
+cpu_block *cpu_lookup_block(cpu_block_cache *cache, memory_map *memory, uint16_t pc, void *const *handlers);
+void cpu_invalidate_blocks(cpu_block_cache *cache, uint16_t address);
+void cpu_flush_block_cache(cpu_block_cache *cache);
+
+uint8_t cpu_attach_aot_image(cpu_state *state, const cpu_aot_image *image);
+void cpu_invalidate_aot_blocks(cpu_aot_cache *cache, uint16_t address);
+
+uint8_t cpu_is_pure(uint8_t op_code);
+
+// Schedules RST 1 and RST 2 at their scanlines from the frame the cycle counter is in, again after a load
+void cpu_start_video(cpu_state *state);
+void cpu_start_emulation(cpu_state *state);
+void cpu_set_interpreter(cpu_state *state, uint8_t interpreter);
+void cpu_set_frame_handler(cpu_state *state, cpu_frame_handler handler, void *context);
+void cpu_set_interrupt_handler(cpu_state *state, cpu_interrupt_handler handler, void *context);
+// Without one a CPU halted with no event scheduled stops the emulation
+void cpu_set_poll_handler(cpu_state *state, cpu_poll_handler handler, void *context);
+void cpu_set_breakpoint(cpu_state *state, uint16_t address, uint8_t enabled);
+void cpu_set_io_trap(cpu_state *state, uint8_t port, uint8_t enabled);
+uint8_t cpu_run(cpu_state *state, uint64_t cycle_target);
+uint8_t cpu_run_instructions(cpu_state *state, uint64_t count);
+void cpu_unimplemented_op_code(cpu_state *state, uint8_t op_code);
+uint8_t cpu_emulate_op_code(cpu_state *state, uint8_t op_code);
+
+void cpu_execute_lxi(uint16_t *pair, uint16_t value);
+void cpu_execute_stax(cpu_state *state, uint16_t address);
+void cpu_execute_inx(uint16_t *pair);
+void cpu_execute_inr(cpu_state *state, uint8_t *reg);
+void cpu_execute_dcr(cpu_state *state, uint8_t *reg);
+void cpu_execute_mvi(uint8_t *reg, uint8_t value);
+void cpu_execute_rlc(cpu_state *state);
+void cpu_execute_dad(cpu_state *state, uint16_t pair);
+void cpu_execute_ldax(cpu_state *state, uint16_t address);
+void cpu_execute_dcx(uint16_t *pair);
+void cpu_execute_rrc(cpu_state *state);
+void cpu_execute_ral(cpu_state *state);
+void cpu_execute_rar(cpu_state *state);
+void cpu_execute_shld(cpu_state *state, uint16_t address);
+void cpu_execute_lhld(cpu_state *state, uint16_t address);
+void cpu_execute_cma(cpu_state *state);
+void cpu_execute_sta(cpu_state *state, uint16_t address);
+void cpu_execute_inr_m(cpu_state *state);
+void cpu_execute_dcr_m(cpu_state *state);
+void cpu_execute_mvi_m(cpu_state *state, uint8_t value);
+void cpu_execute_stc(cpu_state *state);
+void cpu_execute_lda(cpu_state *state, uint16_t address);
+void cpu_execute_cmc(cpu_state *state);
+void cpu_execute_mov_r_r(cpu_state *state, uint8_t *src_register, uint8_t *dest_register);
+void cpu_execute_mov_r_m(cpu_state *state, uint8_t *src_register);
+void cpu_execute_mov_m_r(cpu_state *state, uint8_t *src_register);
+void cpu_execute_add_r(cpu_state *state, uint8_t target_register);
+void cpu_execute_add_m(cpu_state *state);
+void cpu_execute_adc_r(cpu_state *state, uint8_t target_register);
+void cpu_execute_adc_m(cpu_state *state);
+void cpu_execute_sub_r(cpu_state *state, uint8_t target_register);
+void cpu_execute_sub_m(cpu_state *state);
+void cpu_execute_sbb_r(cpu_state *state, uint8_t target_register);
+void cpu_execute_sbb_m(cpu_state *state);
+void cpu_execute_ana_r(cpu_state *state, uint8_t target_register);
+void cpu_execute_ana_m(cpu_state *state);
+void cpu_execute_xra_r(cpu_state *state, uint8_t target_register);
+void cpu_execute_xra_m(cpu_state *state);
+void cpu_execute_ora_r(cpu_state *state, uint8_t target_register);
+void cpu_execute_ora_m(cpu_state *state);
+void cpu_execute_cmp_r(cpu_state *state, uint8_t target_register);
+void cpu_execute_cmp_m(cpu_state *state);
+void cpu_execute_jmp(cpu_state *state, uint16_t address, uint8_t condition);
+void cpu_execute_ei(cpu_state *state);
+void cpu_execute_di(cpu_state *state);
+uint8_t cpu_execute_call(cpu_state *state, uint16_t address, uint8_t condition);
+uint8_t cpu_execute_ret(cpu_state *state, uint8_t condition);
+void cpu_execute_rst(cpu_state *state, uint8_t address);
+void cpu_execute_push(cpu_state *state, uint16_t pair);
+void cpu_execute_pop(cpu_state *state, uint16_t *pair);
+void cpu_execute_pchl(cpu_state *state);
+void cpu_execute_sphl(cpu_state *state);
+void cpu_execute_xthl(cpu_state *state);
+void cpu_execute_xchg(cpu_state *state);
+void cpu_execute_adi(cpu_state *state, uint8_t value);
+void cpu_execute_aci(cpu_state *state, uint8_t value);
+void cpu_execute_sui(cpu_state *state, uint8_t value);
+void cpu_execute_sbi(cpu_state *state, uint8_t value);
+void cpu_execute_ani(cpu_state *state, uint8_t value);
+void cpu_execute_xri(cpu_state *state, uint8_t value);
+void cpu_execute_ori(cpu_state *state, uint8_t value);
+void cpu_execute_cpi(cpu_state *state, uint8_t value);
+void cpu_execute_daa(cpu_state *state);
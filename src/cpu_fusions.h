@@ -0,0 +1,16 @@
+// Superinstructions of the block engine, ranked with the ngrams tool on invaders.rom and cpudiag.rom.
+// Include this file after defining CPU_FUSION2/3/4(name, ops...); blocks are matched from their first
+// instruction and the first sequence that matches wins, so longer sequences come first.
+// Every instruction but the last must not end a block.
+
+CPU_FUSION4(LDAX_D_MOV_M_A_INX_H_INX_D, LDAX_D, MOV_M_A, INX_H, INX_D)
+
+CPU_FUSION3(LDA_DCR_A_JNZ, LDA, DCR_A, JNZ)
+CPU_FUSION3(LDA_ANA_A_JNZ, LDA, ANA_A, JNZ)
+CPU_FUSION3(LDA_ANA_A_JZ, LDA, ANA_A, JZ)
+CPU_FUSION3(MOV_A_M_ANA_A_JNZ, MOV_A_M, ANA_A, JNZ)
+CPU_FUSION3(INX_H_DCR_B_JNZ, INX_H, DCR_B, JNZ)
+
+CPU_FUSION2(DCR_B_JNZ, DCR_B, JNZ)
+CPU_FUSION2(CPI_JZ, CPI_D8, JZ)
+CPU_FUSION2(CPI_CNZ, CPI_D8, CNZ)
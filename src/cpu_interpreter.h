@@ -0,0 +1,45 @@
+// Interpreter loop over the opcodes of cpu_ops.h, included by cpu.c once per variant.
+// Define CPU_INTERPRETER_NAME and CPU_INTERPRETER_BEFORE(op_code) first, the hook runs before every instruction
+// with the pc still on the opcode and may return a stop reason; executed counts the instructions of this run.
+
+static uint8_t CPU_INTERPRETER_NAME(cpu_state *state, uint64_t cycle_target, uint64_t count) {
+  for (uint64_t executed = 0; executed < count; executed++) {
+    if (state->cycles >= cycle_target) {
+      return CPU_STOP_BUDGET;
+    }
+
+    if (state->interrupt) {
+      return CPU_STOP_INTERRUPT;
+    }
+
+    uint8_t op_code = state->data[state->pc];
+    uint8_t branch_taken = 0;
+
+    CPU_INTERPRETER_BEFORE(op_code);
+    state->pc++;
+
+    switch (op_code) {
+#define CPU_OP(name, ...) \
+      case name: \
+        __VA_ARGS__ \
+        break;
+#include "cpu_ops.h"
+#undef CPU_OP
+
+      case HLT:
+        state->halted = 1;
+        return CPU_STOP_HALT;
+
+      default:
+        state->pc--;
+        return CPU_STOP_UNIMPLEMENTED;
+    }
+
+    state->cycles += branch_taken ? cycles_per_instruction_taken[op_code] : cycles_per_instruction[op_code];
+  }
+
+  return CPU_STOP_BUDGET;
+}
+
+#undef CPU_INTERPRETER_NAME
+#undef CPU_INTERPRETER_BEFORE
@@ -0,0 +1,979 @@
+// Opcode semantics shared by every dispatch engine in cpu.c.
+// Include this file after defining CPU_OP(name, body); inside a body, state points at the
+// cpu_state being executed and branch_taken must be set by conditional CALL/RET.
+// Immediate operands are read with CPU_IMM8()/CPU_IMM16(), which advance pc unless the engine predecoded them.
+// HLT and the undocumented opcodes are handled by the engines themselves.
+
+CPU_OP(NOP, {})
+
+CPU_OP(LXI_B, {
+  cpu_execute_lxi(&state->bc, CPU_IMM16());
+})
+
+CPU_OP(STAX_B, {
+  cpu_execute_stax(state, state->bc);
+})
+
+CPU_OP(INX_B, {
+  cpu_execute_inx(&state->bc);
+})
+
+CPU_OP(INR_B, {
+  cpu_execute_inr(state, &state->b);
+})
+
+CPU_OP(DCR_B, {
+  cpu_execute_dcr(state, &state->b);
+})
+
+CPU_OP(MVI_B_D8, {
+  cpu_execute_mvi(&state->b, CPU_IMM8());
+})
+
+CPU_OP(RLC, {
+  cpu_execute_rlc(state);
+})
+
+CPU_OP(DAD_B, {
+  cpu_execute_dad(state, state->bc);
+})
+
+CPU_OP(LDAX_B, {
+  cpu_execute_ldax(state, state->bc);
+})
+
+CPU_OP(DCX_B, {
+  cpu_execute_dcx(&state->bc);
+})
+
+CPU_OP(INR_C, {
+  cpu_execute_inr(state, &state->c);
+})
+
+CPU_OP(DCR_C, {
+  cpu_execute_dcr(state, &state->c);
+})
+
+CPU_OP(MVI_C_D8, {
+  cpu_execute_mvi(&state->c, CPU_IMM8());
+})
+
+CPU_OP(RRC, {
+  cpu_execute_rrc(state);
+})
+
+CPU_OP(LXI_D, {
+  cpu_execute_lxi(&state->de, CPU_IMM16());
+})
+
+CPU_OP(STAX_D, {
+  cpu_execute_stax(state, state->de);
+})
+
+CPU_OP(INX_D, {
+  cpu_execute_inx(&state->de);
+})
+
+CPU_OP(INR_D, {
+  cpu_execute_inr(state, &state->d);
+})
+
+CPU_OP(DCR_D, {
+  cpu_execute_dcr(state, &state->d);
+})
+
+CPU_OP(MVI_D_D8, {
+  cpu_execute_mvi(&state->d, CPU_IMM8());
+})
+
+CPU_OP(RAL, {
+  cpu_execute_ral(state);
+})
+
+CPU_OP(DAD_D, {
+  cpu_execute_dad(state, state->de);
+})
+
+CPU_OP(LDAX_D, {
+  cpu_execute_ldax(state, state->de);
+})
+
+CPU_OP(DCX_D, {
+  cpu_execute_dcx(&state->de);
+})
+
+CPU_OP(INR_E, {
+  cpu_execute_inr(state, &state->e);
+})
+
+CPU_OP(DCR_E, {
+  cpu_execute_dcr(state, &state->e);
+})
+
+CPU_OP(MVI_E_D8, {
+  cpu_execute_mvi(&state->e, CPU_IMM8());
+})
+
+CPU_OP(RAR, {
+  cpu_execute_rar(state);
+})
+
+CPU_OP(LXI_H, {
+  cpu_execute_lxi(&state->hl, CPU_IMM16());
+})
+
+CPU_OP(SHLD, {
+  cpu_execute_shld(state, CPU_IMM16());
+})
+
+CPU_OP(INX_H, {
+  cpu_execute_inx(&state->hl);
+})
+
+CPU_OP(INR_H, {
+  cpu_execute_inr(state, &state->h);
+})
+
+CPU_OP(DCR_H, {
+  cpu_execute_dcr(state, &state->h);
+})
+
+CPU_OP(MVI_H_D8, {
+  cpu_execute_mvi(&state->h, CPU_IMM8());
+})
+
+CPU_OP(DAA, {
+  cpu_execute_daa(state);
+})
+
+CPU_OP(DAD_H, {
+  cpu_execute_dad(state, state->hl);
+})
+
+CPU_OP(LHLD, {
+  cpu_execute_lhld(state, CPU_IMM16());
+})
+
+CPU_OP(DCX_H, {
+  cpu_execute_dcx(&state->hl);
+})
+
+CPU_OP(INR_L, {
+  cpu_execute_inr(state, &state->l);
+})
+
+CPU_OP(DCR_L, {
+  cpu_execute_dcr(state, &state->l);
+})
+
+CPU_OP(MVI_L_D8, {
+  cpu_execute_mvi(&state->l, CPU_IMM8());
+})
+
+CPU_OP(CMA, {
+  cpu_execute_cma(state);
+})
+
+CPU_OP(LXI_SP, {
+  cpu_execute_lxi(&state->sp, CPU_IMM16());
+})
+
+CPU_OP(STA, {
+  cpu_execute_sta(state, CPU_IMM16());
+})
+
+CPU_OP(INX_SP, {
+  cpu_execute_inx(&state->sp);
+})
+
+CPU_OP(INR_M, {
+  cpu_execute_inr_m(state);
+})
+
+CPU_OP(DCR_M, {
+  cpu_execute_dcr_m(state);
+})
+
+CPU_OP(MVI_M_D8, {
+  cpu_execute_mvi_m(state, CPU_IMM8());
+})
+
+CPU_OP(STC, {
+  cpu_execute_stc(state);
+})
+
+CPU_OP(DAD_SP, {
+  cpu_execute_dad(state, state->sp);
+})
+
+CPU_OP(LDA, {
+  cpu_execute_lda(state, CPU_IMM16());
+})
+
+CPU_OP(DCX_SP, {
+  cpu_execute_dcx(&state->sp);
+})
+
+CPU_OP(INR_A, {
+  cpu_execute_inr(state, &state->a);
+})
+
+CPU_OP(DCR_A, {
+  cpu_execute_dcr(state, &state->a);
+})
+
+CPU_OP(MVI_A_D8, {
+  cpu_execute_mvi(&state->a, CPU_IMM8());
+})
+
+CPU_OP(CMC, {
+  cpu_execute_cmc(state);
+})
+
+CPU_OP(MOV_B_B, {
+  cpu_execute_mov_r_r(state, &state->b, &state->b);
+})
+
+CPU_OP(MOV_B_C, {
+  cpu_execute_mov_r_r(state, &state->b, &state->c);
+})
+
+CPU_OP(MOV_B_D, {
+  cpu_execute_mov_r_r(state, &state->b, &state->d);
+})
+
+CPU_OP(MOV_B_E, {
+  cpu_execute_mov_r_r(state, &state->b, &state->e);
+})
+
+CPU_OP(MOV_B_H, {
+  cpu_execute_mov_r_r(state, &state->b, &state->h);
+})
+
+CPU_OP(MOV_B_L, {
+  cpu_execute_mov_r_r(state, &state->b, &state->l);
+})
+
+CPU_OP(MOV_B_M, {
+  cpu_execute_mov_r_m(state, &state->b);
+})
+
+CPU_OP(MOV_B_A, {
+  cpu_execute_mov_r_r(state, &state->b, &state->a);
+})
+
+CPU_OP(MOV_C_B, {
+  cpu_execute_mov_r_r(state, &state->c, &state->b);
+})
+
+CPU_OP(MOV_C_C, {
+  cpu_execute_mov_r_r(state, &state->c, &state->c);
+})
+
+CPU_OP(MOV_C_D, {
+  cpu_execute_mov_r_r(state, &state->c, &state->d);
+})
+
+CPU_OP(MOV_C_E, {
+  cpu_execute_mov_r_r(state, &state->c, &state->e);
+})
+
+CPU_OP(MOV_C_H, {
+  cpu_execute_mov_r_r(state, &state->c, &state->h);
+})
+
+CPU_OP(MOV_C_L, {
+  cpu_execute_mov_r_r(state, &state->c, &state->l);
+})
+
+CPU_OP(MOV_C_M, {
+  cpu_execute_mov_r_m(state, &state->c);
+})
+
+CPU_OP(MOV_C_A, {
+  cpu_execute_mov_r_r(state, &state->c, &state->a);
+})
+
+CPU_OP(MOV_D_B, {
+  cpu_execute_mov_r_r(state, &state->d, &state->b);
+})
+
+CPU_OP(MOV_D_C, {
+  cpu_execute_mov_r_r(state, &state->d, &state->c);
+})
+
+CPU_OP(MOV_D_D, {
+  cpu_execute_mov_r_r(state, &state->d, &state->d);
+})
+
+CPU_OP(MOV_D_E, {
+  cpu_execute_mov_r_r(state, &state->d, &state->e);
+})
+
+CPU_OP(MOV_D_H, {
+  cpu_execute_mov_r_r(state, &state->d, &state->h);
+})
+
+CPU_OP(MOV_D_L, {
+  cpu_execute_mov_r_r(state, &state->d, &state->l);
+})
+
+CPU_OP(MOV_D_M, {
+  cpu_execute_mov_r_m(state, &state->d);
+})
+
+CPU_OP(MOV_D_A, {
+  cpu_execute_mov_r_r(state, &state->d, &state->a);
+})
+
+CPU_OP(MOV_E_B, {
+  cpu_execute_mov_r_r(state, &state->e, &state->b);
+})
+
+CPU_OP(MOV_E_C, {
+  cpu_execute_mov_r_r(state, &state->e, &state->c);
+})
+
+CPU_OP(MOV_E_D, {
+  cpu_execute_mov_r_r(state, &state->e, &state->d);
+})
+
+CPU_OP(MOV_E_E, {
+  cpu_execute_mov_r_r(state, &state->e, &state->e);
+})
+
+CPU_OP(MOV_E_H, {
+  cpu_execute_mov_r_r(state, &state->e, &state->h);
+})
+
+CPU_OP(MOV_E_L, {
+  cpu_execute_mov_r_r(state, &state->e, &state->l);
+})
+
+CPU_OP(MOV_E_M, {
+  cpu_execute_mov_r_m(state, &state->e);
+})
+
+CPU_OP(MOV_E_A, {
+  cpu_execute_mov_r_r(state, &state->e, &state->a);
+})
+
+CPU_OP(MOV_H_B, {
+  cpu_execute_mov_r_r(state, &state->h, &state->b);
+})
+
+CPU_OP(MOV_H_C, {
+  cpu_execute_mov_r_r(state, &state->h, &state->c);
+})
+
+CPU_OP(MOV_H_D, {
+  cpu_execute_mov_r_r(state, &state->h, &state->d);
+})
+
+CPU_OP(MOV_H_E, {
+  cpu_execute_mov_r_r(state, &state->h, &state->e);
+})
+
+CPU_OP(MOV_H_H, {
+  cpu_execute_mov_r_r(state, &state->h, &state->h);
+})
+
+CPU_OP(MOV_H_L, {
+  cpu_execute_mov_r_r(state, &state->h, &state->l);
+})
+
+CPU_OP(MOV_H_M, {
+  cpu_execute_mov_r_m(state, &state->h);
+})
+
+CPU_OP(MOV_H_A, {
+  cpu_execute_mov_r_r(state, &state->h, &state->a);
+})
+
+CPU_OP(MOV_L_B, {
+  cpu_execute_mov_r_r(state, &state->l, &state->b);
+})
+
+CPU_OP(MOV_L_C, {
+  cpu_execute_mov_r_r(state, &state->l, &state->c);
+})
+
+CPU_OP(MOV_L_D, {
+  cpu_execute_mov_r_r(state, &state->l, &state->d);
+})
+
+CPU_OP(MOV_L_E, {
+  cpu_execute_mov_r_r(state, &state->l, &state->e);
+})
+
+CPU_OP(MOV_L_H, {
+  cpu_execute_mov_r_r(state, &state->l, &state->h);
+})
+
+CPU_OP(MOV_L_L, {
+  cpu_execute_mov_r_r(state, &state->l, &state->l);
+})
+
+CPU_OP(MOV_L_M, {
+  cpu_execute_mov_r_m(state, &state->l);
+})
+
+CPU_OP(MOV_L_A, {
+  cpu_execute_mov_r_r(state, &state->l, &state->a);
+})
+
+CPU_OP(MOV_M_B, {
+  cpu_execute_mov_m_r(state, &state->b);
+})
+
+CPU_OP(MOV_M_C, {
+  cpu_execute_mov_m_r(state, &state->c);
+})
+
+CPU_OP(MOV_M_D, {
+  cpu_execute_mov_m_r(state, &state->d);
+})
+
+CPU_OP(MOV_M_E, {
+  cpu_execute_mov_m_r(state, &state->e);
+})
+
+CPU_OP(MOV_M_H, {
+  cpu_execute_mov_m_r(state, &state->h);
+})
+
+CPU_OP(MOV_M_L, {
+  cpu_execute_mov_m_r(state, &state->l);
+})
+
+CPU_OP(MOV_M_A, {
+  cpu_execute_mov_m_r(state, &state->a);
+})
+
+CPU_OP(MOV_A_B, {
+  cpu_execute_mov_r_r(state, &state->a, &state->b);
+})
+
+CPU_OP(MOV_A_C, {
+  cpu_execute_mov_r_r(state, &state->a, &state->c);
+})
+
+CPU_OP(MOV_A_D, {
+  cpu_execute_mov_r_r(state, &state->a, &state->d);
+})
+
+CPU_OP(MOV_A_E, {
+  cpu_execute_mov_r_r(state, &state->a, &state->e);
+})
+
+CPU_OP(MOV_A_H, {
+  cpu_execute_mov_r_r(state, &state->a, &state->h);
+})
+
+CPU_OP(MOV_A_L, {
+  cpu_execute_mov_r_r(state, &state->a, &state->l);
+})
+
+CPU_OP(MOV_A_M, {
+  cpu_execute_mov_r_m(state, &state->a);
+})
+
+CPU_OP(MOV_A_A, {
+  cpu_execute_mov_r_r(state, &state->a, &state->a);
+})
+
+CPU_OP(ADD_B, {
+  cpu_execute_add_r(state, state->b);
+})
+
+CPU_OP(ADD_C, {
+  cpu_execute_add_r(state, state->c);
+})
+
+CPU_OP(ADD_D, {
+  cpu_execute_add_r(state, state->d);
+})
+
+CPU_OP(ADD_E, {
+  cpu_execute_add_r(state, state->e);
+})
+
+CPU_OP(ADD_H, {
+  cpu_execute_add_r(state, state->h);
+})
+
+CPU_OP(ADD_L, {
+  cpu_execute_add_r(state, state->l);
+})
+
+CPU_OP(ADD_M, {
+  cpu_execute_add_m(state);
+})
+
+CPU_OP(ADD_A, {
+  cpu_execute_add_r(state, state->a);
+})
+
+CPU_OP(ADC_B, {
+  cpu_execute_adc_r(state, state->b);
+})
+
+CPU_OP(ADC_C, {
+  cpu_execute_adc_r(state, state->c);
+})
+
+CPU_OP(ADC_D, {
+  cpu_execute_adc_r(state, state->d);
+})
+
+CPU_OP(ADC_E, {
+  cpu_execute_adc_r(state, state->e);
+})
+
+CPU_OP(ADC_H, {
+  cpu_execute_adc_r(state, state->h);
+})
+
+CPU_OP(ADC_L, {
+  cpu_execute_adc_r(state, state->l);
+})
+
+CPU_OP(ADC_M, {
+  cpu_execute_adc_m(state);
+})
+
+CPU_OP(ADC_A, {
+  cpu_execute_adc_r(state, state->a);
+})
+
+CPU_OP(SUB_B, {
+  cpu_execute_sub_r(state, state->b);
+})
+
+CPU_OP(SUB_C, {
+  cpu_execute_sub_r(state, state->c);
+})
+
+CPU_OP(SUB_D, {
+  cpu_execute_sub_r(state, state->d);
+})
+
+CPU_OP(SUB_E, {
+  cpu_execute_sub_r(state, state->e);
+})
+
+CPU_OP(SUB_H, {
+  cpu_execute_sub_r(state, state->h);
+})
+
+CPU_OP(SUB_L, {
+  cpu_execute_sub_r(state, state->l);
+})
+
+CPU_OP(SUB_M, {
+  cpu_execute_sub_m(state);
+})
+
+CPU_OP(SUB_A, {
+  cpu_execute_sub_r(state, state->a);
+})
+
+CPU_OP(SBB_B, {
+  cpu_execute_sbb_r(state, state->b);
+})
+
+CPU_OP(SBB_C, {
+  cpu_execute_sbb_r(state, state->c);
+})
+
+CPU_OP(SBB_D, {
+  cpu_execute_sbb_r(state, state->d);
+})
+
+CPU_OP(SBB_E, {
+  cpu_execute_sbb_r(state, state->e);
+})
+
+CPU_OP(SBB_H, {
+  cpu_execute_sbb_r(state, state->h);
+})
+
+CPU_OP(SBB_L, {
+  cpu_execute_sbb_r(state, state->l);
+})
+
+CPU_OP(SBB_M, {
+  cpu_execute_sbb_m(state);
+})
+
+CPU_OP(SBB_A, {
+  cpu_execute_sbb_r(state, state->a);
+})
+
+CPU_OP(ANA_B, {
+  cpu_execute_ana_r(state, state->b);
+})
+
+CPU_OP(ANA_C, {
+  cpu_execute_ana_r(state, state->c);
+})
+
+CPU_OP(ANA_D, {
+  cpu_execute_ana_r(state, state->d);
+})
+
+CPU_OP(ANA_E, {
+  cpu_execute_ana_r(state, state->e);
+})
+
+CPU_OP(ANA_H, {
+  cpu_execute_ana_r(state, state->h);
+})
+
+CPU_OP(ANA_L, {
+  cpu_execute_ana_r(state, state->l);
+})
+
+CPU_OP(ANA_M, {
+  cpu_execute_ana_m(state);
+})
+
+CPU_OP(ANA_A, {
+  cpu_execute_ana_r(state, state->a);
+})
+
+CPU_OP(XRA_B, {
+  cpu_execute_xra_r(state, state->b);
+})
+
+CPU_OP(XRA_C, {
+  cpu_execute_xra_r(state, state->c);
+})
+
+CPU_OP(XRA_D, {
+  cpu_execute_xra_r(state, state->d);
+})
+
+CPU_OP(XRA_E, {
+  cpu_execute_xra_r(state, state->e);
+})
+
+CPU_OP(XRA_H, {
+  cpu_execute_xra_r(state, state->h);
+})
+
+CPU_OP(XRA_L, {
+  cpu_execute_xra_r(state, state->l);
+})
+
+CPU_OP(XRA_M, {
+  cpu_execute_xra_m(state);
+})
+
+CPU_OP(XRA_A, {
+  cpu_execute_xra_r(state, state->a);
+})
+
+CPU_OP(ORA_B, {
+  cpu_execute_ora_r(state, state->b);
+})
+
+CPU_OP(ORA_C, {
+  cpu_execute_ora_r(state, state->c);
+})
+
+CPU_OP(ORA_D, {
+  cpu_execute_ora_r(state, state->d);
+})
+
+CPU_OP(ORA_E, {
+  cpu_execute_ora_r(state, state->e);
+})
+
+CPU_OP(ORA_H, {
+  cpu_execute_ora_r(state, state->h);
+})
+
+CPU_OP(ORA_L, {
+  cpu_execute_ora_r(state, state->l);
+})
+
+CPU_OP(ORA_M, {
+  cpu_execute_ora_m(state);
+})
+
+CPU_OP(ORA_A, {
+  cpu_execute_ora_r(state, state->a);
+})
+
+CPU_OP(CMP_B, {
+  cpu_execute_cmp_r(state, state->b);
+})
+
+CPU_OP(CMP_C, {
+  cpu_execute_cmp_r(state, state->c);
+})
+
+CPU_OP(CMP_D, {
+  cpu_execute_cmp_r(state, state->d);
+})
+
+CPU_OP(CMP_E, {
+  cpu_execute_cmp_r(state, state->e);
+})
+
+CPU_OP(CMP_H, {
+  cpu_execute_cmp_r(state, state->h);
+})
+
+CPU_OP(CMP_L, {
+  cpu_execute_cmp_r(state, state->l);
+})
+
+CPU_OP(CMP_M, {
+  cpu_execute_cmp_m(state);
+})
+
+CPU_OP(CMP_A, {
+  cpu_execute_cmp_r(state, state->a);
+})
+
+CPU_OP(RNZ, {
+  branch_taken = cpu_execute_ret(state, !(cpu_get_flags(state) & FLAG_Z));
+})
+
+CPU_OP(POP_B, {
+  cpu_execute_pop(state, &state->bc);
+})
+
+CPU_OP(JNZ, {
+  cpu_execute_jmp(state, CPU_IMM16(), !(cpu_get_flags(state) & FLAG_Z));
+})
+
+CPU_OP(JMP, {
+  cpu_execute_jmp(state, CPU_IMM16(), 1);
+})
+
+CPU_OP(CNZ, {
+  branch_taken = cpu_execute_call(state, CPU_IMM16(), !(cpu_get_flags(state) & FLAG_Z));
+})
+
+CPU_OP(PUSH_B, {
+  cpu_execute_push(state, state->bc);
+})
+
+CPU_OP(ADI_D8, {
+  cpu_execute_adi(state, CPU_IMM8());
+})
+
+CPU_OP(RST_0, {
+  cpu_execute_rst(state, 0x00);
+})
+
+CPU_OP(RZ, {
+  branch_taken = cpu_execute_ret(state, cpu_get_flags(state) & FLAG_Z);
+})
+
+CPU_OP(RET, {
+  branch_taken = cpu_execute_ret(state, 1);
+})
+
+CPU_OP(JZ, {
+  cpu_execute_jmp(state, CPU_IMM16(), cpu_get_flags(state) & FLAG_Z);
+})
+
+CPU_OP(CZ, {
+  branch_taken = cpu_execute_call(state, CPU_IMM16(), cpu_get_flags(state) & FLAG_Z);
+})
+
+CPU_OP(CALL, {
+  branch_taken = cpu_execute_call(state, CPU_IMM16(), 1);
+})
+
+CPU_OP(ACI_D8, {
+  cpu_execute_aci(state, CPU_IMM8());
+})
+
+CPU_OP(RST_1, {
+  cpu_execute_rst(state, 0x08);
+})
+
+CPU_OP(RNC, {
+  branch_taken = cpu_execute_ret(state, !(cpu_get_flags(state) & FLAG_C));
+})
+
+CPU_OP(POP_D, {
+  cpu_execute_pop(state, &state->de);
+})
+
+CPU_OP(JNC, {
+  cpu_execute_jmp(state, CPU_IMM16(), !(cpu_get_flags(state) & FLAG_C));
+})
+
+CPU_OP(CNC, {
+  branch_taken = cpu_execute_call(state, CPU_IMM16(), !(cpu_get_flags(state) & FLAG_C));
+})
+
+CPU_OP(PUSH_D, {
+  cpu_execute_push(state, state->de);
+})
+
+CPU_OP(SUI_D8, {
+  cpu_execute_sui(state, CPU_IMM8());
+})
+
+CPU_OP(RST_2, {
+  cpu_execute_rst(state, 0x10);
+})
+
+CPU_OP(RC, {
+  branch_taken = cpu_execute_ret(state, cpu_get_flags(state) & FLAG_C);
+})
+
+CPU_OP(JC, {
+  cpu_execute_jmp(state, CPU_IMM16(), cpu_get_flags(state) & FLAG_C);
+})
+
+CPU_OP(CC, {
+  branch_taken = cpu_execute_call(state, CPU_IMM16(), cpu_get_flags(state) & FLAG_C);
+})
+
+CPU_OP(SBI_D8, {
+  cpu_execute_sbi(state, CPU_IMM8());
+})
+
+CPU_OP(RST_3, {
+  cpu_execute_rst(state, 0x18);
+})
+
+CPU_OP(RPO, {
+  branch_taken = cpu_execute_ret(state, !(cpu_get_flags(state) & FLAG_P));
+})
+
+CPU_OP(POP_H, {
+  cpu_execute_pop(state, &state->hl);
+})
+
+CPU_OP(JPO, {
+  cpu_execute_jmp(state, CPU_IMM16(), !(cpu_get_flags(state) & FLAG_P));
+})
+
+CPU_OP(XTHL, {
+  cpu_execute_xthl(state);
+})
+
+CPU_OP(CPO, {
+  branch_taken = cpu_execute_call(state, CPU_IMM16(), !(cpu_get_flags(state) & FLAG_P));
+})
+
+CPU_OP(PUSH_H, {
+  cpu_execute_push(state, state->hl);
+})
+
+CPU_OP(ANI_D8, {
+  cpu_execute_ani(state, CPU_IMM8());
+})
+
+CPU_OP(RST_4, {
+  cpu_execute_rst(state, 0x20);
+})
+
+CPU_OP(RPE, {
+  branch_taken = cpu_execute_ret(state, cpu_get_flags(state) & FLAG_P);
+})
+
+CPU_OP(PCHL, {
+  cpu_execute_pchl(state);
+})
+
+CPU_OP(JPE, {
+  cpu_execute_jmp(state, CPU_IMM16(), cpu_get_flags(state) & FLAG_P);
+})
+
+CPU_OP(XCHG, {
+  cpu_execute_xchg(state);
+})
+
+CPU_OP(CPE, {
+  branch_taken = cpu_execute_call(state, CPU_IMM16(), cpu_get_flags(state) & FLAG_P);
+})
+
+CPU_OP(XRI_D8, {
+  cpu_execute_xri(state, CPU_IMM8());
+})
+
+CPU_OP(RST_5, {
+  cpu_execute_rst(state, 0x28);
+})
+
+CPU_OP(RP, {
+  branch_taken = cpu_execute_ret(state, !(cpu_get_flags(state) & FLAG_S));
+})
+
+CPU_OP(POP_PSW, {
+  uint16_t psw;
+  cpu_execute_pop(state, &psw);
+  cpu_set_psw(state, psw);
+})
+
+CPU_OP(JP, {
+  cpu_execute_jmp(state, CPU_IMM16(), !(cpu_get_flags(state) & FLAG_S));
+})
+
+CPU_OP(DI, {
+  cpu_execute_di(state);
+})
+
+CPU_OP(CP, {
+  branch_taken = cpu_execute_call(state, CPU_IMM16(), !(cpu_get_flags(state) & FLAG_S));
+})
+
+CPU_OP(PUSH_PSW, {
+  cpu_execute_push(state, cpu_get_psw(state));
+})
+
+CPU_OP(ORI_D8, {
+  cpu_execute_ori(state, CPU_IMM8());
+})
+
+CPU_OP(RST_6, {
+  cpu_execute_rst(state, 0x30);
+})
+
+CPU_OP(RM, {
+  branch_taken = cpu_execute_ret(state, cpu_get_flags(state) & FLAG_S);
+})
+
+CPU_OP(SPHL, {
+  cpu_execute_sphl(state);
+})
+
+CPU_OP(JM, {
+  cpu_execute_jmp(state, CPU_IMM16(), cpu_get_flags(state) & FLAG_S);
+})
+
+CPU_OP(EI, {
+  cpu_execute_ei(state);
+})
+
+CPU_OP(CM, {
+  branch_taken = cpu_execute_call(state, CPU_IMM16(), cpu_get_flags(state) & FLAG_S);
+})
+
+CPU_OP(CPI_D8, {
+  cpu_execute_cpi(state, CPU_IMM8());
+})
+
+CPU_OP(RST_7, {
+  cpu_execute_rst(state, 0x38);
+})
+
+CPU_OP(OUT, {
+  machine_out(state->machine, CPU_IMM8(), state->a);
+})
+
+CPU_OP(IN, {
+  uint8_t value = state->a;
+  machine_in(state->machine, CPU_IMM8(), &value);
+  state->a = value;
+})
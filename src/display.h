@@ -1,9 +1,26 @@
-#pragma once
-
-#include "cpu.h"
-
-void display_init();
-void display_destroy();
-
-void display_process_events(cpu_state *state);
-void display_render(cpu_state *state);
\ No newline at end of file
+#pragma once
+
+#include <SDL.h>
+
+#include "command.h"
+
+typedef struct {
+  SDL_Window *window;
+  SDL_Renderer *renderer;
+  // The frame is only ever 1bpp VRAM, it is expanded to colors straight into the texture
+  SDL_Texture *texture;
+
+  int previous_frame_time;
+  // Keys as the player holds them, the machine only sees them once the emulation thread drained the commands
+  uint8_t keys[10];
+  // Toggled with p
+  uint8_t paused;
+} display_state;
+
+void display_init(display_state *display);
+void display_destroy(display_state *display);
+
+// Input goes to the emulation thread as commands: keys, p to pause, backspace to rewind, F5 for a snapshot
+void display_process_events(display_state *display, command_ring *commands);
+// Shows a frame of video RAM, the last one again when video is NULL
+void display_render(display_state *display, const uint8_t *video);
\ No newline at end of file
@@ -1,85 +1,328 @@
-#define DISPLAY 1
-#define CPU_DEBUG 1
-
-#include <SDL.h>
-#include <stdio.h>
-
-#include "cpu.h"
-#include "display.h"
-#include "machine.h"
-
-char *file_to_open = "../roms/invaders.rom";
-uint8_t is_running = 1;
-
-int run_emulation(void *param) {
-  cpu_state *state = (cpu_state *)param;
-  cpu_start_emulation(state);
-  cpu_print_dump(state);
-  cpu_destroy(state);
-  return 0;
-}
-
-int run_display(void *param) {
-#if DISPLAY
-  cpu_state *state = (cpu_state *)param;
-  display_init();
-
-  while (is_running) {
-    display_process_events(state);
-    display_render(state);
-  }
-
-  display_destroy();
-#endif
-  return 0;
-}
-
-int main() {
-  char *file_buffer;
-  uint32_t file_size;
-
-  FILE *file = fopen(file_to_open, "rb");
-
-  if (!file) {
-    printf("FILE COULD NOT BE LOADED");
-    return 1;
-  }
-
-  fseek(file, 0, SEEK_END);
-  file_size = ftell(file);
-  fseek(file, 0, SEEK_SET);
-
-  file_buffer = malloc(file_size * sizeof(char));
-  fread(file_buffer, 1, file_size, file);
-  fclose(file);
-
-  if (!file_buffer) {
-    printf("FILE IS EMPTY");
-    return 1;
-  }
-
-  is_running = 1;
-
-  machine_init();
-  cpu_state state = cpu_init(file_buffer, file_size);
-  free(file_buffer);
-
-  SDL_Thread *emulation_thread =
-      SDL_CreateThread(run_emulation, "emulation", &state);
-  SDL_Thread *display_thread = SDL_CreateThread(run_display, "display", &state);
-
-  if (!emulation_thread) {
-    printf("Could not create emulation thread\n");
-    exit(0);
-  }
-
-  if (!display_thread) {
-    printf("Could not create display thread\n");
-    exit(0);
-  }
-
-  SDL_WaitThread(emulation_thread, NULL);
-  SDL_WaitThread(display_thread, NULL);
-
-  return 0;
+#include <SDL.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "command.h"
+#include "cpu.h"
+#include "display.h"
+#include "framebuffer.h"
+#include "machine.h"
+#include "movie.h"
+#include "rewind.h"
+#include "runahead.h"
+
+// Written with F5, a compressed savestate
+#define EMULATOR_SNAPSHOT_PATH "snapshot.state"
+
+// Everything one emulator owns, shared by its emulation and display threads
+typedef struct {
+  cpu_state cpu;
+  machine_state machine;
+  display_state display;
+  uint8_t headless;
+  // Frames since the emulation started at start_ticks, for holding it to the frame rate of the board
+  uint64_t frames;
+  uint32_t start_ticks;
+
+  // Written by the display thread, drained by the emulation thread between slices. The other fields below are
+  // the emulation thread's own, except stopped which tells the display thread to close
+  command_ring commands;
+  uint8_t rewinding;
+  uint8_t paused;
+  uint8_t stopped;
+  uint64_t command_count;
+  uint64_t command_latency;
+  // Signalled by the display thread after it pushed commands, for an emulation thread waiting on them
+  SDL_mutex *wake_lock;
+  SDL_cond *wake;
+  // Published by the emulation thread at every vblank, the display thread never reads the machine
+  framebuffer_state framebuffer;
+
+  rewind_state *rewind;
+  movie_state *movie;
+  runahead_state *runahead;
+  // Frame shown ahead of the machine, only touched by the display thread
+  uint8_t video[MACHINE_VIDEO_SIZE];
+} emulator_state;
+
+#if CPU_DISPATCH == CPU_DISPATCH_AOT
+extern const cpu_aot_image aot_image_invaders;
+#endif
+
+void save_snapshot(cpu_state *state) {
+  uint32_t size = savestate_size(state);
+  uint8_t *buffer = malloc(size);
+  uint8_t *compressed = malloc(2 * size);
+
+  savestate_save(state, buffer, size);
+  uint32_t compressed_size = savestate_compress(buffer, size, compressed, 2 * size);
+
+  if (savestate_write_file(EMULATOR_SNAPSHOT_PATH, compressed, compressed_size)) {
+    printf("Snapshot saved to %s\n", EMULATOR_SNAPSHOT_PATH);
+  } else {
+    printf("SNAPSHOT COULD NOT BE SAVED: %s\n", EMULATOR_SNAPSHOT_PATH);
+  }
+
+  free(buffer);
+  free(compressed);
+}
+
+void apply_command(emulator_state *emulator, cpu_state *state, command *next) {
+  switch (next->type) {
+    case COMMAND_KEY:
+      machine_set_key(state->machine, next->key, next->value);
+      break;
+    case COMMAND_INTERRUPT:
+      cpu_set_interrupt(state, next->value);
+      break;
+    case COMMAND_PAUSE:
+      emulator->paused = next->value;
+      break;
+    case COMMAND_QUIT:
+      state->machine->running = 0;
+      break;
+    case COMMAND_SNAPSHOT:
+      save_snapshot(state);
+      break;
+    case COMMAND_REWIND:
+      emulator->rewinding = next->value;
+      break;
+  }
+
+  emulator->command_count++;
+  emulator->command_latency += SDL_GetTicks() - next->time;
+}
+
+// Applies what the display thread sent, then blocks for more while paused or while the CPU has nothing to run until
+// an interrupt, which only a command can bring
+void poll_commands(void *context, cpu_state *state, uint8_t wait) {
+  emulator_state *emulator = (emulator_state *)context;
+  command next;
+
+  while (1) {
+    while (command_pop(&emulator->commands, &next)) {
+      apply_command(emulator, state, &next);
+    }
+
+    if (!state->machine->running || !(emulator->paused || (wait && !state->interrupt))) {
+      return;
+    }
+
+    SDL_LockMutex(emulator->wake_lock);
+
+    while (!command_pending(&emulator->commands)) {
+      SDL_CondWait(emulator->wake, emulator->wake_lock);
+    }
+
+    SDL_UnlockMutex(emulator->wake_lock);
+  }
+}
+
+// Every frame goes into the rewind buffer unless the player is holding rewind, which a recording cannot follow
+void handle_frame(void *context, cpu_state *state) {
+  emulator_state *emulator = (emulator_state *)context;
+
+  if (emulator->rewinding && !emulator->movie) {
+    rewind_step(emulator->rewind, state);
+  } else {
+    rewind_push(emulator->rewind, state);
+  }
+
+  framebuffer_publish(&emulator->framebuffer, state->memory->data + MACHINE_VIDEO_ADDRESS);
+
+  if (emulator->runahead) {
+    runahead_request(emulator->runahead);
+  }
+
+  // The machine runs on its own time, held to the board's 59.5 frames per second unless nothing is shown
+  if (!emulator->headless) {
+    uint32_t due = emulator->start_ticks + ++emulator->frames * 1000 * MACHINE_FRAME_CYCLES / MACHINE_CPU_HZ;
+    uint32_t now = SDL_GetTicks();
+
+    if (due > now) {
+      SDL_Delay(due - now);
+    } else if (now - due > 100) {
+      // Too far behind to catch up, start counting again
+      emulator->start_ticks = now;
+      emulator->frames = 0;
+    }
+  }
+}
+
+int run_emulation(void *param) {
+  emulator_state *emulator = (emulator_state *)param;
+  cpu_state *state = &emulator->cpu;
+
+  uint32_t start_time = SDL_GetTicks();
+  emulator->start_ticks = start_time;
+  cpu_start_emulation(state);
+  uint32_t elapsed_time = SDL_GetTicks() - start_time;
+
+  // Main frees everything once both threads are done
+  __atomic_store_n(&emulator->stopped, 1, __ATOMIC_RELEASE);
+  cpu_print_cycle_info(state, elapsed_time);
+  return 0;
+}
+
+void destroy_emulator(emulator_state *emulator) {
+  rewind_print_info(emulator->rewind);
+  rewind_destroy(emulator->rewind);
+
+  if (emulator->runahead) {
+    runahead_print_info(emulator->runahead);
+    runahead_destroy(emulator->runahead);
+  }
+
+  if (emulator->movie) {
+    movie_close(emulator->movie);
+  }
+
+  uint64_t commands = emulator->command_count ? emulator->command_count : 1;
+  printf("Commands: %lu applied, %.1f ms after they were sent | %u dropped\n",
+         (unsigned long) emulator->command_count, (double) emulator->command_latency / commands,
+         emulator->commands.dropped);
+  printf("Frames: %lu published, %lu shown | %lu overwritten before the display took them\n",
+         (unsigned long) emulator->framebuffer.published, (unsigned long) emulator->framebuffer.taken,
+         (unsigned long) (emulator->framebuffer.published - emulator->framebuffer.taken));
+
+  if (emulator->wake) {
+    SDL_DestroyCond(emulator->wake);
+    SDL_DestroyMutex(emulator->wake_lock);
+  }
+
+  cpu_print_dump(&emulator->cpu);
+  cpu_destroy(&emulator->cpu);
+}
+
+int run_display(void *param) {
+  emulator_state *emulator = (emulator_state *)param;
+
+  if (emulator->headless) {
+    return 0;
+  }
+
+  display_init(&emulator->display);
+
+  while (!__atomic_load_n(&emulator->stopped, __ATOMIC_ACQUIRE)) {
+    uint32_t sent = emulator->commands.tail;
+    display_process_events(&emulator->display, &emulator->commands);
+
+    if (emulator->commands.tail != sent) {
+      SDL_LockMutex(emulator->wake_lock);
+      SDL_CondSignal(emulator->wake);
+      SDL_UnlockMutex(emulator->wake_lock);
+    }
+
+    const uint8_t *video = framebuffer_take(&emulator->framebuffer);
+    uint8_t ahead = emulator->runahead &&
+                    runahead_present(emulator->runahead, emulator->display.keys, emulator->video);
+    display_render(&emulator->display, ahead ? emulator->video : video);
+  }
+
+  display_destroy(&emulator->display);
+  return 0;
+}
+
+// Usage: emulator [--trace | --count] [--headless] [--record movie] [--runahead frames] [rom]
+int main(int argc, char **argv) {
+  static emulator_state emulator;
+  char *file_to_open = "../roms/invaders.rom";
+  char *file_buffer;
+  uint32_t file_size;
+  char *movie_path = NULL;
+  uint32_t runahead_frames = 0;
+  uint8_t interpreter = CPU_INTERPRETER_PLAIN;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--trace")) {
+      interpreter = CPU_INTERPRETER_TRACING;
+    } else if (!strcmp(argv[i], "--count")) {
+      interpreter = CPU_INTERPRETER_COUNTING;
+    } else if (!strcmp(argv[i], "--headless")) {
+      emulator.headless = 1;
+    } else if (!strcmp(argv[i], "--record") && i + 1 < argc) {
+      movie_path = argv[++i];
+    } else if (!strcmp(argv[i], "--runahead") && i + 1 < argc) {
+      runahead_frames = strtoul(argv[++i], NULL, 0);
+    } else {
+      file_to_open = argv[i];
+    }
+  }
+
+  FILE *file = fopen(file_to_open, "rb");
+
+  if (!file) {
+    printf("FILE COULD NOT BE LOADED");
+    return 1;
+  }
+
+  fseek(file, 0, SEEK_END);
+  file_size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+
+  file_buffer = malloc(file_size * sizeof(char));
+  fread(file_buffer, 1, file_size, file);
+  fclose(file);
+
+  if (!file_buffer) {
+    printf("FILE IS EMPTY");
+    return 1;
+  }
+
+  machine_init(&emulator.machine);
+  command_init(&emulator.commands);
+  framebuffer_init(&emulator.framebuffer);
+  emulator.cpu = cpu_init(&emulator.machine, file_buffer, file_size);
+  machine_map_memory(emulator.cpu.memory,
+                     machine_load_rom(emulator.cpu.memory->arena, (uint8_t *) file_buffer, file_size));
+  cpu_set_interpreter(&emulator.cpu, interpreter);
+  emulator.rewind = rewind_create(REWIND_DEFAULT_CAPACITY, savestate_size(&emulator.cpu));
+  cpu_set_frame_handler(&emulator.cpu, handle_frame, &emulator);
+
+  // Without a display no command ever comes, a CPU halted with nothing scheduled stops the emulation instead
+  if (!emulator.headless) {
+    emulator.wake_lock = SDL_CreateMutex();
+    emulator.wake = SDL_CreateCond();
+    cpu_set_poll_handler(&emulator.cpu, poll_commands, &emulator);
+  }
+  cpu_start_video(&emulator.cpu);
+  free(file_buffer);
+
+#if CPU_DISPATCH == CPU_DISPATCH_AOT
+  if (!cpu_attach_aot_image(&emulator.cpu, &aot_image_invaders)) {
+    printf("ROM DOES NOT MATCH THE RECOMPILED IMAGE, FALLING BACK TO THE INTERPRETER\n");
+  }
+#endif
+
+  if (movie_path) {
+    emulator.movie = movie_record(movie_path, &emulator.cpu, MOVIE_DEFAULT_INTERVAL);
+
+    if (!emulator.movie) {
+      return 1;
+    }
+  }
+
+  if (runahead_frames) {
+    emulator.runahead = runahead_create(&emulator.cpu, runahead_frames);
+  }
+
+  SDL_Thread *emulation_thread =
+      SDL_CreateThread(run_emulation, "emulation", &emulator);
+  SDL_Thread *display_thread = SDL_CreateThread(run_display, "display", &emulator);
+
+  if (!emulation_thread) {
+    printf("Could not create emulation thread\n");
+    exit(0);
+  }
+
+  if (!display_thread) {
+    printf("Could not create display thread\n");
+    exit(0);
+  }
+
+  SDL_WaitThread(emulation_thread, NULL);
+  SDL_WaitThread(display_thread, NULL);
+  destroy_emulator(&emulator);
+
+  return 0;
 }
\ No newline at end of file
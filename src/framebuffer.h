@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include "machine.h"
+
+// Video RAM handed from the emulation thread to the display thread in three buffers. At vblank the emulation
+// thread copies the frame into its back buffer and swaps it with the middle one; the display thread swaps the
+// middle one with its front buffer whenever it holds a newer frame. Neither side ever waits for the other or
+// touches a buffer the other one owns, the display always shows the newest whole frame and frames it did not get
+// to are overwritten.
+
+// Set in middle when it holds a frame the display thread has not taken
+#define FRAMEBUFFER_FRESH 0x4
+
+typedef struct {
+  __attribute__((aligned(64))) uint8_t buffers[3][MACHINE_VIDEO_SIZE];
+
+  __attribute__((aligned(64))) uint8_t middle;
+  // Owned by the emulation thread
+  __attribute__((aligned(64))) uint8_t back;
+  uint64_t published;
+  // Owned by the display thread
+  __attribute__((aligned(64))) uint8_t front;
+  uint64_t taken;
+} framebuffer_state;
+
+static inline void framebuffer_init(framebuffer_state *framebuffer) {
+  framebuffer->back = 0;
+  framebuffer->middle = 1;
+  framebuffer->front = 2;
+  framebuffer->published = 0;
+  framebuffer->taken = 0;
+}
+
+// Copies the frame in and makes it the newest
+static inline void framebuffer_publish(framebuffer_state *framebuffer, const uint8_t *video) {
+  memcpy(framebuffer->buffers[framebuffer->back], video, MACHINE_VIDEO_SIZE);
+  framebuffer->back = __atomic_exchange_n(&framebuffer->middle, framebuffer->back | FRAMEBUFFER_FRESH,
+                                          __ATOMIC_ACQ_REL) & ~FRAMEBUFFER_FRESH;
+  framebuffer->published++;
+}
+
+// The newest frame, NULL until the first one. It stays valid until the next call
+static inline const uint8_t *framebuffer_take(framebuffer_state *framebuffer) {
+  if (__atomic_load_n(&framebuffer->middle, __ATOMIC_RELAXED) & FRAMEBUFFER_FRESH) {
+    framebuffer->front = __atomic_exchange_n(&framebuffer->middle, framebuffer->front, __ATOMIC_ACQ_REL) &
+                         ~FRAMEBUFFER_FRESH;
+    framebuffer->taken++;
+  }
+
+  return framebuffer->taken ? framebuffer->buffers[framebuffer->front] : NULL;
+}
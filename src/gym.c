@@ -0,0 +1,165 @@
+#include "gym.h"
+
+// Player 1 score in two BCD bytes, low byte first
+#define GYM_RAM_SCORE 0x20F8
+// Cleared when the game of player 1 is over
+#define GYM_RAM_PLAYING 0x20E7
+// Ships left of player 1, set a few frames after the game starts
+#define GYM_RAM_SHIPS 0x21FF
+
+static uint32_t gym_score(cpu_state *state) {
+  uint8_t low = cpu_read_byte(state, GYM_RAM_SCORE);
+  uint8_t high = cpu_read_byte(state, GYM_RAM_SCORE + 1);
+  return (high >> 4) * 1000 + (high & 0xF) * 100 + (low >> 4) * 10 + (low & 0xF);
+}
+
+static void gym_end_frame(void *context, cpu_state *state) {
+  gym_instance *instance = context;
+  instance->frame_ended = 1;
+  state->machine->running = 0;
+}
+
+// Up to the next vblank on the screen interrupts of the machine scheduler, the timing the emulator runs on
+static void gym_run_frame(gym_instance *instance) {
+  instance->frame_ended = 0;
+  instance->machine.running = 1;
+  cpu_start_emulation(&instance->cpu);
+  instance->done |= !instance->frame_ended;
+}
+
+static void gym_reset_instance(gym_env *env, gym_instance *instance) {
+  cpu_reset(&instance->cpu);
+  cpu_load_memory(&instance->cpu, env->boot_memory);
+  machine_init(&instance->machine);
+  cpu_start_video(&instance->cpu);
+  instance->done = 0;
+
+  // The ROM ignores the coin for a while after power-on and the start button right after the coin
+  for (uint32_t frame = 0; frame < GYM_MAX_RESET_FRAMES && !cpu_read_byte(&instance->cpu, GYM_RAM_SHIPS); frame++) {
+    machine_set_key(&instance->machine, KEY_COIN, frame >= 30 && frame < 35);
+    machine_set_key(&instance->machine, KEY_P1_START, frame >= 50 && frame < 55);
+    gym_run_frame(instance);
+  }
+
+  machine_set_key(&instance->machine, KEY_COIN, 0);
+  machine_set_key(&instance->machine, KEY_P1_START, 0);
+  instance->score = gym_score(&instance->cpu);
+}
+
+// The two pixel pairs of a byte spread to four bytes holding how many of each pair are set, first pixels lowest
+static inline uint32_t gym_spread_pairs(uint8_t byte) {
+  uint32_t pairs = (byte & 0x55) + ((byte >> 1) & 0x55);
+  pairs = (pairs | (pairs << 12)) & 0x000F000F;
+  return (pairs | (pairs << 6)) & 0x03030303;
+}
+
+// Four boxes are averaged at once in the bytes of a word, a count from 0 to 4 becomes 0, 63, 126, 189 or 255
+static void gym_downsample(const uint8_t *vram, uint8_t *observation) {
+  for (uint32_t line = 0; line < 224; line += 2) {
+    const uint8_t *first = vram + line * 32;
+    const uint8_t *second = first + 32;
+
+    for (uint32_t i = 0; i < 32; i++) {
+      uint32_t counts = gym_spread_pairs(first[i]) + gym_spread_pairs(second[i]);
+      uint32_t gray = counts * 63 + ((counts >> 2) & 0x01010101) * 3;
+
+      observation[0] = gray;
+      observation[1] = gray >> 8;
+      observation[2] = gray >> 16;
+      observation[3] = gray >> 24;
+      observation += 4;
+    }
+  }
+}
+
+static void gym_observe(gym_env *env, gym_instance *instance, uint8_t *observation) {
+  // VRAM is RAM at its own address in the backing store
+  const uint8_t *vram = instance->cpu.memory->data + MACHINE_VIDEO_ADDRESS;
+
+  if (env->observation == GYM_OBSERVATION_PACKED) {
+    memcpy(observation, vram, MACHINE_VIDEO_SIZE);
+  } else {
+    gym_downsample(vram, observation);
+  }
+}
+
+gym_env *gym_create(const char *rom_path, uint32_t count, uint8_t observation) {
+  FILE *file = fopen(rom_path, "rb");
+
+  if (!file) {
+    printf("FILE COULD NOT BE LOADED: %s\n", rom_path);
+    return NULL;
+  }
+
+  gym_env *env = calloc(1, sizeof(gym_env));
+  env->boot_memory = calloc(0x10000, sizeof(uint8_t));
+  fread(env->boot_memory, 1, 0x10000, file);
+  fclose(file);
+
+  env->count = count;
+  env->observation = observation;
+  env->observation_size = observation == GYM_OBSERVATION_PACKED ? MACHINE_VIDEO_SIZE : GYM_GRAYSCALE_SIZE;
+  env->instances = calloc(count, sizeof(gym_instance));
+  env->maps = calloc(count, sizeof(memory_map));
+
+  memory_arena_init(&env->arena);
+  env->rom = machine_load_rom(&env->arena, env->boot_memory, 0x10000);
+
+  for (uint32_t i = 0; i < count; i++) {
+    gym_instance *instance = &env->instances[i];
+    memory_init(&env->maps[i], &env->arena);
+    machine_map_memory(&env->maps[i], env->rom);
+    machine_init(&instance->machine);
+    instance->cpu = cpu_init_memory(&instance->machine, &env->maps[i]);
+    cpu_set_frame_handler(&instance->cpu, gym_end_frame, instance);
+    instance->done = 1;
+  }
+
+  return env;
+}
+
+void gym_destroy(gym_env *env) {
+  for (uint32_t i = 0; i < env->count; i++) {
+    cpu_destroy(&env->instances[i].cpu);
+    memory_destroy(&env->maps[i]);
+  }
+
+  memory_arena_destroy(&env->arena);
+  free(env->maps);
+  free(env->instances);
+  free(env->boot_memory);
+  free(env);
+}
+
+void gym_reset(gym_env *env, uint8_t *observations) {
+#pragma omp parallel for schedule(dynamic)
+  for (uint32_t i = 0; i < env->count; i++) {
+    gym_reset_instance(env, &env->instances[i]);
+    gym_observe(env, &env->instances[i], observations + (size_t) i * env->observation_size);
+  }
+}
+
+// An instance that is done is reset by its next step, so the observation returned with done is the last frame
+void gym_step(gym_env *env, const uint8_t *actions, float *rewards, uint8_t *dones, uint8_t *observations) {
+#pragma omp parallel for schedule(dynamic)
+  for (uint32_t i = 0; i < env->count; i++) {
+    gym_instance *instance = &env->instances[i];
+
+    if (instance->done) {
+      gym_reset_instance(env, instance);
+    }
+
+    machine_set_key(&instance->machine, KEY_P1_LEFT, (actions[i] & GYM_ACTION_LEFT) != 0);
+    machine_set_key(&instance->machine, KEY_P1_RIGHT, (actions[i] & GYM_ACTION_RIGHT) != 0);
+    machine_set_key(&instance->machine, KEY_P1_FIRE, (actions[i] & GYM_ACTION_FIRE) != 0);
+    gym_run_frame(instance);
+
+    uint32_t score = gym_score(&instance->cpu);
+    rewards[i] = (float) score - (float) instance->score;
+    instance->score = score;
+
+    instance->done |= !cpu_read_byte(&instance->cpu, GYM_RAM_PLAYING);
+    dones[i] = instance->done;
+    gym_observe(env, instance, observations + (size_t) i * env->observation_size);
+  }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "cpu.h"
+#include "machine.h"
+
+// Batched headless Space Invaders for training agents, every step runs one frame of each instance.
+// Buffers are owned by the caller and hold count entries back to back, stepping allocates nothing.
+
+#define GYM_MAX_RESET_FRAMES 600
+
+// Grayscale observations turn every 2x2 box of pixels into one byte from 0 to 255, 112 lines of 128 bytes
+#define GYM_GRAYSCALE_SIZE (112 * 128)
+
+enum GymObservations {
+  // The video RAM as it is, MACHINE_VIDEO_SIZE bytes
+  GYM_OBSERVATION_PACKED = 0x0,
+  GYM_OBSERVATION_GRAYSCALE = 0x1,
+};
+
+// Actions are combinations of these bits
+enum GymActions {
+  GYM_ACTION_LEFT = 0x1,
+  GYM_ACTION_RIGHT = 0x2,
+  GYM_ACTION_FIRE = 0x4,
+};
+
+typedef struct {
+  cpu_state cpu;
+  machine_state machine;
+
+  // Set by the vblank of the frame being run, it stays clear when the CPU stopped for good before
+  uint8_t frame_ended;
+
+  uint32_t score;
+  uint8_t done;
+} gym_instance;
+
+typedef struct {
+  gym_instance *instances;
+  uint32_t count;
+
+  uint8_t observation;
+  uint32_t observation_size;
+
+  // Memory at power-on, loaded back on every reset
+  uint8_t *boot_memory;
+
+  // One shared memory object holds the ROM, loaded once at rom, and the RAM of every instance
+  memory_arena arena;
+  uint32_t rom;
+  memory_map *maps;
+} gym_env;
+
+gym_env *gym_create(const char *rom_path, uint32_t count, uint8_t observation);
+void gym_destroy(gym_env *env);
+
+void gym_reset(gym_env *env, uint8_t *observations);
+void gym_step(gym_env *env, const uint8_t *actions, float *rewards, uint8_t *dones, uint8_t *observations);
@@ -0,0 +1,86 @@
+#include "benchmark.h"
+#include "gym.h"
+
+// Steps a batch of instances with random actions and prints how many frames are emulated per second.
+// Usage: gym_benchmark [instances] [steps] [observation]
+// Observation 0 is the packed frame, 1 the downsampled grayscale image.
+
+// Code cache of the engine the gym is built with, every instance has its own
+size_t cache_bytes(cpu_state *state) {
+#if CPU_DISPATCH == CPU_DISPATCH_BLOCK
+  size_t bytes = sizeof(cpu_block_cache);
+
+  for (uint32_t address = 0; address < 0x10000; address++) {
+    bytes += state->block_cache->blocks[address] ? sizeof(cpu_block) : 0;
+  }
+
+  return bytes;
+#elif CPU_DISPATCH == CPU_DISPATCH_AOT
+  return sizeof(cpu_aot_cache);
+#else
+  return 0;
+#endif
+}
+
+int main(int argc, char **argv) {
+  uint32_t count = argc > 1 ? strtoul(argv[1], NULL, 0) : 64;
+  uint32_t steps = argc > 2 ? strtoul(argv[2], NULL, 0) : 1000;
+  uint8_t observation = argc > 3 ? strtoul(argv[3], NULL, 0) : GYM_OBSERVATION_GRAYSCALE;
+
+  gym_env *env = gym_create("../roms/invaders.rom", count, observation);
+
+  if (!env) {
+    return 1;
+  }
+
+  uint8_t *actions = malloc(count);
+  float *rewards = malloc(count * sizeof(float));
+  uint8_t *dones = malloc(count);
+  uint8_t *observations = malloc((size_t) count * env->observation_size);
+
+  uint32_t seed = 1;
+  uint32_t episodes = 0;
+  double score = 0;
+
+  gym_reset(env, observations);
+  double start_time = benchmark_wall_seconds();
+
+  for (uint32_t step = 0; step < steps; step++) {
+    for (uint32_t i = 0; i < count; i++) {
+      seed = seed * 1103515245 + 12345;
+      actions[i] = (seed >> 16) & (GYM_ACTION_LEFT | GYM_ACTION_RIGHT | GYM_ACTION_FIRE);
+    }
+
+    gym_step(env, actions, rewards, dones, observations);
+
+    for (uint32_t i = 0; i < count; i++) {
+      score += rewards[i];
+      episodes += dones[i];
+    }
+  }
+
+  double seconds = benchmark_wall_seconds() - start_time;
+  double frames = (double) count * steps;
+  printf("%u instances, %u steps in %.2f s | %.0f frames/s | %.1fx real time | %u episodes ended | %.0f points\n",
+         count, steps, seconds, frames / seconds, frames / seconds / 60.0, episodes, score);
+
+  // What an instance adds on top of the shared ROM, its code cache included
+  uint32_t rom_pages = MACHINE_ROM_SIZE >> MEMORY_PAGE_SHIFT;
+  size_t private_bytes = (size_t) (env->arena.used - rom_pages) * MEMORY_PAGE_SIZE / count;
+  size_t cache = 0;
+
+  for (uint32_t i = 0; i < count; i++) {
+    cache += cache_bytes(&env->instances[i].cpu);
+  }
+
+  cache /= count;
+  printf("%zu bytes private per instance, %zu of them code cache | %u bytes of ROM shared\n",
+         private_bytes + sizeof(memory_map) + sizeof(gym_instance) + cache, cache, MACHINE_ROM_SIZE);
+
+  free(actions);
+  free(rewards);
+  free(dones);
+  free(observations);
+  gym_destroy(env);
+  return 0;
+}
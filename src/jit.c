@@ -0,0 +1,704 @@
+#include "jit.h"
+
+#if CPU_JIT
+
+#include <stddef.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#if !defined(__x86_64__) && !defined(_M_X64)
+#error "CPU_JIT needs an x86-64 host"
+#endif
+
+#define JIT_STATE(field) ((uint8_t) offsetof(cpu_state, field))
+#define JIT_MAX_BLOCK_CODE 16384
+
+// Translated code keeps A in al, BC in cx, DE in dx, HL in bx, the cpu_state in rbp and the memory map in r11.
+// F and SP stay in the cpu_state, esi holds guest addresses, rdi the host memory behind them and ah is used to move
+// flags through lahf/sahf.
+static const uint8_t jit_guest_registers[8] = {JIT_CH, JIT_CL, JIT_DH, JIT_DL, JIT_BH, JIT_BL, 0xFF, JIT_AL};
+static const uint8_t jit_guest_pairs[3] = {JIT_CL, JIT_DL, JIT_BL};
+
+// ADD ADC SUB SBB ANA XRA ORA CMP as x86 "op r8, r/m8"
+static const uint8_t jit_alu_opcodes[8] = {0x02, 0x12, 0x2A, 0x1A, 0x22, 0x32, 0x0A, 0x3A};
+
+// Condition codes of Jcc to the flag they test
+static const uint8_t jit_condition_flags[4] = {FLAG_Z, FLAG_C, FLAG_P, FLAG_S};
+
+void jit_init(cpu_block_cache *cache) {
+#ifdef _WIN32
+  cache->jit_code = VirtualAlloc(NULL, CPU_JIT_CODE_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
+#else
+  cache->jit_code = mmap(NULL, CPU_JIT_CODE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+  if (cache->jit_code == MAP_FAILED) {
+    cache->jit_code = NULL;
+  }
+#endif
+
+  if (!cache->jit_code) {
+    printf("JIT CODE BUFFER COULD NOT BE ALLOCATED\n");
+    exit(1);
+  }
+
+  jit_reset(cache);
+}
+
+void jit_destroy(cpu_block_cache *cache) {
+#ifdef _WIN32
+  VirtualFree(cache->jit_code, 0, MEM_RELEASE);
+#else
+  munmap(cache->jit_code, CPU_JIT_CODE_SIZE);
+#endif
+}
+
+void jit_reset(cpu_block_cache *cache) {
+  cache->jit_used = 0;
+}
+
+static void jit_emit(jit_buffer *j, uint8_t byte) {
+  j->code[j->size++] = byte;
+}
+
+static void jit_emit16(jit_buffer *j, uint16_t value) {
+  jit_emit(j, value & 0xFF);
+  jit_emit(j, value >> 8);
+}
+
+static void jit_emit32(jit_buffer *j, uint32_t value) {
+  jit_emit16(j, value & 0xFFFF);
+  jit_emit16(j, value >> 16);
+}
+
+static void jit_emit64(jit_buffer *j, uint64_t value) {
+  jit_emit32(j, value & 0xFFFFFFFF);
+  jit_emit32(j, value >> 32);
+}
+
+static void jit_patch(jit_buffer *j, uint32_t position) {
+  int32_t offset = j->size - (position + 4);
+  memcpy(j->code + position, &offset, sizeof(offset));
+}
+
+// ModRM for [rbp + offset]
+static void jit_emit_state(jit_buffer *j, uint8_t reg, uint8_t offset) {
+  jit_emit(j, 0x45 | reg << 3);
+  jit_emit(j, offset);
+}
+
+// ModRM and SIB for [rdi + rsi]
+static void jit_emit_memory(jit_buffer *j, uint8_t reg) {
+  jit_emit(j, 0x04 | reg << 3);
+  jit_emit(j, 0x37);
+}
+
+// op reg, r/m8 for a register, [rdi + rsi] or an immediate source
+static void jit_emit_operand(jit_buffer *j, uint8_t opcode, uint8_t reg, uint8_t kind, uint8_t value) {
+  switch (kind) {
+    case JIT_OPERAND_REGISTER:
+      jit_emit(j, opcode);
+      jit_emit(j, 0xC0 | reg << 3 | value);
+      break;
+
+    case JIT_OPERAND_MEMORY:
+      jit_emit(j, opcode);
+      jit_emit_memory(j, reg);
+      break;
+
+    case JIT_OPERAND_IMMEDIATE:
+      jit_emit(j, 0x80);
+      jit_emit(j, 0xC0 | (opcode & 0x38) | reg);
+      jit_emit(j, value);
+      break;
+  }
+}
+
+// movzx esi, pair
+static void jit_emit_address_pair(jit_buffer *j, uint8_t pair) {
+  jit_emit(j, 0x0F);
+  jit_emit(j, 0xB7);
+  jit_emit(j, 0xF0 | pair);
+}
+
+// mov esi, address
+static void jit_emit_address(jit_buffer *j, uint16_t address) {
+  jit_emit(j, 0xBE);
+  jit_emit32(j, address);
+}
+
+// mov ah, [f]; sahf
+static void jit_emit_load_flags(jit_buffer *j) {
+  jit_emit(j, 0x8A);
+  jit_emit_state(j, JIT_AH, JIT_STATE(f));
+  jit_emit(j, 0x9E);
+}
+
+// lahf; mov [f], ah. x86 keeps SZ-A-P1C in the same bits as the 8080, only AC after subtraction is inverted
+static void jit_emit_store_flags(jit_buffer *j, uint8_t invert_ac) {
+  jit_emit(j, 0x9F);
+
+  if (invert_ac) {
+    jit_emit(j, 0x80);
+    jit_emit(j, 0xF4);
+    jit_emit(j, FLAG_AC);
+  }
+
+  jit_emit(j, 0x88);
+  jit_emit_state(j, JIT_AH, JIT_STATE(f));
+}
+
+static void jit_emit_spill(jit_buffer *j) {
+  jit_emit(j, 0x88);
+  jit_emit_state(j, JIT_AL, JIT_STATE(a));
+
+  for (uint8_t i = 0; i < 3; i++) {
+    jit_emit(j, 0x66);
+    jit_emit(j, 0x89);
+    jit_emit_state(j, jit_guest_pairs[i], i == 0 ? JIT_STATE(bc) : i == 1 ? JIT_STATE(de) : JIT_STATE(hl));
+  }
+}
+
+static void jit_emit_reload(jit_buffer *j) {
+  jit_emit(j, 0x8A);
+  jit_emit_state(j, JIT_AL, JIT_STATE(a));
+
+  for (uint8_t i = 0; i < 3; i++) {
+    jit_emit(j, 0x66);
+    jit_emit(j, 0x8B);
+    jit_emit_state(j, jit_guest_pairs[i], i == 0 ? JIT_STATE(bc) : i == 1 ? JIT_STATE(de) : JIT_STATE(hl));
+  }
+
+  // mov r11, [memory]
+  jit_emit(j, 0x4C);
+  jit_emit(j, 0x8B);
+  jit_emit_state(j, 3, JIT_STATE(memory));
+}
+
+// Accounts for the executed instructions and leaves through the shared epilogue
+static void jit_emit_exit(jit_buffer *j, uint8_t count, uint32_t cycles, uint16_t pc) {
+  jit_emit(j, 0x48);
+  jit_emit(j, 0x81);
+  jit_emit_state(j, 0, JIT_STATE(cycles));
+  jit_emit32(j, cycles);
+
+  jit_emit(j, 0x66);
+  jit_emit(j, 0xC7);
+  jit_emit_state(j, 0, JIT_STATE(pc));
+  jit_emit16(j, pc);
+
+  // mov r8d, count
+  jit_emit(j, 0x41);
+  jit_emit(j, 0xB8);
+  jit_emit32(j, count);
+
+  jit_emit(j, 0xE9);
+  j->epilogue_jumps[j->epilogue_jump_count++] = j->size;
+  jit_emit32(j, 0);
+}
+
+// Points rdi at the host memory of the page of esi, from the read or write table of the map. Pages without host
+// memory leave the block before the instruction, which the interpreter then runs through the handlers
+static void jit_emit_page(jit_buffer *j, uint8_t write, cpu_micro_op *op, uint8_t count, uint32_t cycles,
+                          uint16_t pc) {
+  // mov r9d, esi; shr r9d, MEMORY_PAGE_SHIFT
+  jit_emit(j, 0x41);
+  jit_emit(j, 0x89);
+  jit_emit(j, 0xF1);
+  jit_emit(j, 0x41);
+  jit_emit(j, 0xC1);
+  jit_emit(j, 0xE9);
+  jit_emit(j, MEMORY_PAGE_SHIFT);
+
+#if MEMORY_PORTABLE
+  // Mirrors are copies that the slow path keeps in step, stores to any slow page leave the block too
+  if (write) {
+    // bt dword [r11 + slow_writes], r9d; jnc direct
+    jit_emit(j, 0x45);
+    jit_emit(j, 0x0F);
+    jit_emit(j, 0xA3);
+    jit_emit(j, 0x8B);
+    jit_emit32(j, offsetof(memory_map, slow_writes));
+    jit_emit(j, 0x0F);
+    jit_emit(j, 0x83);
+    uint32_t direct = j->size;
+    jit_emit32(j, 0);
+
+    jit_emit_exit(j, count - 1, cycles - op->cycles, pc - op->length);
+    jit_patch(j, direct);
+  }
+#endif
+
+  // mov rdi, [r11 + r9 * 8 + table]; test rdi, rdi; jnz mapped
+  jit_emit(j, 0x4B);
+  jit_emit(j, 0x8B);
+  jit_emit(j, 0xBC);
+  jit_emit(j, 0xCB);
+  jit_emit32(j, write ? offsetof(memory_map, write) : offsetof(memory_map, read));
+  jit_emit(j, 0x48);
+  jit_emit(j, 0x85);
+  jit_emit(j, 0xFF);
+  jit_emit(j, 0x0F);
+  jit_emit(j, 0x85);
+  uint32_t mapped = j->size;
+  jit_emit32(j, 0);
+
+  jit_emit_exit(j, count - 1, cycles - op->cycles, pc - op->length);
+  jit_patch(j, mapped);
+}
+
+// Follows a store to [rdi + rsi]: writes to cached code invalidate it, and leave if the running block was hit
+static void jit_emit_write_check(jit_buffer *j, uint8_t count, uint32_t cycles, uint16_t pc) {
+  jit_emit(j, 0x49);
+  jit_emit(j, 0xB8);
+  jit_emit64(j, (uintptr_t) j->cache->code_refs);
+
+  // cmp byte [r8 + rsi], 0; je done
+  jit_emit(j, 0x41);
+  jit_emit(j, 0x80);
+  jit_emit(j, 0x3C);
+  jit_emit(j, 0x30);
+  jit_emit(j, 0x00);
+  jit_emit(j, 0x0F);
+  jit_emit(j, 0x84);
+  uint32_t unused_code = j->size;
+  jit_emit32(j, 0);
+
+  jit_emit_spill(j);
+
+#ifdef _WIN32
+  jit_emit(j, 0x48);
+  jit_emit(j, 0xB9);
+  jit_emit64(j, (uintptr_t) j->cache);
+  jit_emit(j, 0x89);
+  jit_emit(j, 0xF2);
+#else
+  jit_emit(j, 0x48);
+  jit_emit(j, 0xBF);
+  jit_emit64(j, (uintptr_t) j->cache);
+#endif
+
+  jit_emit(j, 0x48);
+  jit_emit(j, 0xB8);
+  jit_emit64(j, (uintptr_t) cpu_invalidate_blocks);
+  jit_emit(j, 0xFF);
+  jit_emit(j, 0xD0);
+
+  jit_emit_reload(j);
+
+  // cmp qword [current], 0; jne done
+  jit_emit(j, 0x49);
+  jit_emit(j, 0xB8);
+  jit_emit64(j, (uintptr_t) &j->cache->current);
+  jit_emit(j, 0x49);
+  jit_emit(j, 0x83);
+  jit_emit(j, 0x38);
+  jit_emit(j, 0x00);
+  jit_emit(j, 0x0F);
+  jit_emit(j, 0x85);
+  uint32_t running_block = j->size;
+  jit_emit32(j, 0);
+
+  jit_emit_exit(j, count, cycles, pc);
+
+  jit_patch(j, unused_code);
+  jit_patch(j, running_block);
+}
+
+static void jit_emit_alu(jit_buffer *j, uint8_t alu, uint8_t kind, uint8_t value) {
+  uint8_t opcode = jit_alu_opcodes[alu];
+
+  if (opcode == 0x12 || opcode == 0x1A) {
+    jit_emit_load_flags(j);
+  }
+
+  // ANA sets AC from bit 3 of the operands, parked in f until the result flags are known
+  if (opcode == 0x22) {
+    jit_emit(j, 0x88);
+    jit_emit(j, 0xC4);
+    jit_emit_operand(j, 0x0A, JIT_AH, kind, value);
+    jit_emit(j, 0x80);
+    jit_emit(j, 0xE4);
+    jit_emit(j, 0x08);
+    jit_emit(j, 0xD0);
+    jit_emit(j, 0xE4);
+    jit_emit(j, 0x88);
+    jit_emit_state(j, JIT_AH, JIT_STATE(f));
+  }
+
+  jit_emit_operand(j, opcode, JIT_AL, kind, value);
+
+  if (opcode == 0x22 || opcode == 0x32 || opcode == 0x0A) {
+    jit_emit(j, 0x9F);
+    jit_emit(j, 0x80);
+    jit_emit(j, 0xE4);
+    jit_emit(j, (uint8_t) ~(FLAG_AC | FLAG_C));
+
+    if (opcode == 0x22) {
+      jit_emit(j, 0x0A);
+      jit_emit_state(j, JIT_AH, JIT_STATE(f));
+    }
+
+    jit_emit(j, 0x88);
+    jit_emit_state(j, JIT_AH, JIT_STATE(f));
+  } else {
+    jit_emit_store_flags(j, opcode == 0x2A || opcode == 0x1A || opcode == 0x3A);
+  }
+}
+
+uint8_t jit_supports(cpu_micro_op *op) {
+  uint8_t op_code = op->op_code;
+
+  // MOV, ALU with a register or M, ALU immediate, INR/DCR, MVI, LXI/INX/DCX/DAD
+  if (((op_code & 0xC0) == 0x40 && op_code != HLT) || (op_code & 0xC0) == 0x80 || (op_code & 0xC7) == 0xC6 ||
+      (op_code & 0xC6) == 0x04 || (op_code & 0xC7) == 0x06 || (op_code & 0xC7) == 0x01 || (op_code & 0xC7) == 0x03 ||
+      (op_code & 0xCF) == 0x09) {
+    return 1;
+  }
+
+  switch (op_code) {
+    case NOP: case STAX_B: case STAX_D: case LDAX_B: case LDAX_D:
+    case RLC: case RRC: case RAL: case RAR:
+    case SHLD: case LHLD: case STA: case LDA:
+    case CMA: case STC: case CMC:
+    case JMP: case JNZ: case JZ: case JNC: case JC: case JPO: case JPE: case JP: case JM:
+    case EI: case DI: case XCHG:
+      return 1;
+
+    default:
+      return 0;
+  }
+}
+
+// Emits one instruction, returns 1 when it already left the block
+static uint8_t jit_emit_op(jit_buffer *j, cpu_micro_op *op, uint8_t count, uint32_t cycles, uint16_t pc) {
+  uint8_t op_code = op->op_code;
+  uint8_t dst = (op_code >> 3) & 0x7;
+  uint8_t src = op_code & 0x7;
+  uint8_t pair = (op_code >> 4) & 0x3;
+
+  if ((op_code & 0xC0) == 0x40) {
+    if (src == 6) {
+      jit_emit_address_pair(j, JIT_BL);
+      jit_emit_page(j, 0, op, count, cycles, pc);
+      jit_emit(j, 0x8A);
+      jit_emit_memory(j, jit_guest_registers[dst]);
+    } else if (dst == 6) {
+      jit_emit_address_pair(j, JIT_BL);
+      jit_emit_page(j, 1, op, count, cycles, pc);
+      jit_emit(j, 0x88);
+      jit_emit_memory(j, jit_guest_registers[src]);
+      jit_emit_write_check(j, count, cycles, pc);
+    } else {
+      jit_emit_operand(j, 0x8A, jit_guest_registers[dst], JIT_OPERAND_REGISTER, jit_guest_registers[src]);
+    }
+
+    return 0;
+  }
+
+  if ((op_code & 0xC0) == 0x80) {
+    if (src == 6) {
+      jit_emit_address_pair(j, JIT_BL);
+      jit_emit_page(j, 0, op, count, cycles, pc);
+      jit_emit_alu(j, dst, JIT_OPERAND_MEMORY, 0);
+    } else {
+      jit_emit_alu(j, dst, JIT_OPERAND_REGISTER, jit_guest_registers[src]);
+    }
+
+    return 0;
+  }
+
+  if ((op_code & 0xC7) == 0xC6) {
+    jit_emit_alu(j, dst, JIT_OPERAND_IMMEDIATE, op->imm);
+    return 0;
+  }
+
+  // INR/DCR keep the guest carry, so it is loaded into CF which INC/DEC leave alone. The page lookup changes the
+  // host flags and goes first
+  if ((op_code & 0xC6) == 0x04) {
+    uint8_t digit = op_code & 0x1;
+
+    if (dst == 6) {
+      jit_emit_address_pair(j, JIT_BL);
+      jit_emit_page(j, 1, op, count, cycles, pc);
+    }
+
+    jit_emit_load_flags(j);
+
+    if (dst == 6) {
+      jit_emit(j, 0xFE);
+      jit_emit_memory(j, digit);
+      jit_emit_store_flags(j, digit);
+      jit_emit_write_check(j, count, cycles, pc);
+    } else {
+      jit_emit(j, 0xFE);
+      jit_emit(j, 0xC0 | digit << 3 | jit_guest_registers[dst]);
+      jit_emit_store_flags(j, digit);
+    }
+
+    return 0;
+  }
+
+  if ((op_code & 0xC7) == 0x06) {
+    if (dst == 6) {
+      jit_emit_address_pair(j, JIT_BL);
+      jit_emit_page(j, 1, op, count, cycles, pc);
+      jit_emit(j, 0xC6);
+      jit_emit_memory(j, 0);
+      jit_emit(j, op->imm);
+      jit_emit_write_check(j, count, cycles, pc);
+    } else {
+      jit_emit(j, 0xB0 | jit_guest_registers[dst]);
+      jit_emit(j, op->imm);
+    }
+
+    return 0;
+  }
+
+  // LXI, INX, DCX and DAD on SP work on the cpu_state directly
+  if ((op_code & 0xC7) == 0x01 || (op_code & 0xC7) == 0x03 || (op_code & 0xCF) == 0x09) {
+    uint8_t opcode = (op_code & 0xCF) == 0x01 ? 0xC7 : (op_code & 0xCF) == 0x09 ? 0x03 : 0xFF;
+    uint8_t digit = (op_code & 0xCF) == 0x0B ? 1 : 0;
+
+    if (opcode == 0x03) {
+      // mov ah, [f]; and ah, ~C; add bx, pair; adc ah, 0; mov [f], ah
+      jit_emit(j, 0x8A);
+      jit_emit_state(j, JIT_AH, JIT_STATE(f));
+      jit_emit(j, 0x80);
+      jit_emit(j, 0xE4);
+      jit_emit(j, (uint8_t) ~FLAG_C);
+    }
+
+    jit_emit(j, 0x66);
+
+    if (pair == 3) {
+      jit_emit(j, opcode);
+      jit_emit_state(j, opcode == 0x03 ? JIT_BL : digit, JIT_STATE(sp));
+    } else if (opcode == 0xC7) {
+      jit_emit(j, 0xB8 | jit_guest_pairs[pair]);
+    } else if (opcode == 0x03) {
+      jit_emit(j, 0x01);
+      jit_emit(j, 0xC0 | jit_guest_pairs[pair] << 3 | JIT_BL);
+    } else {
+      jit_emit(j, 0xFF);
+      jit_emit(j, 0xC0 | digit << 3 | jit_guest_pairs[pair]);
+    }
+
+    if (opcode == 0xC7) {
+      jit_emit16(j, op->imm);
+    }
+
+    if (opcode == 0x03) {
+      jit_emit(j, 0x80);
+      jit_emit(j, 0xD4);
+      jit_emit(j, 0x00);
+      jit_emit(j, 0x88);
+      jit_emit_state(j, JIT_AH, JIT_STATE(f));
+    }
+
+    return 0;
+  }
+
+  switch (op_code) {
+    case NOP:
+      return 0;
+
+    case STAX_B:
+    case STAX_D:
+      jit_emit_address_pair(j, jit_guest_pairs[pair]);
+      jit_emit_page(j, 1, op, count, cycles, pc);
+      jit_emit(j, 0x88);
+      jit_emit_memory(j, JIT_AL);
+      jit_emit_write_check(j, count, cycles, pc);
+      return 0;
+
+    case LDAX_B:
+    case LDAX_D:
+      jit_emit_address_pair(j, jit_guest_pairs[pair]);
+      jit_emit_page(j, 0, op, count, cycles, pc);
+      jit_emit(j, 0x8A);
+      jit_emit_memory(j, JIT_AL);
+      return 0;
+
+    case STA:
+      jit_emit_address(j, op->imm);
+      jit_emit_page(j, 1, op, count, cycles, pc);
+      jit_emit(j, 0x88);
+      jit_emit_memory(j, JIT_AL);
+      jit_emit_write_check(j, count, cycles, pc);
+      return 0;
+
+    case LDA:
+      jit_emit_address(j, op->imm);
+      jit_emit_page(j, 0, op, count, cycles, pc);
+      jit_emit(j, 0x8A);
+      jit_emit_memory(j, JIT_AL);
+      return 0;
+
+    case SHLD:
+      jit_emit_address(j, op->imm);
+      jit_emit_page(j, 1, op, count, cycles, pc);
+      jit_emit(j, 0x88);
+      jit_emit_memory(j, JIT_BL);
+      jit_emit_write_check(j, count, cycles, pc);
+      jit_emit_address(j, op->imm + 1);
+      jit_emit_page(j, 1, op, count, cycles, pc);
+      jit_emit(j, 0x88);
+      jit_emit_memory(j, JIT_BH);
+      jit_emit_write_check(j, count, cycles, pc);
+      return 0;
+
+    case LHLD:
+      jit_emit_address(j, op->imm);
+      jit_emit_page(j, 0, op, count, cycles, pc);
+      jit_emit(j, 0x8A);
+      jit_emit_memory(j, JIT_BL);
+      jit_emit_address(j, op->imm + 1);
+      jit_emit_page(j, 0, op, count, cycles, pc);
+      jit_emit(j, 0x8A);
+      jit_emit_memory(j, JIT_BH);
+      return 0;
+
+    // Rotates only change CF, so the other flags go through sahf/lahf untouched
+    case RLC:
+    case RRC:
+    case RAL:
+    case RAR:
+      jit_emit_load_flags(j);
+      jit_emit(j, 0xD0);
+      jit_emit(j, 0xC0 | (op_code == RLC ? 0 : op_code == RRC ? 1 : op_code == RAL ? 2 : 3) << 3 | JIT_AL);
+      jit_emit_store_flags(j, 0);
+      return 0;
+
+    case CMA:
+      jit_emit(j, 0xF6);
+      jit_emit(j, 0xD0 | JIT_AL);
+      return 0;
+
+    case STC:
+    case CMC:
+      jit_emit(j, 0x80);
+      jit_emit_state(j, op_code == STC ? 1 : 6, JIT_STATE(f));
+      jit_emit(j, FLAG_C);
+      return 0;
+
+    case EI:
+    case DI:
+      jit_emit(j, 0xC6);
+      jit_emit_state(j, 0, JIT_STATE(interrupt_enable));
+      jit_emit(j, op_code == EI);
+      return 0;
+
+    case XCHG:
+      jit_emit(j, 0x66);
+      jit_emit(j, 0x87);
+      jit_emit(j, 0xC0 | JIT_DL << 3 | JIT_BL);
+      return 0;
+
+    case JMP:
+      jit_emit_exit(j, count, cycles, op->imm);
+      return 1;
+
+    default: {
+      // Jcc: even conditions jump when their flag is clear, odd ones when it is set
+      jit_emit(j, 0xF6);
+      jit_emit_state(j, 0, JIT_STATE(f));
+      jit_emit(j, jit_condition_flags[dst >> 1]);
+      jit_emit(j, 0x0F);
+      jit_emit(j, dst & 0x1 ? 0x85 : 0x84);
+      uint32_t taken = j->size;
+      jit_emit32(j, 0);
+
+      jit_emit_exit(j, count, cycles, pc);
+      jit_patch(j, taken);
+      jit_emit_exit(j, count, cycles, op->imm);
+      return 1;
+    }
+  }
+}
+
+uint8_t jit_compile_block(cpu_block_cache *cache, cpu_block *block) {
+  uint8_t count = 0;
+
+  while (count < block->count && jit_supports(&block->ops[count])) {
+    count++;
+  }
+
+  if (!count || cache->jit_used + JIT_MAX_BLOCK_CODE > CPU_JIT_CODE_SIZE) {
+    return 0;
+  }
+
+  jit_buffer j;
+  j.cache = cache;
+  j.code = cache->jit_code + cache->jit_used;
+  j.size = 0;
+  j.epilogue_jump_count = 0;
+
+  // push rbx; push rbp; push rdi; push rsi; sub rsp, 40
+  jit_emit(&j, 0x53);
+  jit_emit(&j, 0x55);
+  jit_emit(&j, 0x57);
+  jit_emit(&j, 0x56);
+  jit_emit(&j, 0x48);
+  jit_emit(&j, 0x83);
+  jit_emit(&j, 0xEC);
+  jit_emit(&j, 0x28);
+
+  // mov rbp, first argument
+  jit_emit(&j, 0x48);
+  jit_emit(&j, 0x89);
+#ifdef _WIN32
+  jit_emit(&j, 0xCD);
+#else
+  jit_emit(&j, 0xFD);
+#endif
+
+  jit_emit_reload(&j);
+
+  uint32_t cycles = 0;
+  uint16_t pc = block->start;
+  uint8_t left = 0;
+
+  for (uint8_t i = 0; i < count; i++) {
+    cpu_micro_op *op = &block->ops[i];
+    pc += op->length;
+    cycles += op->cycles;
+    left = jit_emit_op(&j, op, i + 1, cycles, pc);
+  }
+
+  if (!left) {
+    jit_emit_exit(&j, count, cycles, pc);
+  }
+
+  for (uint8_t i = 0; i < j.epilogue_jump_count; i++) {
+    jit_patch(&j, j.epilogue_jumps[i]);
+  }
+
+  jit_emit_spill(&j);
+
+  // mov eax, r8d; add rsp, 40; pop rsi; pop rdi; pop rbp; pop rbx; ret
+  jit_emit(&j, 0x44);
+  jit_emit(&j, 0x89);
+  jit_emit(&j, 0xC0);
+  jit_emit(&j, 0x48);
+  jit_emit(&j, 0x83);
+  jit_emit(&j, 0xC4);
+  jit_emit(&j, 0x28);
+  jit_emit(&j, 0x5E);
+  jit_emit(&j, 0x5F);
+  jit_emit(&j, 0x5D);
+  jit_emit(&j, 0x5B);
+  jit_emit(&j, 0xC3);
+
+  block->native = (cpu_native_block) (uintptr_t) j.code;
+  block->native_guard = cycles - block->ops[count - 1].cycles;
+
+  cache->jit_used += (j.size + 15) & ~15;
+  cache->jit_blocks++;
+  return count;
+}
+
+#endif
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "cpu.h"
+
+// Host registers holding the guest registers inside translated code
+enum JitRegisters {
+  JIT_AL = 0x0,
+  JIT_CL = 0x1,
+  JIT_DL = 0x2,
+  JIT_BL = 0x3,
+  JIT_AH = 0x4,
+  JIT_CH = 0x5,
+  JIT_DH = 0x6,
+  JIT_BH = 0x7,
+};
+
+enum JitOperands {
+  JIT_OPERAND_REGISTER = 0x0,
+  JIT_OPERAND_MEMORY = 0x1,
+  JIT_OPERAND_IMMEDIATE = 0x2,
+};
+
+typedef struct {
+  cpu_block_cache *cache;
+  uint8_t *code;
+  uint32_t size;
+
+  uint32_t epilogue_jumps[CPU_BLOCK_MAX_OPS * 4 + 2];
+  uint8_t epilogue_jump_count;
+} jit_buffer;
+
+void jit_init(cpu_block_cache *cache);
+void jit_destroy(cpu_block_cache *cache);
+void jit_reset(cpu_block_cache *cache);
+
+uint8_t jit_supports(cpu_micro_op *op);
+uint8_t jit_compile_block(cpu_block_cache *cache, cpu_block *block);
@@ -0,0 +1,900 @@
+#include "lockstep.h"
+
+#if CPU_LAZY_FLAGS
+#error "The lockstep engine keeps the flags of every lane computed, build it with CPU_LAZY_FLAGS=0"
+#endif
+
+// A chunk of lanes, one byte each; every operation is a single vector instruction
+typedef uint8_t lockstep_vector __attribute__((vector_size(LOCKSTEP_WIDTH)));
+typedef int8_t lockstep_signed_vector __attribute__((vector_size(LOCKSTEP_WIDTH)));
+// The pc of every lane in a chunk, two vectors wide
+typedef uint16_t lockstep_wide_vector __attribute__((vector_size(2 * LOCKSTEP_WIDTH)));
+typedef int16_t lockstep_signed_wide_vector __attribute__((vector_size(2 * LOCKSTEP_WIDTH)));
+// The cycle counters of every lane in a chunk
+typedef uint64_t lockstep_cycle_vector __attribute__((vector_size(8 * LOCKSTEP_WIDTH)));
+typedef int64_t lockstep_signed_cycle_vector __attribute__((vector_size(8 * LOCKSTEP_WIDTH)));
+
+// Runs op_code on the lanes of the chunk at base selected by mask, pc and cycles are already advanced
+typedef void (*lockstep_kernel)(lockstep_state *lockstep, uint32_t base, uint8_t op_code, lockstep_vector mask);
+
+static lockstep_kernel lockstep_kernels[256];
+// Kernels that go through the lanes one by one on their rows, the memory and the stack of every lane are its own
+static uint8_t lockstep_lane_kernels[256];
+// Most cycles any instruction takes
+static uint8_t lockstep_max_cycles;
+
+static inline lockstep_vector lockstep_load(const uint8_t *row) {
+  lockstep_vector value;
+  memcpy(&value, row, sizeof(value));
+  return value;
+}
+
+static inline void lockstep_store(uint8_t *row, lockstep_vector value, lockstep_vector mask) {
+  value = (value & mask) | (lockstep_load(row) & ~mask);
+  memcpy(row, &value, sizeof(value));
+}
+
+static inline lockstep_vector lockstep_zsp_flags(lockstep_vector res) {
+  lockstep_vector parity = res ^ (res >> 4);
+  parity ^= parity >> 2;
+  parity ^= parity >> 1;
+
+  return (res & FLAG_S) | ((lockstep_vector) (res == 0) & FLAG_Z) | ((~parity & 1) << 2) | FLAG_ALWAYS_ONE;
+}
+
+// Carry out of every bit is (a & b) | ((a | b) & ~res), bit 3 gives AC and bit 7 gives C, as in add_carry_table
+static inline lockstep_vector lockstep_add_flags(lockstep_vector first, lockstep_vector second, lockstep_vector res) {
+  lockstep_vector carries = (first & second) | ((first | second) & ~res);
+  return lockstep_zsp_flags(res) | ((carries << 1) & FLAG_AC) | (carries >> 7);
+}
+
+// Borrow out of every bit, AC is set when bit 3 does not borrow as in sub_carry_table
+static inline lockstep_vector lockstep_sub_flags(lockstep_vector first, lockstep_vector second, lockstep_vector res) {
+  lockstep_vector borrows = (~first & (second | res)) | (second & res);
+  return lockstep_zsp_flags(res) | ((~borrows << 1) & FLAG_AC) | (borrows >> 7);
+}
+
+static inline uint8_t lockstep_read(cpu_state *state, uint16_t address) {
+#if MEMORY_READ_HANDLERS
+  return cpu_read_byte(state, address);
+#else
+  return state->data[address];
+#endif
+}
+
+// Plain RAM is stored straight into the view of the lane, ROM, handlers and cached code go through the CPU
+static inline void lockstep_write(cpu_state *state, uint16_t address, uint8_t value) {
+#if CPU_DISPATCH != CPU_DISPATCH_BLOCK && CPU_DISPATCH != CPU_DISPATCH_AOT
+  if (!(state->memory->slow_writes >> (address >> MEMORY_PAGE_SHIFT) & 1)) {
+    state->data[address] = value;
+    return;
+  }
+#endif
+
+  cpu_write_byte(state, address, value);
+}
+
+static inline uint16_t lockstep_pair(lockstep_state *lockstep, uint8_t pair, uint32_t lane) {
+  return lockstep->registers[pair][lane] << 8 | lockstep->registers[pair + 1][lane];
+}
+
+static inline void lockstep_push(lockstep_state *lockstep, uint32_t lane, uint16_t value) {
+  cpu_state *state = &lockstep->cpus[lane];
+  state->sp -= 2;
+  lockstep_write(state, state->sp, value & 0xFF);
+  lockstep_write(state, state->sp + 1, value >> 8);
+}
+
+static inline uint16_t lockstep_pop(lockstep_state *lockstep, uint32_t lane) {
+  cpu_state *state = &lockstep->cpus[lane];
+  uint16_t value = lockstep_read(state, state->sp) | lockstep_read(state, state->sp + 1) << 8;
+  state->sp += 2;
+  return value;
+}
+
+// The byte at HL of every selected lane, in the operand row
+static const uint8_t *lockstep_gather_m(lockstep_state *lockstep, uint32_t base, lockstep_vector mask) {
+  for (uint32_t i = 0; i < LOCKSTEP_WIDTH; i++) {
+    if (mask[i]) {
+      lockstep->operands[base + i] = lockstep_read(&lockstep->cpus[base + i], lockstep_pair(lockstep, LOCKSTEP_H, base + i));
+    }
+  }
+
+  return lockstep->operands + base;
+}
+
+static void lockstep_nop(lockstep_state *lockstep, uint32_t base, uint8_t op_code, lockstep_vector mask) {
+}
+
+static void lockstep_mov(lockstep_state *lockstep, uint32_t base, uint8_t op_code, lockstep_vector mask) {
+  uint8_t *dest = lockstep->registers[(op_code >> 3) & 0x7] + base;
+  lockstep_store(dest, lockstep_load(lockstep->registers[op_code & 0x7] + base), mask);
+}
+
+static void lockstep_mvi(lockstep_state *lockstep, uint32_t base, uint8_t op_code, lockstep_vector mask) {
+  uint8_t *dest = lockstep->registers[(op_code >> 3) & 0x7] + base;
+  lockstep_store(dest, lockstep_load(lockstep->imm_low + base), mask);
+}
+
+static void lockstep_inr_dcr(lockstep_state *lockstep, uint32_t base, uint8_t op_code, lockstep_vector mask) {
+  uint8_t *reg = lockstep->registers[(op_code >> 3) & 0x7] + base;
+  lockstep_vector value = lockstep_load(reg);
+  lockstep_vector flags = lockstep_load(lockstep->flags + base) & FLAG_C;
+
+  if (op_code & 0x1) {
+    value -= 1;
+    flags |= (lockstep_vector) ((value & 0xF) != 0xF) & FLAG_AC;
+  } else {
+    value += 1;
+    flags |= (lockstep_vector) ((value & 0xF) == 0) & FLAG_AC;
+  }
+
+  lockstep_store(reg, value, mask);
+  lockstep_store(lockstep->flags + base, flags | lockstep_zsp_flags(value), mask);
+}
+
+// ADD ADC SUB SBB ANA XRA ORA CMP with a register or an immediate
+static void lockstep_alu(lockstep_state *lockstep, uint32_t base, uint8_t op_code, lockstep_vector mask) {
+  uint8_t *accumulator = lockstep->registers[LOCKSTEP_A] + base;
+  lockstep_vector a = lockstep_load(accumulator);
+  const uint8_t *operands = lockstep->registers[op_code & 0x7] + base;
+
+  if ((op_code & 0xC0) == 0xC0) {
+    operands = lockstep->imm_low + base;
+  } else if ((op_code & 0x7) == 0x6) {
+    operands = lockstep_gather_m(lockstep, base, mask);
+  }
+
+  lockstep_vector operand = lockstep_load(operands);
+  lockstep_vector carry = lockstep_load(lockstep->flags + base) & FLAG_C;
+  lockstep_vector res;
+  lockstep_vector flags;
+
+  switch ((op_code >> 3) & 0x7) {
+    case 0x0:
+      res = a + operand;
+      flags = lockstep_add_flags(a, operand, res);
+      break;
+
+    case 0x1:
+      res = a + operand + carry;
+      flags = lockstep_add_flags(a, operand, res);
+      break;
+
+    case 0x2:
+      res = a - operand;
+      flags = lockstep_sub_flags(a, operand, res);
+      break;
+
+    case 0x3:
+      res = a - operand - carry;
+      flags = lockstep_sub_flags(a, operand, res);
+      break;
+
+    case 0x4:
+      res = a & operand;
+      flags = lockstep_zsp_flags(res) | (((a | operand) << 1) & FLAG_AC);
+      break;
+
+    case 0x5:
+      res = a ^ operand;
+      flags = lockstep_zsp_flags(res);
+      break;
+
+    case 0x6:
+      res = a | operand;
+      flags = lockstep_zsp_flags(res);
+      break;
+
+    default:
+      flags = lockstep_sub_flags(a, operand, a - operand);
+      res = a;
+      break;
+  }
+
+  lockstep_store(accumulator, res, mask);
+  lockstep_store(lockstep->flags + base, flags, mask);
+}
+
+static void lockstep_rotate(lockstep_state *lockstep, uint32_t base, uint8_t op_code, lockstep_vector mask) {
+  uint8_t *accumulator = lockstep->registers[LOCKSTEP_A] + base;
+  lockstep_vector a = lockstep_load(accumulator);
+  lockstep_vector flags = lockstep_load(lockstep->flags + base);
+  lockstep_vector carry = flags & FLAG_C;
+
+  switch (op_code) {
+    case RLC:
+      carry = a >> 7;
+      a = (a << 1) | carry;
+      break;
+
+    case RRC:
+      carry = a & 0x1;
+      a = (a >> 1) | (a << 7);
+      break;
+
+    case RAL:
+      a = (a << 1) | carry;
+      carry = lockstep_load(accumulator) >> 7;
+      break;
+
+    default:
+      a = (a >> 1) | (carry << 7);
+      carry = lockstep_load(accumulator) & 0x1;
+      break;
+  }
+
+  lockstep_store(accumulator, a, mask);
+  lockstep_store(lockstep->flags + base, (flags & ~FLAG_C) | carry, mask);
+}
+
+static void lockstep_carry(lockstep_state *lockstep, uint32_t base, uint8_t op_code, lockstep_vector mask) {
+  lockstep_vector flags = lockstep_load(lockstep->flags + base);
+  lockstep_store(lockstep->flags + base, op_code == STC ? flags | FLAG_C : flags ^ FLAG_C, mask);
+}
+
+static void lockstep_cma(lockstep_state *lockstep, uint32_t base, uint8_t op_code, lockstep_vector mask) {
+  uint8_t *accumulator = lockstep->registers[LOCKSTEP_A] + base;
+  lockstep_store(accumulator, ~lockstep_load(accumulator), mask);
+}
+
+// Register pairs BC, DE and HL are rows 0-1, 2-3 and 4-5, high byte first
+static void lockstep_lxi(lockstep_state *lockstep, uint32_t base, uint8_t op_code, lockstep_vector mask) {
+  uint8_t pair = (op_code >> 3) & 0x6;
+  lockstep_store(lockstep->registers[pair] + base, lockstep_load(lockstep->imm_high + base), mask);
+  lockstep_store(lockstep->registers[pair + 1] + base, lockstep_load(lockstep->imm_low + base), mask);
+}
+
+static void lockstep_inx_dcx(lockstep_state *lockstep, uint32_t base, uint8_t op_code, lockstep_vector mask) {
+  uint8_t pair = (op_code >> 3) & 0x6;
+  uint8_t *high = lockstep->registers[pair] + base;
+  uint8_t *low = lockstep->registers[pair + 1] + base;
+  lockstep_vector low_value = lockstep_load(low);
+
+  // A true comparison is all ones, subtracting it adds one
+  if (op_code & 0x8) {
+    lockstep_store(high, lockstep_load(high) + (lockstep_vector) (low_value == 0), mask);
+    lockstep_store(low, low_value - 1, mask);
+  } else {
+    lockstep_store(low, low_value + 1, mask);
+    lockstep_store(high, lockstep_load(high) - (lockstep_vector) (low_value == 0xFF), mask);
+  }
+}
+
+static void lockstep_dad(lockstep_state *lockstep, uint32_t base, uint8_t op_code, lockstep_vector mask) {
+  uint8_t pair = (op_code >> 3) & 0x6;
+  lockstep_vector h = lockstep_load(lockstep->registers[LOCKSTEP_H] + base);
+  lockstep_vector l = lockstep_load(lockstep->registers[LOCKSTEP_L] + base);
+  lockstep_vector high = lockstep_load(lockstep->registers[pair] + base);
+  lockstep_vector low = lockstep_load(lockstep->registers[pair + 1] + base);
+
+  lockstep_vector res_low = l + low;
+  lockstep_vector carry = ((l & low) | ((l | low) & ~res_low)) >> 7;
+  lockstep_vector res_high = h + high + carry;
+  carry = ((h & high) | ((h | high) & ~res_high)) >> 7;
+
+  lockstep_store(lockstep->registers[LOCKSTEP_H] + base, res_high, mask);
+  lockstep_store(lockstep->registers[LOCKSTEP_L] + base, res_low, mask);
+  lockstep_store(lockstep->flags + base, (lockstep_load(lockstep->flags + base) & ~FLAG_C) | carry, mask);
+}
+
+static void lockstep_xchg(lockstep_state *lockstep, uint32_t base, uint8_t op_code, lockstep_vector mask) {
+  for (uint8_t i = 0; i < 2; i++) {
+    uint8_t *de = lockstep->registers[LOCKSTEP_D + i] + base;
+    uint8_t *hl = lockstep->registers[LOCKSTEP_H + i] + base;
+    lockstep_vector value = lockstep_load(de);
+
+    lockstep_store(de, lockstep_load(hl), mask);
+    lockstep_store(hl, value, mask);
+  }
+}
+
+// Flag tested by the conditions NZ Z, NC C, PO PE and P M, odd conditions jump when it is set
+static const uint8_t lockstep_condition_flags[4] = {FLAG_Z, FLAG_C, FLAG_P, FLAG_S};
+
+static void lockstep_jmp(lockstep_state *lockstep, uint32_t base, uint8_t op_code, lockstep_vector mask) {
+  if (op_code != JMP) {
+    uint8_t condition = (op_code >> 3) & 0x7;
+    lockstep_vector flags = lockstep_load(lockstep->flags + base);
+    lockstep_vector set = (lockstep_vector) ((flags & lockstep_condition_flags[condition >> 1]) != 0);
+    mask &= condition & 0x1 ? set : ~set;
+  }
+
+  lockstep_wide_vector taken = (lockstep_wide_vector) __builtin_convertvector((lockstep_signed_vector) mask, lockstep_signed_wide_vector);
+  lockstep_wide_vector address = __builtin_convertvector(lockstep_load(lockstep->imm_low + base), lockstep_wide_vector) |
+                                 __builtin_convertvector(lockstep_load(lockstep->imm_high + base), lockstep_wide_vector) << 8;
+  lockstep_wide_vector pc;
+
+  memcpy(&pc, lockstep->pc + base, sizeof(pc));
+  pc = (address & taken) | (pc & ~taken);
+  memcpy(lockstep->pc + base, &pc, sizeof(pc));
+}
+
+// MOV r,M and MVI M, MOV M,r, LDA and STA, LDAX and STAX
+static void lockstep_load_store(lockstep_state *lockstep, uint32_t base, uint8_t op_code, lockstep_vector mask) {
+  for (uint32_t i = 0; i < LOCKSTEP_WIDTH; i++) {
+    if (!mask[i]) {
+      continue;
+    }
+
+    uint32_t lane = base + i;
+    cpu_state *state = &lockstep->cpus[lane];
+    uint16_t address = lockstep->imm_low[lane] | lockstep->imm_high[lane] << 8;
+
+    switch (op_code) {
+      case MVI_M_D8:
+        lockstep_write(state, lockstep_pair(lockstep, LOCKSTEP_H, lane), lockstep->imm_low[lane]);
+        break;
+
+      case LDA:
+        lockstep->registers[LOCKSTEP_A][lane] = lockstep_read(state, address);
+        break;
+
+      case STA:
+        lockstep_write(state, address, lockstep->registers[LOCKSTEP_A][lane]);
+        break;
+
+      case LDAX_B:
+      case LDAX_D:
+        address = lockstep_pair(lockstep, (op_code >> 3) & 0x6, lane);
+        lockstep->registers[LOCKSTEP_A][lane] = lockstep_read(state, address);
+        break;
+
+      case STAX_B:
+      case STAX_D:
+        address = lockstep_pair(lockstep, (op_code >> 3) & 0x6, lane);
+        lockstep_write(state, address, lockstep->registers[LOCKSTEP_A][lane]);
+        break;
+
+      default:
+        address = lockstep_pair(lockstep, LOCKSTEP_H, lane);
+
+        if ((op_code & 0x7) == 0x6) {
+          lockstep->registers[(op_code >> 3) & 0x7][lane] = lockstep_read(state, address);
+        } else {
+          lockstep_write(state, address, lockstep->registers[op_code & 0x7][lane]);
+        }
+
+        break;
+    }
+  }
+}
+
+// PUSH and POP of BC, DE, HL and PSW on the stack of every lane
+static void lockstep_push_pop(lockstep_state *lockstep, uint32_t base, uint8_t op_code, lockstep_vector mask) {
+  uint8_t pair = (op_code >> 3) & 0x6;
+
+  for (uint32_t i = 0; i < LOCKSTEP_WIDTH; i++) {
+    if (!mask[i]) {
+      continue;
+    }
+
+    uint32_t lane = base + i;
+    uint8_t *high = lockstep->registers[pair == 0x6 ? LOCKSTEP_A : pair] + lane;
+    uint8_t *low = pair == 0x6 ? lockstep->flags + lane : lockstep->registers[pair + 1] + lane;
+
+    if (op_code & 0x4) {
+      lockstep_push(lockstep, lane, *high << 8 | *low);
+    } else {
+      uint16_t value = lockstep_pop(lockstep, lane);
+      *high = value >> 8;
+      *low = pair == 0x6 ? (value & (FLAG_S | FLAG_Z | FLAG_AC | FLAG_P | FLAG_C)) | FLAG_ALWAYS_ONE : value;
+    }
+  }
+}
+
+// CALL, RET, RST and their conditional forms, the pc is already past the instruction
+static void lockstep_call_ret(lockstep_state *lockstep, uint32_t base, uint8_t op_code, lockstep_vector mask) {
+  if ((op_code & 0x7) == 0x0 || (op_code & 0x7) == 0x4) {
+    uint8_t condition = (op_code >> 3) & 0x7;
+    lockstep_vector flags = lockstep_load(lockstep->flags + base);
+    lockstep_vector set = (lockstep_vector) ((flags & lockstep_condition_flags[condition >> 1]) != 0);
+    mask &= condition & 0x1 ? set : ~set;
+  }
+
+  uint8_t taken_cycles = cycles_per_instruction_taken[op_code] - cycles_per_instruction[op_code];
+
+  for (uint32_t i = 0; i < LOCKSTEP_WIDTH; i++) {
+    if (!mask[i]) {
+      continue;
+    }
+
+    uint32_t lane = base + i;
+
+    if ((op_code & 0x7) == 0x7) {
+      lockstep_push(lockstep, lane, lockstep->pc[lane]);
+      lockstep->pc[lane] = op_code & 0x38;
+      continue;
+    }
+
+    if (op_code & 0x4) {
+      lockstep_push(lockstep, lane, lockstep->pc[lane]);
+      lockstep->pc[lane] = lockstep->imm_low[lane] | lockstep->imm_high[lane] << 8;
+    } else {
+      lockstep->pc[lane] = lockstep_pop(lockstep, lane);
+    }
+
+    lockstep->cycles[lane] += taken_cycles;
+  }
+}
+
+static void lockstep_init_kernels() {
+  for (uint16_t op_code = 0; op_code < 0x100; op_code++) {
+    uint8_t dest = (op_code >> 3) & 0x7;
+    uint8_t src = op_code & 0x7;
+
+    if (op_code >= 0x40 && op_code < 0x80 && dest != 0x6 && src != 0x6) {
+      lockstep_kernels[op_code] = lockstep_mov;
+    } else if (op_code >= 0x80 && op_code < 0xC0 && src != 0x6) {
+      lockstep_kernels[op_code] = lockstep_alu;
+    } else if (op_code < 0x40 && dest != 0x6 && (src == 0x4 || src == 0x5)) {
+      lockstep_kernels[op_code] = lockstep_inr_dcr;
+    } else if (op_code < 0x40 && dest != 0x6 && src == 0x6) {
+      lockstep_kernels[op_code] = lockstep_mvi;
+    } else if (op_code >= 0xC0 && src == 0x6) {
+      lockstep_kernels[op_code] = lockstep_alu;
+    } else if (op_code >= 0xC0 && src == 0x2) {
+      lockstep_kernels[op_code] = lockstep_jmp;
+    }
+  }
+
+  for (uint8_t pair = 0; pair < 3; pair++) {
+    lockstep_kernels[LXI_B + (pair << 4)] = lockstep_lxi;
+    lockstep_kernels[INX_B + (pair << 4)] = lockstep_inx_dcx;
+    lockstep_kernels[DCX_B + (pair << 4)] = lockstep_inx_dcx;
+    lockstep_kernels[DAD_B + (pair << 4)] = lockstep_dad;
+  }
+
+  for (uint16_t op_code = 0x40; op_code < 0x80; op_code++) {
+    if (op_code != HLT && ((op_code & 0x7) == 0x6 || (op_code & 0x38) == 0x30)) {
+      lockstep_kernels[op_code] = lockstep_load_store;
+    }
+  }
+
+  for (uint16_t op_code = 0xC0; op_code < 0x100; op_code++) {
+    if ((op_code & 0x7) == 0x0 || (op_code & 0x7) == 0x4 || (op_code & 0x7) == 0x7 || op_code == RET ||
+        op_code == CALL) {
+      lockstep_kernels[op_code] = lockstep_call_ret;
+    } else if ((op_code & 0xB) == 0x1) {
+      lockstep_kernels[op_code] = lockstep_push_pop;
+    }
+  }
+
+  lockstep_kernels[MVI_M_D8] = lockstep_load_store;
+  lockstep_kernels[LDA] = lockstep_load_store;
+  lockstep_kernels[STA] = lockstep_load_store;
+  lockstep_kernels[LDAX_B] = lockstep_load_store;
+  lockstep_kernels[LDAX_D] = lockstep_load_store;
+  lockstep_kernels[STAX_B] = lockstep_load_store;
+  lockstep_kernels[STAX_D] = lockstep_load_store;
+
+  for (uint16_t op_code = 0x86; op_code < 0xC0; op_code += 0x8) {
+    lockstep_kernels[op_code] = lockstep_alu;
+    lockstep_lane_kernels[op_code] = 1;
+  }
+
+  for (uint16_t op_code = 0; op_code < 0x100; op_code++) {
+    if (cycles_per_instruction_taken[op_code] > lockstep_max_cycles) {
+      lockstep_max_cycles = cycles_per_instruction_taken[op_code];
+    }
+
+    if (cycles_per_instruction[op_code] > lockstep_max_cycles) {
+      lockstep_max_cycles = cycles_per_instruction[op_code];
+    }
+
+    lockstep_lane_kernels[op_code] |= lockstep_kernels[op_code] == lockstep_load_store ||
+                                     lockstep_kernels[op_code] == lockstep_push_pop ||
+                                     lockstep_kernels[op_code] == lockstep_call_ret;
+  }
+
+  lockstep_kernels[JMP] = lockstep_jmp;
+  lockstep_kernels[NOP] = lockstep_nop;
+  lockstep_kernels[RLC] = lockstep_rotate;
+  lockstep_kernels[RRC] = lockstep_rotate;
+  lockstep_kernels[RAL] = lockstep_rotate;
+  lockstep_kernels[RAR] = lockstep_rotate;
+  lockstep_kernels[STC] = lockstep_carry;
+  lockstep_kernels[CMC] = lockstep_carry;
+  lockstep_kernels[CMA] = lockstep_cma;
+  lockstep_kernels[XCHG] = lockstep_xchg;
+}
+
+lockstep_state *lockstep_create(machine_state *machines, uint32_t count, char *file_data, uint32_t file_size) {
+  lockstep_init_kernels();
+
+  lockstep_state *lockstep = calloc(1, sizeof(lockstep_state));
+  lockstep->count = count;
+  lockstep->lanes = (count + LOCKSTEP_WIDTH - 1) / LOCKSTEP_WIDTH * LOCKSTEP_WIDTH;
+
+  uint8_t *rows = calloc(13, lockstep->lanes);
+
+  for (uint8_t i = 0; i < 8; i++) {
+    lockstep->registers[i] = rows + i * lockstep->lanes;
+  }
+
+  lockstep->flags = rows + 8 * lockstep->lanes;
+  lockstep->op_codes = rows + 9 * lockstep->lanes;
+  lockstep->imm_low = rows + 10 * lockstep->lanes;
+  lockstep->imm_high = rows + 11 * lockstep->lanes;
+  lockstep->operands = rows + 12 * lockstep->lanes;
+  lockstep->pc = calloc(lockstep->lanes, sizeof(uint16_t));
+  lockstep->cycles = calloc(lockstep->lanes, sizeof(uint64_t));
+
+  lockstep->cpus = calloc(count, sizeof(cpu_state));
+  lockstep->stop_reasons = calloc(lockstep->lanes, sizeof(uint8_t));
+
+  lockstep->maps = calloc(count, sizeof(memory_map));
+  memory_arena_init(&lockstep->arena);
+  uint32_t rom = machine_load_rom(&lockstep->arena, (uint8_t *) file_data, file_size);
+
+  for (uint32_t i = 0; i < count; i++) {
+    memory_init(&lockstep->maps[i], &lockstep->arena);
+    memcpy(lockstep->maps[i].data, file_data, file_size < 0x10000 ? file_size : 0x10000);
+    machine_map_memory(&lockstep->maps[i], rom);
+    lockstep->cpus[i] = cpu_init_memory(&machines[i], &lockstep->maps[i]);
+    cpu_set_interpreter(&lockstep->cpus[i], CPU_INTERPRETER_COUNTING);
+    lockstep_store_cpu(lockstep, i);
+  }
+
+  // Only the write-protected part of the image can be shared, an instruction has to fit in it whole
+  lockstep->rom_size = file_size < 0x2000 ? file_size : 0x2000;
+  lockstep->decoded = calloc(lockstep->rom_size, sizeof(lockstep_decoded));
+  const uint8_t *code = lockstep->maps[0].data;
+
+  for (uint32_t pc = 0; pc + 2 < lockstep->rom_size; pc++) {
+    lockstep_decoded *decoded = &lockstep->decoded[pc];
+    decoded->op_code = code[pc];
+    decoded->imm_low = code[pc + 1];
+    decoded->imm_high = code[pc + 2];
+    decoded->length = disassemble_byte_length[code[pc]];
+    decoded->cycles = cycles_per_instruction[code[pc]];
+  }
+
+  return lockstep;
+}
+
+void lockstep_destroy(lockstep_state *lockstep) {
+  for (uint32_t i = 0; i < lockstep->count; i++) {
+    cpu_destroy(&lockstep->cpus[i]);
+    memory_destroy(&lockstep->maps[i]);
+  }
+
+  memory_arena_destroy(&lockstep->arena);
+
+  free(lockstep->registers[0]);
+  free(lockstep->decoded);
+  free(lockstep->pc);
+  free(lockstep->cycles);
+  free(lockstep->cpus);
+  free(lockstep->stop_reasons);
+  free(lockstep->maps);
+  free(lockstep);
+}
+
+// Copies the registers and cycles of a lane to its cpu_state
+void lockstep_load_cpu(lockstep_state *lockstep, uint32_t lane) {
+  cpu_state *state = &lockstep->cpus[lane];
+
+  state->b = lockstep->registers[LOCKSTEP_B][lane];
+  state->c = lockstep->registers[LOCKSTEP_C][lane];
+  state->d = lockstep->registers[LOCKSTEP_D][lane];
+  state->e = lockstep->registers[LOCKSTEP_E][lane];
+  state->h = lockstep->registers[LOCKSTEP_H][lane];
+  state->l = lockstep->registers[LOCKSTEP_L][lane];
+  state->a = lockstep->registers[LOCKSTEP_A][lane];
+  state->f = lockstep->flags[lane];
+  state->pc = lockstep->pc[lane];
+  state->cycles = lockstep->cycles[lane];
+}
+
+// Copies the registers and cycles of a lane back from its cpu_state
+void lockstep_store_cpu(lockstep_state *lockstep, uint32_t lane) {
+  cpu_state *state = &lockstep->cpus[lane];
+
+  lockstep->registers[LOCKSTEP_B][lane] = state->b;
+  lockstep->registers[LOCKSTEP_C][lane] = state->c;
+  lockstep->registers[LOCKSTEP_D][lane] = state->d;
+  lockstep->registers[LOCKSTEP_E][lane] = state->e;
+  lockstep->registers[LOCKSTEP_H][lane] = state->h;
+  lockstep->registers[LOCKSTEP_L][lane] = state->l;
+  lockstep->registers[LOCKSTEP_A][lane] = state->a;
+  lockstep->flags[lane] = state->f;
+  lockstep->pc[lane] = state->pc;
+  lockstep->cycles[lane] = state->cycles;
+}
+
+void lockstep_set_interrupt(lockstep_state *lockstep, uint32_t lane, uint8_t op_code) {
+  cpu_set_interrupt(&lockstep->cpus[lane], op_code);
+}
+
+static void lockstep_run_scalar(lockstep_state *lockstep, uint32_t lane, uint8_t op_code) {
+  cpu_state *state = &lockstep->cpus[lane];
+
+  lockstep_load_cpu(lockstep, lane);
+  state->pc++;
+
+  if (op_code == HLT) {
+    state->halted = 1;
+    lockstep->stop_reasons[lane] = CPU_STOP_HALT;
+  } else if (!cpu_emulate_op_code(state, op_code)) {
+    state->pc--;
+    lockstep->stop_reasons[lane] = CPU_STOP_UNIMPLEMENTED;
+  }
+
+  lockstep_store_cpu(lockstep, lane);
+}
+
+// Number of lanes set in a mask and the first of them
+static inline uint32_t lockstep_count_lanes(lockstep_vector mask, uint32_t *first) {
+  uint64_t words[LOCKSTEP_WIDTH / 8];
+  uint32_t count = 0;
+  memcpy(words, &mask, sizeof(words));
+
+  for (uint32_t i = LOCKSTEP_WIDTH / 8; i-- > 0;) {
+    if (words[i]) {
+      *first = i * 8 + __builtin_ctzll(words[i]) / 8;
+      count += __builtin_popcountll(words[i]) / 8;
+    }
+  }
+
+  return count;
+}
+
+// Adds the cycles of an instruction to the selected lanes
+static inline void lockstep_add_cycles(uint64_t *cycles, lockstep_vector mask, uint8_t amount) {
+  uint8_t lanes[LOCKSTEP_WIDTH];
+  memcpy(lanes, &mask, sizeof(lanes));
+
+  for (uint32_t i = 0; i < LOCKSTEP_WIDTH; i++) {
+    cycles[i] += amount & -(uint64_t) (lanes[i] & 1);
+  }
+}
+
+// Whether every running lane of the chunk is at pc
+static uint8_t lockstep_together(lockstep_state *lockstep, uint32_t base, lockstep_vector running, uint16_t pc) {
+  lockstep_wide_vector pcs;
+  memcpy(&pcs, lockstep->pc + base, sizeof(pcs));
+  lockstep_wide_vector wide_running =
+      (lockstep_wide_vector) __builtin_convertvector((lockstep_signed_vector) running, lockstep_signed_wide_vector);
+  lockstep_wide_vector elsewhere = (pcs ^ pc) & wide_running;
+  uint64_t words[LOCKSTEP_WIDTH / 4];
+  uint64_t any = 0;
+  memcpy(words, &elsewhere, sizeof(words));
+
+  for (uint32_t i = 0; i < LOCKSTEP_WIDTH / 4; i++) {
+    any |= words[i];
+  }
+
+  return !any;
+}
+
+// Every running lane of the chunk is at pc, an instruction of the ROM is decoded once and run with one kernel
+// call. 0 when pc is outside the ROM or the instruction has no kernel.
+static uint8_t lockstep_step_uniform(lockstep_state *lockstep, uint32_t base, lockstep_vector running, uint16_t pc,
+                                     uint32_t active) {
+  if ((uint32_t) pc + 2 >= lockstep->rom_size) {
+    return 0;
+  }
+
+  const lockstep_decoded *decoded = &lockstep->decoded[pc];
+  lockstep_kernel kernel = lockstep_kernels[decoded->op_code];
+
+  if (!kernel) {
+    return 0;
+  }
+
+  lockstep_wide_vector pcs;
+  memcpy(&pcs, lockstep->pc + base, sizeof(pcs));
+  lockstep_wide_vector wide_running =
+      (lockstep_wide_vector) __builtin_convertvector((lockstep_signed_vector) running, lockstep_signed_wide_vector);
+  pcs += wide_running & decoded->length;
+  memcpy(lockstep->pc + base, &pcs, sizeof(pcs));
+  lockstep_add_cycles(lockstep->cycles + base, running, decoded->cycles);
+
+  lockstep_vector imm_low = (lockstep_vector) {} + decoded->imm_low;
+  lockstep_vector imm_high = (lockstep_vector) {} + decoded->imm_high;
+  memcpy(lockstep->imm_low + base, &imm_low, sizeof(imm_low));
+  memcpy(lockstep->imm_high + base, &imm_high, sizeof(imm_high));
+
+  kernel(lockstep, base, decoded->op_code, running);
+
+  if (lockstep_lane_kernels[decoded->op_code]) {
+    lockstep->lane_instructions += active;
+  } else {
+    lockstep->vector_instructions += active;
+  }
+
+  return 1;
+}
+
+// Lanes that went their own ways run on their cpu_state up to the target, one after another
+static void lockstep_run_apart(lockstep_state *lockstep, uint32_t base, uint64_t cycle_target) {
+  for (uint32_t lane = base; lane < base + LOCKSTEP_WIDTH; lane++) {
+    if (lockstep->stop_reasons[lane]) {
+      continue;
+    }
+
+    cpu_state *state = &lockstep->cpus[lane];
+    lockstep_load_cpu(lockstep, lane);
+    uint64_t instructions = state->instructions;
+    lockstep->stop_reasons[lane] = cpu_run(state, cycle_target);
+    lockstep->instructions += state->instructions - instructions;
+    lockstep->apart_instructions += state->instructions - instructions;
+    lockstep_store_cpu(lockstep, lane);
+  }
+}
+
+// Stops the lanes of the chunk that reached the target and returns how many steps all the others can take before
+// any of them could, 0 when none of them runs
+static uint32_t lockstep_check_budget(lockstep_state *lockstep, uint32_t base, uint64_t cycle_target) {
+  uint64_t slack = UINT64_MAX;
+
+  for (uint32_t lane = base; lane < base + LOCKSTEP_WIDTH; lane++) {
+    if (lockstep->stop_reasons[lane]) {
+      continue;
+    }
+
+    if (lockstep->cycles[lane] >= cycle_target) {
+      lockstep->stop_reasons[lane] = CPU_STOP_BUDGET;
+      continue;
+    }
+
+    uint64_t left = cycle_target - lockstep->cycles[lane];
+    slack = left < slack ? left : slack;
+  }
+
+  return slack == UINT64_MAX ? 0 : 1 + (slack - 1) / lockstep_max_cycles;
+}
+
+// Runs one instruction on every running lane of the chunk. Lanes on the same ROM instruction take the uniform
+// step, otherwise every lane is decoded and each distinct kernel runs once for the chunk. Apart counts the steps
+// in a row the lanes were not together.
+static uint32_t lockstep_step_chunk(lockstep_state *lockstep, uint32_t base, uint32_t *apart) {
+  lockstep_vector running = (lockstep_vector) (lockstep_load(lockstep->stop_reasons + base) == 0);
+  uint32_t first = 0;
+  uint32_t active = lockstep_count_lanes(running, &first);
+
+  if (!active) {
+    return 0;
+  }
+
+  uint16_t pc = lockstep->pc[base + first];
+  uint8_t together = lockstep_together(lockstep, base, running, pc);
+  *apart = together ? 0 : *apart + 1;
+
+  if (together && lockstep_step_uniform(lockstep, base, running, pc, active)) {
+    lockstep->uniform_steps++;
+    return active;
+  }
+
+  uint8_t kernel_ops[LOCKSTEP_WIDTH];
+  uint8_t kernel_count = 0;
+  uint32_t seen[256 / 32] = {0};
+  uint32_t vector = 0;
+  uint32_t lanes = 0;
+
+  // Byte stores may alias the state, so the rows are read once
+  uint8_t *op_codes = lockstep->op_codes;
+  uint8_t *imm_low = lockstep->imm_low;
+  uint8_t *imm_high = lockstep->imm_high;
+  uint16_t *pcs = lockstep->pc;
+  uint64_t *lane_cycles = lockstep->cycles;
+  const lockstep_decoded *rom = lockstep->decoded;
+  uint32_t rom_size = lockstep->rom_size;
+
+  for (uint32_t i = 0; i < LOCKSTEP_WIDTH; i++) {
+    uint32_t lane = base + i;
+    op_codes[lane] = HLT;
+
+    if (!running[i]) {
+      continue;
+    }
+
+    uint16_t pc = pcs[lane];
+    lockstep_decoded decoded;
+
+    if ((uint32_t) pc + 2 < rom_size) {
+      decoded = rom[pc];
+    } else {
+      const uint8_t *memory = lockstep->cpus[lane].data;
+      decoded.op_code = memory[pc];
+      decoded.imm_low = memory[(uint16_t) (pc + 1)];
+      decoded.imm_high = memory[(uint16_t) (pc + 2)];
+      decoded.length = disassemble_byte_length[decoded.op_code];
+      decoded.cycles = cycles_per_instruction[decoded.op_code];
+    }
+
+    uint8_t op_code = decoded.op_code;
+
+    if (!lockstep_kernels[op_code]) {
+      lockstep_run_scalar(lockstep, lane, op_code);
+      continue;
+    }
+
+    if (lockstep_lane_kernels[op_code]) {
+      lanes++;
+    } else {
+      vector++;
+    }
+
+    op_codes[lane] = op_code;
+    imm_low[lane] = decoded.imm_low;
+    imm_high[lane] = decoded.imm_high;
+    pcs[lane] = pc + decoded.length;
+    lane_cycles[lane] += decoded.cycles;
+
+    if (!(seen[op_code >> 5] & (1u << (op_code & 0x1F)))) {
+      seen[op_code >> 5] |= 1u << (op_code & 0x1F);
+      kernel_ops[kernel_count++] = op_code;
+    }
+  }
+
+  lockstep_vector chunk_op_codes = lockstep_load(op_codes + base);
+
+  for (uint8_t i = 0; i < kernel_count; i++) {
+    lockstep_kernels[kernel_ops[i]](lockstep, base, kernel_ops[i], (lockstep_vector) (chunk_op_codes == kernel_ops[i]));
+  }
+
+  lockstep->vector_instructions += vector;
+  lockstep->lane_instructions += lanes;
+  return active;
+}
+
+// Runs every lane up to the cycle target and returns how many lanes stopped for another reason, see stop_reasons.
+// Interrupts are raised between runs; a pending one is accepted first, like a host loop calling
+// cpu_handle_interrupt before cpu_run.
+uint32_t lockstep_run(lockstep_state *lockstep, uint64_t cycle_target) {
+  for (uint32_t lane = 0; lane < lockstep->lanes; lane++) {
+    lockstep->stop_reasons[lane] = lane < lockstep->count ? CPU_STOP_NONE : CPU_STOP_BUDGET;
+  }
+
+  for (uint32_t lane = 0; lane < lockstep->count; lane++) {
+    cpu_state *state = &lockstep->cpus[lane];
+
+    if (state->interrupt && lockstep->cycles[lane] < cycle_target) {
+      lockstep_load_cpu(lockstep, lane);
+      cpu_handle_interrupt(state);
+      lockstep_store_cpu(lockstep, lane);
+    }
+
+    if (state->halted) {
+      if (lockstep->cycles[lane] < cycle_target) {
+        lockstep->cycles[lane] = cycle_target;
+      }
+
+      lockstep->stop_reasons[lane] = CPU_STOP_HALT;
+    }
+  }
+
+  // A chunk runs to the target before the next one starts, its rows stay in the cache meanwhile. The budget is
+  // only checked when a lane could have reached the target since the last check.
+  for (uint32_t base = 0; base < lockstep->lanes; base += LOCKSTEP_WIDTH) {
+    uint32_t apart = 0;
+    uint32_t steps;
+
+    while ((steps = lockstep_check_budget(lockstep, base, cycle_target))) {
+      for (uint32_t step = 0; step < steps && apart < LOCKSTEP_APART_STEPS; step++) {
+        uint32_t active = lockstep_step_chunk(lockstep, base, &apart);
+
+        if (!active) {
+          break;
+        }
+
+        lockstep->instructions += active;
+        lockstep->steps++;
+      }
+
+      if (apart >= LOCKSTEP_APART_STEPS) {
+        lockstep_run_apart(lockstep, base, cycle_target);
+      }
+    }
+  }
+
+  uint32_t stopped = 0;
+
+  for (uint32_t lane = 0; lane < lockstep->count; lane++) {
+    stopped += lockstep->stop_reasons[lane] != CPU_STOP_BUDGET;
+  }
+
+  return stopped;
+}
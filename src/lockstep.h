@@ -0,0 +1,89 @@
+#pragma once
+
+#include "cpu.h"
+#include "machine.h"
+
+// Many instances of one ROM stepped together, one instruction per lane and step. Registers are kept in
+// structure-of-arrays form so the lanes of a chunk that run the same register instruction execute it with
+// one vector operation. Loads, stores and the stack go through the lanes of the chunk one by one on the same
+// rows, and the remaining instructions run on the lane's own cpu_state with cpu_emulate_op_code.
+
+// Lanes per vector, one AVX2 register or one SSE2 register without it
+#ifdef __AVX2__
+#define LOCKSTEP_WIDTH 32
+#else
+#define LOCKSTEP_WIDTH 16
+#endif
+
+// Steps in a row the running lanes of a chunk may be on different instructions before each of them runs on its
+// own up to the cycle target
+#define LOCKSTEP_APART_STEPS 16
+
+// Register codes of the 8080 opcodes, M (6) is memory and has no row
+enum LockstepRegisters {
+  LOCKSTEP_B = 0x0,
+  LOCKSTEP_C = 0x1,
+  LOCKSTEP_D = 0x2,
+  LOCKSTEP_E = 0x3,
+  LOCKSTEP_H = 0x4,
+  LOCKSTEP_L = 0x5,
+  LOCKSTEP_A = 0x7,
+};
+
+// An instruction of the shared ROM, decoded once for every lane
+typedef struct {
+  uint8_t op_code;
+  uint8_t imm_low;
+  uint8_t imm_high;
+  uint8_t length;
+  uint8_t cycles;
+} lockstep_decoded;
+
+typedef struct {
+  uint32_t count;
+  // Count rounded up to whole chunks, the padding lanes never run
+  uint32_t lanes;
+
+  // One byte per lane in every row
+  uint8_t *registers[8];
+  uint8_t *flags;
+  uint16_t *pc;
+  uint64_t *cycles;
+
+  // Instruction of the current step, lanes running it on their cpu_state hold HLT
+  uint8_t *op_codes;
+  uint8_t *imm_low;
+  uint8_t *imm_high;
+  // Memory operands of ALU instructions
+  uint8_t *operands;
+
+  // Memory, stack pointer and interrupt state of every lane, registers and cycles only while it runs scalar
+  cpu_state *cpus;
+  uint8_t *stop_reasons;
+
+  // Lanes take their RAM from one arena and all show the ROM loaded into it once
+  memory_arena arena;
+  memory_map *maps;
+
+  // Instructions inside the write-protected ROM are decoded once, the same pages for all lanes
+  lockstep_decoded *decoded;
+  uint32_t rom_size;
+
+  uint64_t instructions;
+  uint64_t vector_instructions;
+  // Run by the kernels that go through the lanes one by one, the rest ran on a cpu_state
+  uint64_t lane_instructions;
+  // Steps where every running lane of a chunk was on the same ROM instruction and decoding was skipped
+  uint64_t uniform_steps;
+  uint64_t steps;
+  // Run on the cpu_state of lanes whose chunk stopped stepping together, see LOCKSTEP_APART_STEPS
+  uint64_t apart_instructions;
+} lockstep_state;
+
+lockstep_state *lockstep_create(machine_state *machines, uint32_t count, char *file_data, uint32_t file_size);
+void lockstep_destroy(lockstep_state *lockstep);
+
+void lockstep_load_cpu(lockstep_state *lockstep, uint32_t lane);
+void lockstep_store_cpu(lockstep_state *lockstep, uint32_t lane);
+void lockstep_set_interrupt(lockstep_state *lockstep, uint32_t lane, uint8_t op_code);
+uint32_t lockstep_run(lockstep_state *lockstep, uint64_t cycle_target);
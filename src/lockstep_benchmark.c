@@ -0,0 +1,122 @@
+#include "benchmark.h"
+#include "lockstep.h"
+
+// Runs Space Invaders in lockstep lanes and then in as many independent cpu_states, checks that every lane
+// ends in the same state and prints both speeds in emulated instructions per second.
+// Usage: lockstep_benchmark [lanes] [frames] [divergent]
+// Without divergent every lane gets the same input; with it each lane inserts its coin on a different frame
+// and plays with its own random input, so the lanes drift apart.
+
+// Lanes of divergent input insert their coin on frames of their own and play their own random game
+void set_keys(machine_state *machine, uint32_t lane, uint32_t frame, uint8_t divergent) {
+  uint32_t coin_frame = BENCHMARK_COIN_FRAME + (divergent ? lane % 64 : 0);
+  benchmark_set_keys(machine, frame, coin_frame, divergent ? frame ^ (lane << 16) : frame);
+}
+
+// The screen interrupts of the board, at the scanlines cpu_start_video schedules them on. Lanes cannot share one
+// scheduler, so both runs raise them by hand
+uint64_t screen_interrupt_cycle(uint32_t frame, uint8_t half) {
+  uint32_t scanline = half ? MACHINE_VBLANK_SCANLINE : MACHINE_MIDSCREEN_SCANLINE;
+  return (uint64_t) frame * MACHINE_FRAME_CYCLES + scanline * MACHINE_SCANLINE_CYCLES;
+}
+
+int main(int argc, char **argv) {
+  uint32_t count = argc > 1 ? strtoul(argv[1], NULL, 0) : 256;
+  uint32_t frames = argc > 2 ? strtoul(argv[2], NULL, 0) : 300;
+  uint8_t divergent = argc > 3 ? strtoul(argv[3], NULL, 0) : 0;
+
+  uint32_t file_size;
+  char *file_buffer = benchmark_load_file("../roms/invaders.rom", 0, &file_size);
+
+  machine_state *lockstep_machines = calloc(count, sizeof(machine_state));
+  machine_state *machines = calloc(count, sizeof(machine_state));
+  cpu_state *states = calloc(count, sizeof(cpu_state));
+
+  for (uint32_t i = 0; i < count; i++) {
+    machine_init(&lockstep_machines[i]);
+    machine_init(&machines[i]);
+    states[i] = cpu_init(&machines[i], file_buffer, file_size);
+    machine_map_memory(states[i].memory, machine_load_rom(states[i].memory->arena, (uint8_t *) file_buffer, file_size));
+  }
+
+  lockstep_state *lockstep = lockstep_create(lockstep_machines, count, file_buffer, file_size);
+  free(file_buffer);
+
+  double start_time = benchmark_wall_seconds();
+
+  for (uint32_t frame = 0; frame < frames; frame++) {
+    for (uint32_t i = 0; i < count; i++) {
+      set_keys(&lockstep_machines[i], i, frame, divergent);
+    }
+
+    for (uint8_t half = 0; half < 2; half++) {
+      if (lockstep_run(lockstep, screen_interrupt_cycle(frame, half))) {
+        printf("A LANE STOPPED BEFORE THE CYCLE TARGET\n");
+        return 1;
+      }
+
+      for (uint32_t i = 0; i < count; i++) {
+        lockstep_set_interrupt(lockstep, i, half ? RST_2 : RST_1);
+      }
+    }
+  }
+
+  double lockstep_seconds = benchmark_wall_seconds() - start_time;
+  start_time = benchmark_wall_seconds();
+
+  for (uint32_t i = 0; i < count; i++) {
+    cpu_state *state = &states[i];
+
+    for (uint32_t frame = 0; frame < frames; frame++) {
+      set_keys(&machines[i], i, frame, divergent);
+
+      for (uint8_t half = 0; half < 2; half++) {
+        uint64_t next_interrupt = screen_interrupt_cycle(frame, half);
+
+        while (state->cycles < next_interrupt) {
+          if (state->interrupt) {
+            cpu_handle_interrupt(state);
+          }
+
+          if (cpu_run(state, next_interrupt) == CPU_STOP_UNIMPLEMENTED) {
+            cpu_unimplemented_op_code(state, cpu_read_byte(state, state->pc));
+            return 1;
+          }
+        }
+
+        cpu_set_interrupt(state, half ? RST_2 : RST_1);
+      }
+    }
+  }
+
+  double scalar_seconds = benchmark_wall_seconds() - start_time;
+  uint32_t differences = 0;
+
+  for (uint32_t i = 0; i < count; i++) {
+    lockstep_load_cpu(lockstep, i);
+    cpu_state *lane = &lockstep->cpus[i];
+    cpu_state *state = &states[i];
+
+    differences += lane->psw != state->psw || lane->bc != state->bc || lane->de != state->de ||
+                   lane->hl != state->hl || lane->sp != state->sp || lane->pc != state->pc ||
+                   lane->cycles != state->cycles || memcmp(lane->memory->data, state->memory->data, 0x10000) != 0;
+  }
+
+  double instructions = (double) lockstep->instructions;
+  printf("%u lanes, %u frames%s | lockstep %.1f MIPS, %.0f%% of instructions vectorized | scalar %.1f MIPS | %u lanes differ\n",
+         count, frames, divergent ? ", divergent input" : "", instructions / lockstep_seconds / 1e6,
+         100.0 * lockstep->vector_instructions / instructions, instructions / scalar_seconds / 1e6, differences);
+
+  printf("%.0f%% of steps on one ROM instruction | %.0f%% of instructions lane by lane, %.0f%% on lanes run apart\n",
+         100.0 * lockstep->uniform_steps / lockstep->steps, 100.0 * lockstep->lane_instructions / instructions,
+         100.0 * lockstep->apart_instructions / instructions);
+  for (uint32_t i = 0; i < count; i++) {
+    cpu_destroy(&states[i]);
+  }
+
+  lockstep_destroy(lockstep);
+  free(states);
+  free(machines);
+  free(lockstep_machines);
+  return differences != 0;
+}
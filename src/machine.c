@@ -1,71 +1,100 @@
-#include "machine.h"
-
-uint8_t shift_offset;
-uint8_t shift0;
-uint8_t shift1;
-
-uint8_t keys[10];
-
-void machine_in(uint8_t port, uint8_t *value) {
-  switch (port) {
-    case 0:
-      *value = 0;
-      *value += 1 << 0;
-      *value += 1 << 1;
-      *value += 1 << 2;
-      *value += 1 << 4;
-      break;
-
-    case 1:
-      *value = 0;
-      *value += keys[KEY_COIN] << 0;
-      *value += keys[KEY_P2_START] << 1;
-      *value += keys[KEY_P1_START] << 2;
-      *value += 1 << 3;
-      *value += keys[KEY_P1_FIRE] << 4;
-      *value += keys[KEY_P1_LEFT] << 5;
-      *value += keys[KEY_P1_RIGHT] << 6;
-      break;
-
-    case 2:
-      *value = 0;
-      *value += keys[KEY_P2_FIRE] << 4;
-      *value += keys[KEY_P2_LEFT] << 5;
-      *value += keys[KEY_P2_RIGHT] << 6;
-      break;
-
-    case 3:
-      uint16_t v = (shift1 << 8) | shift0;
-      *value = ((v >> (8 - shift_offset)) & 0xff);
-      break;
-
-    default:
-      break;
-  }
-}
-
-void machine_out(uint8_t port, uint8_t value) {
-  switch (port) {
-    case 2:
-      shift_offset = value & 0x7;
-      break;
-
-    case 4:
-      shift0 = shift1;
-      shift1 = value;
-      break;
-
-    default:
-      break;
-  }
-}
-
-void machine_set_key(uint8_t key, uint8_t value) {
-  keys[key] = value;
-}
-
-void machine_init() {
-  for (int i = 0; i < 10; i++) {
-    keys[i] = 0;
-  }
-}
+#include "machine.h"
+
+void machine_in(machine_state *machine, uint8_t port, uint8_t *value) {
+  switch (port) {
+    case 0:
+      *value = 0;
+      *value += 1 << 0;
+      *value += 1 << 1;
+      *value += 1 << 2;
+      *value += 1 << 4;
+      break;
+
+    case 1:
+      *value = 0;
+      *value += machine->keys[KEY_COIN] << 0;
+      *value += machine->keys[KEY_P2_START] << 1;
+      *value += machine->keys[KEY_P1_START] << 2;
+      *value += 1 << 3;
+      *value += machine->keys[KEY_P1_FIRE] << 4;
+      *value += machine->keys[KEY_P1_LEFT] << 5;
+      *value += machine->keys[KEY_P1_RIGHT] << 6;
+      break;
+
+    case 2:
+      *value = 0;
+      *value += machine->keys[KEY_P2_FIRE] << 4;
+      *value += machine->keys[KEY_P2_LEFT] << 5;
+      *value += machine->keys[KEY_P2_RIGHT] << 6;
+      break;
+
+    case 3:
+      uint16_t v = (machine->shift1 << 8) | machine->shift0;
+      *value = ((v >> (8 - machine->shift_offset)) & 0xff);
+      break;
+
+    default:
+      break;
+  }
+
+  if (port < MACHINE_INPUT_PORTS && machine->input_hook) {
+    machine->input_hook(machine->input_context, port, value);
+  }
+}
+
+void machine_out(machine_state *machine, uint8_t port, uint8_t value) {
+  switch (port) {
+    case 2:
+      machine->shift_offset = value & 0x7;
+      break;
+
+    case 4:
+      machine->shift0 = machine->shift1;
+      machine->shift1 = value;
+      break;
+
+    default:
+      break;
+  }
+}
+
+void machine_set_key(machine_state *machine, uint8_t key, uint8_t value) {
+  machine->keys[key] = value;
+}
+
+void machine_init(machine_state *machine) {
+  machine->shift_offset = 0;
+  machine->shift0 = 0;
+  machine->shift1 = 0;
+
+  for (int i = 0; i < 10; i++) {
+    machine->keys[i] = 0;
+  }
+
+  machine->running = 1;
+  machine->input_hook = NULL;
+  machine->input_context = NULL;
+  scheduler_init(&machine->scheduler);
+}
+
+// Images shorter than the ROM leave the rest zero
+uint32_t machine_load_rom(memory_arena *arena, const uint8_t *data, uint32_t size) {
+  uint8_t rom[MACHINE_ROM_SIZE] = {0};
+
+  for (uint32_t address = 0; address < 0x2000; address++) {
+    rom[address] = address < size ? data[address] : 0;
+    rom[0x2000 + address] = 0x4000 + address < size ? data[0x4000 + address] : 0;
+  }
+
+  return memory_arena_load(arena, rom, sizeof(rom));
+}
+
+// ROM below 0x2000 and at 0x4000, RAM at 0x2000 and its mirror at 0x6000, the upper half mirrors the lower one. The
+// ROM is shared by every map of the arena, only the 8 KiB of RAM is the instance's own
+void machine_map_memory(memory_map *memory, uint32_t rom) {
+  memory_map_shared(memory, 0x0000, 0x2000, rom);
+  memory_map_ram(memory, 0x2000, 0x2000);
+  memory_map_shared(memory, 0x4000, 0x2000, rom + (0x2000 >> MEMORY_PAGE_SHIFT));
+  memory_mirror(memory, 0x6000, 0x2000, 0x2000, 0x2000);
+  memory_mirror(memory, 0x8000, 0x8000, 0x0000, 0x8000);
+}
@@ -1,20 +1,65 @@
-#pragma once
-
-#include <stdint.h>
-
-enum Keys {
-  KEY_COIN = 0x0,
-  KEY_P1_LEFT = 0x1,
-  KEY_P1_RIGHT = 0x2,
-  KEY_P1_FIRE = 0x3,
-  KEY_P1_START = 0x4,
-  KEY_P2_LEFT = 0x5,
-  KEY_P2_RIGHT = 0x6,
-  KEY_P2_FIRE = 0x7,
-  KEY_P2_START = 0x8,
-};
-
-void machine_init();
-void machine_out(uint8_t port, uint8_t value);
-void machine_in(uint8_t port, uint8_t *value);
-void machine_set_key(uint8_t key, uint8_t value);
\ No newline at end of file
+#pragma once
+
+#include <stdint.h>
+
+#include "memory.h"
+#include "scheduler.h"
+
+enum Keys {
+  KEY_COIN = 0x0,
+  KEY_P1_LEFT = 0x1,
+  KEY_P1_RIGHT = 0x2,
+  KEY_P1_FIRE = 0x3,
+  KEY_P1_START = 0x4,
+  KEY_P2_LEFT = 0x5,
+  KEY_P2_RIGHT = 0x6,
+  KEY_P2_FIRE = 0x7,
+  KEY_P2_START = 0x8,
+};
+
+// Video timing of the board: the CPU runs at 1.9968 MHz, 128 cycles per scanline and 262 scanlines per frame.
+// RST 1 comes when the beam is in the middle of the screen and RST 2 when it enters vblank
+#define MACHINE_CPU_HZ 1996800
+#define MACHINE_SCANLINE_CYCLES 128
+#define MACHINE_SCANLINES 262
+#define MACHINE_FRAME_CYCLES (MACHINE_SCANLINE_CYCLES * MACHINE_SCANLINES)
+#define MACHINE_MIDSCREEN_SCANLINE 96
+#define MACHINE_VBLANK_SCANLINE 224
+// 1 bit per pixel, 32 bytes for each of the 224 lines of the rotated monitor
+#define MACHINE_VIDEO_ADDRESS 0x2400
+#define MACHINE_VIDEO_SIZE 0x1C00
+
+// Ports below this read the cabinet inputs, the others read devices whose state is part of the machine
+#define MACHINE_INPUT_PORTS 3
+
+// Sees every value IN reads from an input port and may replace it
+typedef void (*machine_input_hook)(void *context, uint8_t port, uint8_t *value);
+
+// Devices of one Space Invaders board, every instance of the emulator owns its own
+typedef struct {
+  uint8_t shift_offset;
+  uint8_t shift0;
+  uint8_t shift1;
+
+  uint8_t keys[10];
+
+  // Cleared by the host to stop the emulation
+  uint8_t running;
+
+  machine_input_hook input_hook;
+  void *input_context;
+
+  // Screen interrupts and whatever devices schedule, fired by cpu_start_emulation
+  scheduler_state scheduler;
+} machine_state;
+
+void machine_init(machine_state *machine);
+void machine_out(machine_state *machine, uint8_t port, uint8_t value);
+void machine_in(machine_state *machine, uint8_t port, uint8_t *value);
+void machine_set_key(machine_state *machine, uint8_t key, uint8_t value);
+#define MACHINE_ROM_SIZE 0x4000
+
+// Loads the 16 KiB of ROM of a full address space image into the arena once, returns the first page for
+// machine_map_memory
+uint32_t machine_load_rom(memory_arena *arena, const uint8_t *data, uint32_t size);
+void machine_map_memory(memory_map *memory, uint32_t rom);
\ No newline at end of file
@@ -0,0 +1,425 @@
+#define _GNU_SOURCE
+#include "memory.h"
+
+#include <stdio.h>
+#if !MEMORY_PORTABLE
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// Writes to ROM land here and are never read back
+static uint8_t memory_sink[0x10000];
+
+static uint32_t memory_find_owner(const memory_map *memory, uint32_t home, uint32_t skip);
+
+#if MEMORY_PORTABLE
+void memory_arena_init(memory_arena *arena) {
+  memset(arena, 0, sizeof(memory_arena));
+}
+
+void memory_arena_destroy(memory_arena *arena) {
+  free(arena->pages);
+  free(arena->free_pages);
+  arena->pages = NULL;
+  arena->free_pages = NULL;
+}
+
+// The arena holds what loaded pages and handed out pages read as, the maps keep their own bytes
+static uint32_t memory_arena_grow(memory_arena *arena, uint32_t pages) {
+  uint32_t first = arena->size;
+  arena->size += pages;
+  arena->used += pages;
+  arena->pages = realloc(arena->pages, (size_t) arena->size << MEMORY_PAGE_SHIFT);
+
+  if (!arena->pages) {
+    printf("MEMORY ARENA COULD NOT GROW\n");
+    exit(1);
+  }
+
+  memset(arena->pages + ((size_t) first << MEMORY_PAGE_SHIFT), 0, (size_t) pages << MEMORY_PAGE_SHIFT);
+  return first;
+}
+
+static void memory_arena_clear(memory_arena *arena, uint32_t page) {
+  memset(arena->pages + ((size_t) page << MEMORY_PAGE_SHIFT), 0, MEMORY_PAGE_SIZE);
+}
+
+uint32_t memory_arena_load(memory_arena *arena, const uint8_t *data, uint32_t size) {
+  uint32_t first = memory_arena_grow(arena, (size + MEMORY_PAGE_MASK) >> MEMORY_PAGE_SHIFT);
+  memcpy(arena->pages + ((size_t) first << MEMORY_PAGE_SHIFT), data, size);
+  return first;
+}
+
+// The page takes the bytes of another owned page showing the same arena page, or of the arena page itself
+static void memory_remap(memory_map *memory, uint32_t page) {
+  uint32_t owner = memory->owned >> page & 1 ? memory_find_owner(memory, memory->homes[page], page) : MEMORY_PAGES;
+  const uint8_t *bytes = memory->arena->pages + ((size_t) memory->homes[page] << MEMORY_PAGE_SHIFT);
+
+  if (owner != MEMORY_PAGES) {
+    bytes = memory->data + (owner << MEMORY_PAGE_SHIFT);
+  }
+
+  memcpy(memory->data + (page << MEMORY_PAGE_SHIFT), bytes, MEMORY_PAGE_SIZE);
+}
+
+static uint8_t *memory_create_view(void) {
+  return malloc(0x10000);
+}
+
+static void memory_destroy_view(uint8_t *data) {
+  free(data);
+}
+
+void memory_update_mirrors(memory_map *memory, uint32_t page) {
+  for (uint32_t alias = memory->aliases[page]; alias != page; alias = memory->aliases[alias]) {
+    memcpy(memory->data + (alias << MEMORY_PAGE_SHIFT), memory->data + (page << MEMORY_PAGE_SHIFT),
+           MEMORY_PAGE_SIZE);
+  }
+}
+#else
+static int memory_create_store(void) {
+#ifdef __linux__
+  return memfd_create("memory", 0);
+#else
+  char name[64];
+  snprintf(name, sizeof(name), "/memory-%d-%p", getpid(), (void *)&name);
+  int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+  shm_unlink(name);
+  return fd;
+#endif
+}
+
+void memory_arena_init(memory_arena *arena) {
+  memset(arena, 0, sizeof(memory_arena));
+  arena->fd = memory_create_store();
+
+  if (arena->fd < 0) {
+    printf("MEMORY ARENA COULD NOT BE CREATED\n");
+    exit(1);
+  }
+}
+
+void memory_arena_destroy(memory_arena *arena) {
+  close(arena->fd);
+  free(arena->free_pages);
+  arena->free_pages = NULL;
+}
+
+// Pages nobody has touched cost nothing, so the object only ever grows
+static uint32_t memory_arena_grow(memory_arena *arena, uint32_t pages) {
+  uint32_t first = arena->size;
+  arena->size += pages;
+  arena->used += pages;
+
+  if (ftruncate(arena->fd, (off_t) arena->size << MEMORY_PAGE_SHIFT) != 0) {
+    printf("MEMORY ARENA COULD NOT GROW\n");
+    exit(1);
+  }
+
+  return first;
+}
+
+// Returned pages give their memory back
+static void memory_arena_clear(memory_arena *arena, uint32_t page) {
+#ifdef __linux__
+  fallocate(arena->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, (off_t) page << MEMORY_PAGE_SHIFT,
+            MEMORY_PAGE_SIZE);
+#else
+  static const uint8_t zero[MEMORY_PAGE_SIZE];
+  pwrite(arena->fd, zero, MEMORY_PAGE_SIZE, (off_t) page << MEMORY_PAGE_SHIFT);
+#endif
+}
+
+uint32_t memory_arena_load(memory_arena *arena, const uint8_t *data, uint32_t size) {
+  uint32_t first = memory_arena_grow(arena, (size + MEMORY_PAGE_MASK) >> MEMORY_PAGE_SHIFT);
+
+  if (pwrite(arena->fd, data, size, (off_t) first << MEMORY_PAGE_SHIFT) != (ssize_t) size) {
+    printf("MEMORY ARENA COULD NOT BE LOADED\n");
+    exit(1);
+  }
+
+  return first;
+}
+
+// Pages shared with other maps are read-only in the view, the tables alone decide what the guest may write
+static void memory_remap(memory_map *memory, uint32_t page) {
+  int protection = memory->owned >> page & 1 ? PROT_READ | PROT_WRITE : PROT_READ;
+  void *view = mmap(memory->data + (page << MEMORY_PAGE_SHIFT), MEMORY_PAGE_SIZE, protection, MAP_SHARED | MAP_FIXED,
+                    memory->arena->fd, (off_t) memory->homes[page] << MEMORY_PAGE_SHIFT);
+
+  if (view == MAP_FAILED) {
+    printf("MEMORY PAGE %02x COULD NOT BE MAPPED\n", page);
+    exit(1);
+  }
+}
+
+static uint8_t *memory_create_view(void) {
+  uint8_t *data = mmap(NULL, 0x10000, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  return data == MAP_FAILED ? NULL : data;
+}
+
+static void memory_destroy_view(uint8_t *data) {
+  munmap(data, 0x10000);
+}
+
+void memory_update_mirrors(memory_map *memory, uint32_t page) {
+}
+#endif
+
+static uint32_t memory_arena_alloc(memory_arena *arena) {
+  if (arena->free_count) {
+    arena->used++;
+    return arena->free_pages[--arena->free_count];
+  }
+
+  return memory_arena_grow(arena, 1);
+}
+
+// Returned pages read as zero when they are handed out again
+static void memory_arena_free(memory_arena *arena, uint32_t page) {
+  memory_arena_clear(arena, page);
+  arena->free_pages = realloc(arena->free_pages, (arena->free_count + 1) * sizeof(uint32_t));
+  arena->free_pages[arena->free_count++] = page;
+  arena->used--;
+}
+
+// Lowest owned page other than skip showing home, MEMORY_PAGES when there is none
+static uint32_t memory_find_owner(const memory_map *memory, uint32_t home, uint32_t skip) {
+  for (uint32_t page = 0; page < MEMORY_PAGES; page++) {
+    if (page != skip && memory->owned >> page & 1 && memory->homes[page] == home) {
+      return page;
+    }
+  }
+
+  return MEMORY_PAGES;
+}
+
+// The arena page shown before goes back to the arena once no page of the map shows it
+static void memory_set_home(memory_map *memory, uint32_t page, uint32_t home, uint8_t owned) {
+  uint32_t previous = memory->homes[page];
+  uint8_t was_owned = memory->owned >> page & 1;
+
+  memory->homes[page] = home;
+  memory->owned = (memory->owned & ~(1u << page)) | (uint32_t) owned << page;
+  memory_remap(memory, page);
+
+  if (was_owned && memory_find_owner(memory, previous, MEMORY_PAGES) == MEMORY_PAGES) {
+    memory_arena_free(memory->arena, previous);
+  }
+}
+
+// Derives the masks and aliases from the tables. Pages are aliases when they show the same arena page, so a write
+// through one is seen by the others
+static void memory_update_pages(memory_map *memory) {
+  memory->slow_reads = 0;
+  memory->slow_writes = 0;
+  memory->private_pages = 0;
+
+  for (uint32_t page = 0; page < MEMORY_PAGES; page++) {
+    memory->aliases[page] = page;
+
+    for (uint32_t i = 1; i < MEMORY_PAGES; i++) {
+      uint32_t other = (page + i) % MEMORY_PAGES;
+
+      if (memory->homes[other] == memory->homes[page]) {
+        memory->aliases[page] = other;
+        break;
+      }
+    }
+
+    uint8_t copied = MEMORY_PORTABLE && memory->aliases[page] != page;
+    memory->slow_reads |= (uint32_t) (memory->read[page] != memory->data) << page;
+    memory->slow_writes |= (uint32_t) (memory->write[page] != memory->data || copied) << page;
+    memory->private_pages |= (uint32_t) (memory_find_owner(memory, memory->homes[page], MEMORY_PAGES) == page)
+                             << page;
+  }
+}
+
+// Gives every page of the range an owned arena page no other page shows
+static void memory_set_pages(memory_map *memory, uint32_t start, uint32_t size, uint8_t *read, uint8_t *write) {
+  for (uint32_t offset = 0; offset < size; offset += MEMORY_PAGE_SIZE) {
+    uint32_t page = (start + offset) >> MEMORY_PAGE_SHIFT;
+    memory->read[page] = read;
+    memory->write[page] = write;
+    memory->read_handlers[page] = NULL;
+    memory->write_handlers[page] = NULL;
+    memory->contexts[page] = NULL;
+
+    if (!(memory->owned >> page & 1) || memory_find_owner(memory, memory->homes[page], page) != MEMORY_PAGES) {
+      memory_set_home(memory, page, memory_arena_alloc(memory->arena), 1);
+    }
+  }
+
+  memory_update_pages(memory);
+}
+
+void memory_init(memory_map *memory, memory_arena *arena) {
+  memset(memory, 0, sizeof(memory_map));
+  memory->arena = arena;
+
+  if (!arena) {
+    memory->arena = malloc(sizeof(memory_arena));
+    memory_arena_init(memory->arena);
+    memory->private_arena = 1;
+  }
+
+  memory->data = memory_create_view();
+
+  if (!memory->data) {
+    printf("MEMORY COULD NOT BE ALLOCATED\n");
+    exit(1);
+  }
+
+  memory_map_ram(memory, 0x0000, 0x10000);
+}
+
+void memory_destroy(memory_map *memory) {
+  for (uint32_t page = 0; page < MEMORY_PAGES; page++) {
+    if (memory->private_pages >> page & 1) {
+      memory_arena_free(memory->arena, memory->homes[page]);
+    }
+  }
+
+  memory_destroy_view(memory->data);
+  memory->data = NULL;
+
+  if (memory->private_arena) {
+    memory_arena_destroy(memory->arena);
+    free(memory->arena);
+  }
+}
+
+// Pages are only remapped where the layouts differ, so copying between maps of the same layout is a plain copy
+void memory_copy(memory_map *memory, const memory_map *source) {
+  for (uint32_t page = 0; page < MEMORY_PAGES; page++) {
+    uint32_t home = source->homes[page];
+
+    if (!(source->owned >> page & 1)) {
+      if (memory->homes[page] != home || memory->owned >> page & 1) {
+        memory_set_home(memory, page, home, 0);
+      }
+
+      continue;
+    }
+
+    uint32_t owner = memory_find_owner(source, home, MEMORY_PAGES);
+
+    if (owner != page) {
+      if (memory->homes[page] != memory->homes[owner] || !(memory->owned >> page & 1)) {
+        memory_set_home(memory, page, memory->homes[owner], 1);
+      }
+    } else if (!(memory->owned >> page & 1) || memory_find_owner(memory, memory->homes[page], page) < page) {
+      memory_set_home(memory, page, memory_arena_alloc(memory->arena), 1);
+    }
+  }
+
+  for (uint32_t page = 0; page < MEMORY_PAGES; page++) {
+    memory->read[page] = source->read[page] == source->data ? memory->data : source->read[page];
+    memory->write[page] = source->write[page] == source->data ? memory->data : source->write[page];
+    memory->read_handlers[page] = source->read_handlers[page];
+    memory->write_handlers[page] = source->write_handlers[page];
+    memory->contexts[page] = source->contexts[page];
+  }
+
+  memory_update_pages(memory);
+
+  for (uint32_t page = 0; page < MEMORY_PAGES; page++) {
+    if (source->private_pages >> page & 1) {
+      memcpy(memory->data + (page << MEMORY_PAGE_SHIFT), source->data + (page << MEMORY_PAGE_SHIFT),
+             MEMORY_PAGE_SIZE);
+      memory_update_mirrors(memory, page);
+    }
+  }
+}
+
+void memory_map_ram(memory_map *memory, uint32_t start, uint32_t size) {
+  memory_set_pages(memory, start, size, memory->data, memory->data);
+}
+
+void memory_map_rom(memory_map *memory, uint32_t start, uint32_t size) {
+  memory_set_pages(memory, start, size, memory->data, memory_sink);
+}
+
+void memory_map_shared(memory_map *memory, uint32_t start, uint32_t size, uint32_t first) {
+  for (uint32_t offset = 0; offset < size; offset += MEMORY_PAGE_SIZE) {
+    uint32_t page = (start + offset) >> MEMORY_PAGE_SHIFT;
+    memory->read[page] = memory->data;
+    memory->write[page] = memory_sink;
+    memory->read_handlers[page] = NULL;
+    memory->write_handlers[page] = NULL;
+    memory->contexts[page] = NULL;
+    memory_set_home(memory, page, first + (offset >> MEMORY_PAGE_SHIFT), 0);
+  }
+
+  memory_update_pages(memory);
+}
+
+void memory_map_handlers(memory_map *memory, uint32_t start, uint32_t size, memory_read_handler read,
+                         memory_write_handler write, void *context) {
+  if (read && !MEMORY_READ_HANDLERS) {
+    printf("MEMORY READ HANDLERS NEED MEMORY_READ_HANDLERS\n");
+    exit(1);
+  }
+
+  memory_set_pages(memory, start, size, read ? NULL : memory->data, NULL);
+
+  for (uint32_t offset = 0; offset < size; offset += MEMORY_PAGE_SIZE) {
+    uint32_t page = (start + offset) >> MEMORY_PAGE_SHIFT;
+    memory->read_handlers[page] = read;
+    memory->write_handlers[page] = write;
+    memory->contexts[page] = context;
+  }
+}
+
+void memory_mirror(memory_map *memory, uint32_t start, uint32_t size, uint32_t source, uint32_t source_size) {
+  for (uint32_t offset = 0; offset < size; offset += MEMORY_PAGE_SIZE) {
+    uint32_t page = (start + offset) >> MEMORY_PAGE_SHIFT;
+    uint32_t source_page = (source + offset % source_size) >> MEMORY_PAGE_SHIFT;
+    uint8_t owned = memory->owned >> source_page & 1;
+
+    memory->read[page] = memory->read[source_page];
+    memory->write[page] = memory->write[source_page];
+    memory->read_handlers[page] = memory->read_handlers[source_page];
+    memory->write_handlers[page] = memory->write_handlers[source_page];
+    memory->contexts[page] = memory->contexts[source_page];
+
+    if (memory->homes[page] != memory->homes[source_page] || (memory->owned >> page & 1) != owned) {
+      memory_set_home(memory, page, memory->homes[source_page], owned);
+    }
+  }
+
+  memory_update_pages(memory);
+}
+
+// Handlers get the full guest address
+uint8_t memory_read_slow(memory_map *memory, uint16_t address) {
+  uint8_t page = address >> MEMORY_PAGE_SHIFT;
+  return memory->read_handlers[page](memory->contexts[page], address);
+}
+
+uint16_t memory_read_word_slow(memory_map *memory, uint16_t address) {
+  return memory_read(memory, address) | memory_read(memory, address + 1) << 8;
+}
+
+// Writes to ROM are dropped
+void memory_write_slow(memory_map *memory, uint16_t address, uint8_t value) {
+  uint8_t page = address >> MEMORY_PAGE_SHIFT;
+
+  if (memory->write_handlers[page]) {
+    memory->write_handlers[page](memory->contexts[page], address, value);
+    return;
+  }
+
+#if MEMORY_PORTABLE
+  // Mirrored RAM, every copy gets the byte
+  if (memory->write[page] == memory->data) {
+    uint16_t alias = address;
+
+    do {
+      memory->data[alias] = value;
+      alias = memory_next_alias(memory->aliases, alias);
+    } while (alias != address);
+  }
+#endif
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The 64 KiB address space in 4 KiB pages, the smallest unit the host can remap
+#define MEMORY_PAGE_SHIFT 12
+#define MEMORY_PAGE_SIZE (1 << MEMORY_PAGE_SHIFT)
+#define MEMORY_PAGE_MASK (MEMORY_PAGE_SIZE - 1)
+#define MEMORY_PAGES (0x10000 >> MEMORY_PAGE_SHIFT)
+
+// A read handler costs the CPU a check on every memory operand, the 8080 keeps its devices on ports so only write
+// handlers are there by default
+#ifndef MEMORY_READ_HANDLERS
+#define MEMORY_READ_HANDLERS 0
+#endif
+
+// Without POSIX shared memory the view is one plain allocation: mirrors hold copies of their pages, which writes
+// to them keep in step through the slow path, and loaded pages are copied into every map that shows them
+#ifndef MEMORY_PORTABLE
+#ifdef _WIN32
+#define MEMORY_PORTABLE 1
+#else
+#define MEMORY_PORTABLE 0
+#endif
+#endif
+
+typedef uint8_t (*memory_read_handler)(void *context, uint16_t address);
+typedef void (*memory_write_handler)(void *context, uint16_t address, uint8_t value);
+
+// Host memory that maps show. Pages loaded once can be shown by every map of the arena, so instances of one ROM
+// share it, and a pool of instances takes its RAM from a single shared memory object. Not thread safe, maps are
+// set up from one thread
+typedef struct {
+#if MEMORY_PORTABLE
+  uint8_t *pages;
+#else
+  int fd;
+#endif
+  // Pages of the shared memory object, returned ones are handed out again first
+  uint32_t size;
+  uint32_t *free_pages;
+  uint32_t free_count;
+  // Pages handed out and not returned, loaded ones included
+  uint32_t used;
+} memory_arena;
+
+typedef struct {
+  // Host memory indexed with the whole guest address. Pages without it go through the handlers, writes to ROM
+  // pages land in a sink that is never read
+  uint8_t *read[MEMORY_PAGES];
+  uint8_t *write[MEMORY_PAGES];
+
+  memory_read_handler read_handlers[MEMORY_PAGES];
+  memory_write_handler write_handlers[MEMORY_PAGES];
+  void *contexts[MEMORY_PAGES];
+
+  memory_arena *arena;
+  // Arena page shown at each page, mirrors show the one of their source
+  uint32_t homes[MEMORY_PAGES];
+  // Next page showing the same arena page, a page that is not mirrored is its own alias
+  uint8_t aliases[MEMORY_PAGES];
+
+  // The address space as the guest sees it, mirrors are mapped over the same arena pages so code can be fetched
+  // from it without a lookup. Handler pages show their own arena page here
+  uint8_t *data;
+
+  // One bit per page whose reads or writes cannot go straight to data, lets the CPU skip the tables. Without
+  // shared memory writes to mirrored pages take the slow path too
+  uint32_t slow_reads;
+  uint32_t slow_writes;
+  // One bit per page showing an arena page this map allocated, the others are loaded pages shared with other maps
+  uint32_t owned;
+  // Owned pages no lower page shows, what a load or a snapshot of the map covers
+  uint32_t private_pages;
+  // Set when the arena was made for this map alone
+  uint8_t private_arena;
+} memory_map;
+
+void memory_arena_init(memory_arena *arena);
+void memory_arena_destroy(memory_arena *arena);
+// Copies size bytes into new pages that every map of the arena can show read-only, returns the first of them
+uint32_t memory_arena_load(memory_arena *arena, const uint8_t *data, uint32_t size);
+
+// Plain RAM everywhere, from pages of the arena or of an arena of its own when it is NULL
+void memory_init(memory_map *memory, memory_arena *arena);
+void memory_destroy(memory_map *memory);
+// Same map and contents as the source over other pages of the same arena, loaded pages stay shared
+void memory_copy(memory_map *memory, const memory_map *source);
+
+// Ranges are whole pages. Pages that already were this map's own keep their contents, a handler page without a
+// read handler reads its own page
+void memory_map_ram(memory_map *memory, uint32_t start, uint32_t size);
+void memory_map_rom(memory_map *memory, uint32_t start, uint32_t size);
+// ROM from the arena pages starting at first, as returned by memory_arena_load
+void memory_map_shared(memory_map *memory, uint32_t start, uint32_t size, uint32_t first);
+void memory_map_handlers(memory_map *memory, uint32_t start, uint32_t size, memory_read_handler read,
+                         memory_write_handler write, void *context);
+// Repeats the pages of source_size bytes at source over the range
+void memory_mirror(memory_map *memory, uint32_t start, uint32_t size, uint32_t source, uint32_t source_size);
+
+// Copies a page written past the tables to the pages mirroring it, nothing to do when mirrors share memory
+void memory_update_mirrors(memory_map *memory, uint32_t page);
+
+__attribute__((cold)) uint8_t memory_read_slow(memory_map *memory, uint16_t address);
+__attribute__((cold)) uint16_t memory_read_word_slow(memory_map *memory, uint16_t address);
+__attribute__((cold)) void memory_write_slow(memory_map *memory, uint16_t address, uint8_t value);
+
+static inline uint8_t memory_read(memory_map *memory, uint16_t address) {
+  uint8_t *page = memory->read[address >> MEMORY_PAGE_SHIFT];
+
+  if (page) {
+    return page[address];
+  }
+
+  return memory_read_slow(memory, address);
+}
+
+// Little endian, the fast path only takes words inside one page
+static inline uint16_t memory_read_word(memory_map *memory, uint16_t address) {
+  uint8_t *page = memory->read[address >> MEMORY_PAGE_SHIFT];
+
+  if (page && (address & MEMORY_PAGE_MASK) != MEMORY_PAGE_MASK) {
+    return page[address] | page[address + 1] << 8;
+  }
+
+  return memory_read_word_slow(memory, address);
+}
+
+static inline void memory_write(memory_map *memory, uint16_t address, uint8_t value) {
+  uint8_t *page = memory->write[address >> MEMORY_PAGE_SHIFT];
+
+  if (page) {
+    page[address] = value;
+    return;
+  }
+
+  memory_write_slow(memory, address, value);
+}
+
+// The same byte in the next page that mirrors this one, the address itself once the pages run out
+static inline uint16_t memory_next_alias(const uint8_t *aliases, uint16_t address) {
+  return (aliases[address >> MEMORY_PAGE_SHIFT] << MEMORY_PAGE_SHIFT) | (address & MEMORY_PAGE_MASK);
+}
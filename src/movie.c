@@ -0,0 +1,557 @@
+#include "movie.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Index entries and the trailer after them: end of the log, entry count and MOVIE_INDEX_MAGIC
+#define MOVIE_INDEX_ENTRY_SIZE 16
+#define MOVIE_TRAILER_SIZE 16
+
+typedef struct {
+  uint8_t type;
+  uint64_t value;
+  uint8_t index;
+  uint8_t data;
+  const uint8_t *payload;
+  uint32_t payload_size;
+} movie_event;
+
+static void movie_write(movie_state *movie, const void *bytes, uint32_t size) {
+  if (fwrite(bytes, 1, size, movie->file) != size) {
+    printf("MOVIE COULD NOT BE WRITTEN\n");
+    exit(1);
+  }
+
+  movie->size += size;
+}
+
+static void movie_write_byte(movie_state *movie, uint8_t byte) {
+  movie_write(movie, &byte, 1);
+}
+
+// Seven bits at a time, lowest first
+static void movie_write_varint(movie_state *movie, uint64_t value) {
+  uint8_t bytes[10];
+  uint32_t count = 0;
+
+  do {
+    bytes[count++] = (value & 0x7F) | (value >= 0x80 ? 0x80 : 0);
+    value >>= 7;
+  } while (value);
+
+  movie_write(movie, bytes, count);
+}
+
+static uint8_t movie_read_varint(const movie_state *movie, uint64_t *cursor, uint64_t *value) {
+  *value = 0;
+
+  for (uint32_t shift = 0; shift < 64; shift += 7) {
+    if (*cursor >= movie->log_end) {
+      return 0;
+    }
+
+    uint8_t byte = movie->data[(*cursor)++];
+    *value |= (uint64_t) (byte & 0x7F) << shift;
+
+    if (!(byte & 0x80)) {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+static uint8_t movie_read_bytes(const movie_state *movie, uint64_t *cursor, uint32_t count, const uint8_t **bytes) {
+  if (movie->log_end - *cursor < count) {
+    return 0;
+  }
+
+  *bytes = movie->data + *cursor;
+  *cursor += count;
+  return 1;
+}
+
+// 0 at the end of the log and for a truncated event
+static uint8_t movie_read_event(const movie_state *movie, uint64_t *cursor, movie_event *event) {
+  const uint8_t *bytes;
+  uint64_t size;
+
+  if (!movie_read_bytes(movie, cursor, 1, &bytes)) {
+    return 0;
+  }
+
+  event->type = bytes[0];
+
+  switch (event->type) {
+    case MOVIE_EVENT_KEY:
+      if (!movie_read_bytes(movie, cursor, 2, &bytes)) {
+        return 0;
+      }
+
+      event->index = bytes[0];
+      event->data = bytes[1];
+      return event->index < sizeof(movie->keys);
+
+    case MOVIE_EVENT_IN:
+      if (!movie_read_varint(movie, cursor, &event->value) || !movie_read_bytes(movie, cursor, 2, &bytes)) {
+        return 0;
+      }
+
+      event->index = bytes[0];
+      event->data = bytes[1];
+      return event->index < MACHINE_INPUT_PORTS;
+
+    case MOVIE_EVENT_INTERRUPT:
+      if (!movie_read_varint(movie, cursor, &event->value) || !movie_read_bytes(movie, cursor, 1, &bytes)) {
+        return 0;
+      }
+
+      event->data = bytes[0];
+      return 1;
+
+    case MOVIE_EVENT_KEYFRAME:
+      if (!movie_read_varint(movie, cursor, &event->value) || !movie_read_varint(movie, cursor, &size) ||
+          size > UINT32_MAX || !movie_read_bytes(movie, cursor, size, &event->payload)) {
+        return 0;
+      }
+
+      event->payload_size = size;
+      return 1;
+
+    default:
+      return 0;
+  }
+}
+
+static void movie_add_keyframe(movie_state *movie, uint64_t frame, uint64_t offset) {
+  if (movie->keyframe_count == movie->keyframe_capacity) {
+    movie->keyframe_capacity = movie->keyframe_capacity ? 2 * movie->keyframe_capacity : 64;
+    movie->keyframes = realloc(movie->keyframes, movie->keyframe_capacity * sizeof(movie_keyframe));
+  }
+
+  movie->keyframes[movie->keyframe_count].frame = frame;
+  movie->keyframes[movie->keyframe_count].offset = offset;
+  movie->keyframe_count++;
+}
+
+// Reads and cycles count again from here, and every input port is written again the first time it is read
+static void movie_start_keyframe(movie_state *movie) {
+  movie->reads = 0;
+  movie->last_read = 0;
+  movie->known_ports = 0;
+  movie->cycle_base = movie->state->cycles;
+}
+
+static void movie_write_keyframe(movie_state *movie) {
+  uint32_t size = savestate_save(movie->state, movie->scratch, movie->state_size);
+  uint32_t packed_size = savestate_compress(movie->scratch, size, movie->packed, 2 * movie->state_size);
+
+  movie_add_keyframe(movie, movie->frame, movie->size);
+  movie_write_byte(movie, MOVIE_EVENT_KEYFRAME);
+  movie_write_varint(movie, movie->frame);
+  movie_write_varint(movie, packed_size);
+  movie_write(movie, movie->packed, packed_size);
+  movie_start_keyframe(movie);
+}
+
+static void movie_record_input(void *context, uint8_t port, uint8_t *value) {
+  movie_state *movie = context;
+  uint64_t read = movie->reads++;
+
+  if (movie->known_ports >> port & 1 && movie->ports[port] == *value) {
+    return;
+  }
+
+  movie_write_byte(movie, MOVIE_EVENT_IN);
+  movie_write_varint(movie, read - movie->last_read);
+  movie_write_byte(movie, port);
+  movie_write_byte(movie, *value);
+
+  movie->last_read = read;
+  movie->ports[port] = *value;
+  movie->known_ports |= 1 << port;
+}
+
+// Keys only matter to the savestates, they are written when they changed since the last interrupt
+static void movie_record_interrupt(void *context, cpu_state *state, uint8_t op_code, uint64_t cycle) {
+  movie_state *movie = context;
+
+  for (uint8_t key = 0; key < sizeof(movie->keys); key++) {
+    if (state->machine->keys[key] != movie->keys[key]) {
+      movie->keys[key] = state->machine->keys[key];
+      movie_write_byte(movie, MOVIE_EVENT_KEY);
+      movie_write_byte(movie, key);
+      movie_write_byte(movie, movie->keys[key]);
+    }
+  }
+
+  movie_write_byte(movie, MOVIE_EVENT_INTERRUPT);
+  movie_write_varint(movie, cycle - movie->cycle_base);
+  movie_write_byte(movie, op_code);
+  movie->cycle_base = cycle;
+
+  if (op_code == RST_2 && ++movie->frame % movie->keyframe_interval == 0) {
+    movie_write_keyframe(movie);
+  }
+}
+
+// The value of the read comes from the next IN event when it was written for this read, from the last one otherwise
+static void movie_play_input(void *context, uint8_t port, uint8_t *value) {
+  movie_state *movie = context;
+  uint64_t read = movie->reads++;
+  movie_event event;
+  uint64_t cursor = movie->input_cursor;
+
+  while (movie_read_event(movie, &cursor, &event) && event.type != MOVIE_EVENT_KEYFRAME) {
+    if (event.type != MOVIE_EVENT_IN) {
+      movie->input_cursor = cursor;
+      continue;
+    }
+
+    if (movie->last_read + event.value == read) {
+      movie->input_cursor = cursor;
+      movie->last_read = read;
+      movie->ports[event.index] = event.data;
+      movie->known_ports |= 1 << event.index;
+    }
+
+    break;
+  }
+
+  if (movie->known_ports >> port & 1) {
+    *value = movie->ports[port];
+  }
+}
+
+static movie_state *movie_create(cpu_state *state, uint8_t mode) {
+  movie_state *movie = calloc(1, sizeof(movie_state));
+  movie->mode = mode;
+  movie->state = state;
+  movie->state_size = savestate_size(state);
+  movie->scratch = malloc(movie->state_size);
+  movie->packed = malloc(2 * movie->state_size);
+  return movie;
+}
+
+movie_state *movie_record(const char *path, cpu_state *state, uint32_t keyframe_interval) {
+  FILE *file = fopen(path, "wb");
+
+  if (!file) {
+    printf("MOVIE COULD NOT BE CREATED: %s\n", path);
+    return NULL;
+  }
+
+  movie_state *movie = movie_create(state, MOVIE_RECORDING);
+  movie->file = file;
+  movie->keyframe_interval = keyframe_interval ? keyframe_interval : MOVIE_DEFAULT_INTERVAL;
+  memcpy(movie->keys, state->machine->keys, sizeof(movie->keys));
+
+  movie_header header = {MOVIE_MAGIC, MOVIE_VERSION, SAVESTATE_VERSION, movie->keyframe_interval};
+  movie_write(movie, &header, sizeof(header));
+  movie_write_keyframe(movie);
+
+  state->machine->input_hook = movie_record_input;
+  state->machine->input_context = movie;
+  cpu_set_interrupt_handler(state, movie_record_interrupt, movie);
+
+  return movie;
+}
+
+// Keyframes of a log whose index was never written, the log ends after the last whole event
+static void movie_scan(movie_state *movie) {
+  movie_event event;
+  uint64_t cursor = sizeof(movie_header);
+  uint64_t end = cursor;
+  movie->log_end = movie->size;
+
+  while (movie_read_event(movie, &cursor, &event)) {
+    if (event.type == MOVIE_EVENT_KEYFRAME) {
+      movie_add_keyframe(movie, event.value, end);
+    }
+
+    end = cursor;
+  }
+
+  movie->log_end = end;
+}
+
+static uint8_t movie_read_index(movie_state *movie) {
+  uint32_t magic;
+  uint32_t count;
+  uint64_t log_end;
+
+  if (movie->size < sizeof(movie_header) + MOVIE_TRAILER_SIZE) {
+    return 0;
+  }
+
+  const uint8_t *trailer = movie->data + movie->size - MOVIE_TRAILER_SIZE;
+  memcpy(&log_end, trailer, 8);
+  memcpy(&count, trailer + 8, 4);
+  memcpy(&magic, trailer + 12, 4);
+
+  if (magic != MOVIE_INDEX_MAGIC || log_end < sizeof(movie_header) ||
+      log_end + (uint64_t) count * MOVIE_INDEX_ENTRY_SIZE + MOVIE_TRAILER_SIZE != movie->size) {
+    return 0;
+  }
+
+  for (uint32_t i = 0; i < count; i++) {
+    movie_keyframe keyframe;
+    memcpy(&keyframe, movie->data + log_end + (uint64_t) i * MOVIE_INDEX_ENTRY_SIZE, sizeof(keyframe));
+    movie_add_keyframe(movie, keyframe.frame, keyframe.offset);
+  }
+
+  movie->log_end = log_end;
+  return 1;
+}
+
+static uint8_t movie_load_keyframe(movie_state *movie, uint32_t index) {
+  movie_event event;
+  uint64_t cursor = movie->keyframes[index].offset;
+
+  if (!movie_read_event(movie, &cursor, &event) || event.type != MOVIE_EVENT_KEYFRAME ||
+      !savestate_load(movie->state, event.payload, event.payload_size)) {
+    return 0;
+  }
+
+  movie->frame = event.value;
+  movie->cursor = cursor;
+  movie->input_cursor = cursor;
+  movie_start_keyframe(movie);
+  return 1;
+}
+
+#ifdef _WIN32
+// Without mmap playback reads the whole file into a buffer
+static uint8_t *movie_map_file(const char *path, uint64_t *size) {
+  FILE *file = fopen(path, "rb");
+
+  if (!file) {
+    return NULL;
+  }
+
+  fseek(file, 0, SEEK_END);
+  long length = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  uint8_t *data = length > 0 ? malloc(length) : NULL;
+
+  if (data && fread(data, 1, length, file) != (size_t) length) {
+    free(data);
+    data = NULL;
+  }
+
+  fclose(file);
+  *size = length;
+  return data;
+}
+
+static void movie_unmap_file(uint8_t *data, uint64_t size) {
+  free(data);
+}
+#else
+static uint8_t *movie_map_file(const char *path, uint64_t *size) {
+  int fd = open(path, O_RDONLY);
+
+  if (fd < 0) {
+    return NULL;
+  }
+
+  struct stat file_stat;
+  uint8_t *data = NULL;
+
+  if (fstat(fd, &file_stat) == 0 && file_stat.st_size > 0) {
+    *size = file_stat.st_size;
+    data = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    if (data == MAP_FAILED) {
+      data = NULL;
+    }
+  }
+
+  close(fd);
+  return data;
+}
+
+static void movie_unmap_file(uint8_t *data, uint64_t size) {
+  munmap(data, size);
+}
+#endif
+
+movie_state *movie_play(const char *path, cpu_state *state) {
+  uint64_t size;
+  uint8_t *data = movie_map_file(path, &size);
+
+  if (!data) {
+    printf("MOVIE COULD NOT BE LOADED: %s\n", path);
+    return NULL;
+  }
+
+  movie_header header;
+
+  if (size < sizeof(header)) {
+    movie_unmap_file(data, size);
+    return NULL;
+  }
+
+  movie_state *movie = movie_create(state, MOVIE_PLAYING);
+  movie->size = size;
+  movie->data = data;
+
+  memcpy(&header, movie->data, sizeof(header));
+  movie->keyframe_interval = header.keyframe_interval;
+
+  if (header.magic != MOVIE_MAGIC || header.version != MOVIE_VERSION ||
+      header.savestate_version != SAVESTATE_VERSION) {
+    movie_close(movie);
+    return NULL;
+  }
+
+  if (!movie_read_index(movie)) {
+    movie_scan(movie);
+  }
+
+  if (!movie->keyframe_count || !movie_load_keyframe(movie, movie->keyframe_count - 1)) {
+    movie_close(movie);
+    return NULL;
+  }
+
+  state->machine->input_hook = movie_play_input;
+  state->machine->input_context = movie;
+
+  // The frames after the last keyframe are only known by counting them
+  movie_event event;
+  uint64_t cursor = movie->cursor;
+  movie->frames = movie->frame;
+
+  while (movie_read_event(movie, &cursor, &event)) {
+    movie->frames += event.type == MOVIE_EVENT_INTERRUPT && event.data == RST_2;
+  }
+
+  if (!movie_seek(movie, 0)) {
+    movie_close(movie);
+    return NULL;
+  }
+
+  return movie;
+}
+
+void movie_close(movie_state *movie) {
+  if (movie->state->machine->input_context == movie) {
+    movie->state->machine->input_hook = NULL;
+    movie->state->machine->input_context = NULL;
+  }
+
+  if (movie->state->interrupt_context == movie) {
+    cpu_set_interrupt_handler(movie->state, NULL, NULL);
+  }
+
+  if (movie->file) {
+    uint64_t log_end = movie->size;
+
+    for (uint32_t i = 0; i < movie->keyframe_count; i++) {
+      movie_write(movie, &movie->keyframes[i], MOVIE_INDEX_ENTRY_SIZE);
+    }
+
+    uint32_t magic = MOVIE_INDEX_MAGIC;
+    movie_write(movie, &log_end, 8);
+    movie_write(movie, &movie->keyframe_count, 4);
+    movie_write(movie, &magic, 4);
+    fclose(movie->file);
+  }
+
+  if (movie->data) {
+    movie_unmap_file(movie->data, movie->size);
+  }
+
+  free(movie->keyframes);
+  free(movie->scratch);
+  free(movie->packed);
+  free(movie);
+}
+
+// Keyframes on the way are compared with the machine, a difference means the playback went its own way
+uint8_t movie_play_frame(movie_state *movie) {
+  cpu_state *state = movie->state;
+  movie_event event;
+
+  while (movie_read_event(movie, &movie->cursor, &event)) {
+    switch (event.type) {
+      case MOVIE_EVENT_KEY:
+        state->machine->keys[event.index] = event.data;
+        break;
+
+      case MOVIE_EVENT_KEYFRAME: {
+        uint32_t size = savestate_save(state, movie->scratch, movie->state_size);
+        uint32_t packed_size = savestate_compress(movie->scratch, size, movie->packed, 2 * movie->state_size);
+        movie->desyncs += packed_size != event.payload_size || memcmp(movie->packed, event.payload, packed_size);
+
+        movie->input_cursor = movie->cursor;
+        movie_start_keyframe(movie);
+        break;
+      }
+
+      case MOVIE_EVENT_INTERRUPT: {
+        uint64_t cycle = movie->cycle_base + event.value;
+
+        while (state->cycles < cycle) {
+          if (cpu_run(state, cycle) == CPU_STOP_UNIMPLEMENTED) {
+            return 0;
+          }
+        }
+
+        movie->cycle_base = cycle;
+        cpu_set_interrupt(state, event.data);
+        cpu_handle_interrupt(state);
+
+        if (event.data == RST_2) {
+          movie->frame++;
+          return 1;
+        }
+
+        break;
+      }
+
+      default:
+        break;
+    }
+  }
+
+  return 0;
+}
+
+uint8_t movie_seek(movie_state *movie, uint64_t frame) {
+  if (movie->mode != MOVIE_PLAYING || frame > movie->frames || frame < movie->keyframes[0].frame) {
+    return 0;
+  }
+
+  uint32_t low = 0;
+  uint32_t high = movie->keyframe_count;
+
+  while (high - low > 1) {
+    uint32_t middle = (low + high) / 2;
+
+    if (movie->keyframes[middle].frame <= frame) {
+      low = middle;
+    } else {
+      high = middle;
+    }
+  }
+
+  // Playing on is cheaper than loading when the machine is already past the keyframe
+  if (movie->frame > frame || movie->frame < movie->keyframes[low].frame) {
+    if (!movie_load_keyframe(movie, low)) {
+      return 0;
+    }
+  }
+
+  while (movie->frame < frame) {
+    if (!movie_play_frame(movie)) {
+      return 0;
+    }
+  }
+
+  return 1;
+}
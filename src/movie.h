@@ -0,0 +1,100 @@
+#pragma once
+
+#include <stdio.h>
+
+#include "savestate.h"
+
+// Recordings of everything a machine cannot compute by itself: the value of every IN from an input port, the cycle
+// every interrupt came at and the keys held. Events are appended to a log with a savestate every keyframe interval
+// frames, and an index of the keyframes is written at the end so playback can seek to any frame by loading the
+// keyframe before it and replaying the frames after. A log without the index, from a recording that never closed,
+// is scanned for its keyframes instead.
+//
+// Frames end with RST 2. The values IN reads are played back in order, so a recording plays the same on every
+// engine; the interrupts are delivered by movie_play_frame at their cycles.
+
+#define MOVIE_MAGIC 0x4956304d
+#define MOVIE_INDEX_MAGIC 0x5844494d
+#define MOVIE_VERSION 1
+
+// Ten seconds of Space Invaders
+#define MOVIE_DEFAULT_INTERVAL 600
+
+enum MovieEvents {
+  // Key and state
+  MOVIE_EVENT_KEY = 0x0,
+  // Reads since the last one, port and value, only written when the port reads something new
+  MOVIE_EVENT_IN = 0x1,
+  // Cycles since the last interrupt or keyframe and opcode
+  MOVIE_EVENT_INTERRUPT = 0x2,
+  // Frame, size and a compressed savestate
+  MOVIE_EVENT_KEYFRAME = 0x3,
+};
+
+enum MovieModes {
+  MOVIE_RECORDING = 0x0,
+  MOVIE_PLAYING = 0x1,
+};
+
+typedef struct {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t savestate_version;
+  uint32_t keyframe_interval;
+} movie_header;
+
+typedef struct {
+  uint64_t frame;
+  // Of the keyframe event in the file
+  uint64_t offset;
+} movie_keyframe;
+
+typedef struct {
+  uint8_t mode;
+  cpu_state *state;
+  uint32_t keyframe_interval;
+  // Frame the machine is in, and the last one of a playback
+  uint64_t frame;
+  uint64_t frames;
+
+  movie_keyframe *keyframes;
+  uint32_t keyframe_count;
+  uint32_t keyframe_capacity;
+
+  // Recording appends to file, playback reads a mapping of it up to log_end
+  FILE *file;
+  uint8_t *data;
+  uint64_t size;
+  uint64_t log_end;
+  // Next event of the frame loop, and of the input hook which only looks at IN events
+  uint64_t cursor;
+  uint64_t input_cursor;
+
+  // Counted from the last keyframe
+  uint64_t reads;
+  uint64_t last_read;
+  uint64_t cycle_base;
+
+  uint8_t ports[MACHINE_INPUT_PORTS];
+  uint8_t known_ports;
+  uint8_t keys[10];
+
+  uint8_t *scratch;
+  uint8_t *packed;
+  uint32_t state_size;
+
+  // Keyframes passed in playback that did not match the machine
+  uint32_t desyncs;
+} movie_state;
+
+// The machine must stay mapped as it is for as long as the movie lives, both hook into it
+movie_state *movie_record(const char *path, cpu_state *state, uint32_t keyframe_interval);
+// NULL when the file is not a movie of this version. Starts at frame 0
+movie_state *movie_play(const char *path, cpu_state *state);
+// Writes the index of a recording
+void movie_close(movie_state *movie);
+
+// Runs the next frame of a playback, 0 at the end of the movie
+uint8_t movie_play_frame(movie_state *movie);
+// 0 when the frame is before the first keyframe or after the end
+uint8_t movie_seek(movie_state *movie, uint64_t frame);
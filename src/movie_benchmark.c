@@ -0,0 +1,175 @@
+#include "benchmark.h"
+#include "movie.h"
+
+// Records Space Invaders played with pseudo random keys, plays the recording back on a fresh machine and seeks to
+// frames all over it, checking the machine against copies taken while recording.
+// Usage: movie_benchmark [frames] [keyframe interval] [checked frames]
+//        movie_benchmark --play path, to play a recording of the emulator through
+// Runs from the build directory, the movie is written to movie_benchmark.mov there.
+
+#define MOVIE_PATH "movie_benchmark.mov"
+
+double elapsed(clock_t start_time) {
+  return (double) (clock() - start_time) / CLOCKS_PER_SEC;
+}
+
+cpu_state create_state(machine_state *machine) {
+  uint32_t file_size;
+  char *file_buffer = benchmark_load_file("../roms/invaders.rom", 0, &file_size);
+
+  machine_init(machine);
+  cpu_state state = cpu_init(machine, file_buffer, file_size);
+  machine_map_memory(state.memory, machine_load_rom(state.memory->arena, (uint8_t *) file_buffer, file_size));
+  free(file_buffer);
+
+  return state;
+}
+
+void end_frame(void *context, cpu_state *state) {
+  *(uint8_t *) context = 1;
+  state->machine->running = 0;
+}
+
+// On the screen interrupts of the scheduler like the emulator, a frame ends right after its RST 2 like in playback
+void run_frame(cpu_state *state, uint32_t frame, uint8_t *frame_ended) {
+  benchmark_set_keys(state->machine, frame, BENCHMARK_COIN_FRAME, frame);
+
+  *frame_ended = 0;
+  state->machine->running = 1;
+  cpu_start_emulation(state);
+
+  if (!*frame_ended) {
+    exit(1);
+  }
+}
+
+int play(const char *path) {
+  machine_state machine;
+  cpu_state state = create_state(&machine);
+  movie_state *movie = movie_play(path, &state);
+
+  if (!movie) {
+    printf("MOVIE COULD NOT BE PLAYED: %s\n", path);
+    exit(1);
+  }
+
+  clock_t start_time = clock();
+
+  while (movie_play_frame(movie)) {
+  }
+
+  printf("%lu of %lu frames played in %.2f s | %u keyframes | %u desyncs\n", (unsigned long) movie->frame,
+         (unsigned long) movie->frames, elapsed(start_time), movie->keyframe_count, movie->desyncs);
+
+  uint8_t failed = movie->frame != movie->frames || movie->desyncs;
+  movie_close(movie);
+  cpu_destroy(&state);
+  return failed;
+}
+
+int main(int argc, char **argv) {
+  if (argc > 2 && strcmp(argv[1], "--play") == 0) {
+    return play(argv[2]);
+  }
+
+  uint32_t frames = argc > 1 ? strtoul(argv[1], NULL, 0) : 7200;
+  uint32_t interval = argc > 2 ? strtoul(argv[2], NULL, 0) : MOVIE_DEFAULT_INTERVAL;
+  uint32_t checked = argc > 3 ? strtoul(argv[3], NULL, 0) : 16;
+
+  machine_state machine;
+  cpu_state state = create_state(&machine);
+  uint32_t size = savestate_size(&state);
+  checked = checked < frames ? checked : frames;
+
+  // Frames spread over the whole movie, from the last one back
+  uint32_t *checked_frames = malloc(checked * sizeof(uint32_t));
+  uint8_t *expected = malloc((size_t) checked * size);
+  uint8_t *actual = malloc(size);
+
+  for (uint32_t i = 0; i < checked; i++) {
+    checked_frames[i] = frames - (uint32_t) ((uint64_t) i * frames / checked);
+  }
+
+  uint8_t frame_ended;
+  cpu_set_frame_handler(&state, end_frame, &frame_ended);
+  cpu_start_video(&state);
+  movie_state *movie = movie_record(MOVIE_PATH, &state, interval);
+
+  if (!movie) {
+    exit(1);
+  }
+
+  clock_t start_time = clock();
+
+  for (uint32_t frame = 0; frame < frames; frame++) {
+    run_frame(&state, frame, &frame_ended);
+
+    for (uint32_t i = 0; i < checked; i++) {
+      if (checked_frames[i] == frame + 1) {
+        savestate_save(&state, expected + (size_t) i * size, size);
+      }
+    }
+  }
+
+  movie_close(movie);
+  double record_seconds = elapsed(start_time);
+  cpu_destroy(&state);
+
+  // Playback starts over on a machine that never saw the keys
+  state = create_state(&machine);
+  movie = movie_play(MOVIE_PATH, &state);
+
+  if (!movie) {
+    printf("MOVIE COULD NOT BE PLAYED: %s\n", MOVIE_PATH);
+    exit(1);
+  }
+
+  printf("%u frames recorded in %.2f s | %lu bytes, %.1f per frame | %u keyframes every %u frames\n", frames,
+         record_seconds, (unsigned long) movie->size, (double) movie->size / frames, movie->keyframe_count,
+         movie->keyframe_interval);
+
+  start_time = clock();
+
+  while (movie_play_frame(movie)) {
+  }
+
+  savestate_save(&state, actual, size);
+  uint32_t differences = movie->frame != frames || memcmp(actual, expected, size) != 0;
+  printf("%lu frames played in %.2f s | %u desyncs | last frame %s\n", (unsigned long) movie->frame,
+         elapsed(start_time), movie->desyncs, differences ? "differs" : "ok");
+
+  // Backwards first, then every other one forwards so seeks both load keyframes and play on
+  start_time = clock();
+  uint32_t seeks = 0;
+
+  for (uint32_t pass = 0; pass < 2; pass++) {
+    for (uint32_t j = 0; j < checked; j++) {
+      uint32_t i = pass ? checked - 1 - j : j;
+
+      if (pass && i % 2) {
+        continue;
+      }
+
+      if (!movie_seek(movie, checked_frames[i])) {
+        differences++;
+        continue;
+      }
+
+      savestate_save(&state, actual, size);
+      differences += memcmp(actual, expected + (size_t) i * size, size) != 0;
+      seeks++;
+    }
+  }
+
+  printf("%u seeks in %.2f s, %.2f ms each | %u differ\n", seeks, elapsed(start_time),
+         1000 * elapsed(start_time) / (seeks ? seeks : 1), differences);
+
+  uint32_t desyncs = movie->desyncs;
+  movie_close(movie);
+  remove(MOVIE_PATH);
+  free(checked_frames);
+  free(expected);
+  free(actual);
+  cpu_destroy(&state);
+  return differences != 0 || desyncs != 0;
+}
@@ -0,0 +1,178 @@
+#include "benchmark.h"
+
+// Runs a ROM on the interpreter and ranks the opcode sequences that could be fused into superinstructions.
+// Only sequences that fit inside one block of the block engine are counted.
+// Usage: ngrams [rom] [cycles] [origin]
+// With origin 0 the ROM is run as Space Invaders, otherwise as a CP/M program.
+
+#define NGRAMS_MAX_LENGTH 4
+#define NGRAMS_TABLE_SIZE 0x10000
+#define NGRAMS_SHOWN 24
+
+char *file_to_open = "../roms/invaders.rom";
+uint64_t cycles_to_run = 100000000;
+uint32_t origin = 0;
+
+typedef struct {
+  uint32_t key;
+  uint8_t length;
+  uint64_t count;
+} ngram;
+
+ngram table[NGRAMS_TABLE_SIZE];
+
+uint8_t history[NGRAMS_MAX_LENGTH];
+uint8_t history_length;
+uint64_t instructions;
+
+static const char *op_names[256] = {
+#define CPU_OP(name, ...) [name] = #name,
+#include "cpu_ops.h"
+#undef CPU_OP
+};
+
+void ngrams_count(uint32_t key, uint8_t length) {
+  uint32_t index = (key * 2654435761u + length) % NGRAMS_TABLE_SIZE;
+
+  while (table[index].length && (table[index].key != key || table[index].length != length)) {
+    index = (index + 1) % NGRAMS_TABLE_SIZE;
+  }
+
+  table[index].key = key;
+  table[index].length = length;
+  table[index].count++;
+}
+
+void ngrams_record(uint8_t op_code) {
+  if (history_length == NGRAMS_MAX_LENGTH) {
+    memmove(history, history + 1, NGRAMS_MAX_LENGTH - 1);
+    history_length--;
+  }
+
+  history[history_length++] = op_code;
+
+  uint32_t key = op_code;
+
+  for (uint8_t length = 2; length <= history_length; length++) {
+    key |= (uint32_t) history[history_length - length] << (8 * (length - 1));
+    ngrams_count(key, length);
+  }
+
+  // Nothing is fused across the end of a block
+  if (cpu_ends_block(op_code)) {
+    history_length = 0;
+  }
+}
+
+int ngrams_compare(const void *first, const void *second) {
+  const ngram *a = first;
+  const ngram *b = second;
+  uint64_t saved_a = a->count * (a->length - 1);
+  uint64_t saved_b = b->count * (b->length - 1);
+  return saved_a < saved_b ? 1 : saved_a > saved_b ? -1 : 0;
+}
+
+void ngrams_print(uint64_t instructions) {
+  qsort(table, NGRAMS_TABLE_SIZE, sizeof(ngram), ngrams_compare);
+
+  printf("%" PRIu64 " instructions executed, dispatches saved by fusing each sequence:\n", instructions);
+
+  for (uint32_t i = 0; i < NGRAMS_SHOWN && table[i].length; i++) {
+    uint64_t saved = table[i].count * (table[i].length - 1);
+    printf("%2u. %6.2f%% %12" PRIu64 "  ", i + 1, 100.0 * saved / instructions, table[i].count);
+
+    for (uint8_t j = 0; j < table[i].length; j++) {
+      printf(" %s", op_names[table[i].key >> (8 * (table[i].length - 1 - j)) & 0xFF]);
+    }
+
+    printf("\n");
+  }
+}
+
+// Loop cpu_run runs in place of the engine, every opcode is recorded before cpu_emulate_op_code executes it
+uint8_t ngrams_interpret(cpu_state *state, uint64_t cycle_target, uint64_t count) {
+  for (uint64_t executed = 0; executed < count; executed++) {
+    if (state->cycles >= cycle_target) {
+      return CPU_STOP_BUDGET;
+    }
+
+    if (state->interrupt) {
+      return CPU_STOP_INTERRUPT;
+    }
+
+    uint8_t op_code = cpu_fetch(state);
+
+    if (op_code == HLT) {
+      history_length = 0;
+
+      // CP/M programs are restarted until enough cycles were run
+      if (origin) {
+        state->pc = origin;
+        continue;
+      }
+
+      state->halted = 1;
+      return CPU_STOP_HALT;
+    }
+
+    ngrams_record(op_code);
+
+    if (!cpu_emulate_op_code(state, op_code)) {
+      state->pc--;
+      return CPU_STOP_UNIMPLEMENTED;
+    }
+
+    instructions++;
+  }
+
+  return CPU_STOP_BUDGET;
+}
+
+// Nothing is fused across an interrupt either
+void ngrams_interrupt(void *context, cpu_state *state, uint8_t op_code, uint64_t cycle) {
+  history_length = 0;
+}
+
+void ngrams_stop(void *context, uint64_t cycle) {
+  ((machine_state *) context)->running = 0;
+}
+
+// Space Invaders runs on the screen interrupts of the scheduler like the emulator
+void ngrams_run(cpu_state *state) {
+  state->interpreter = ngrams_interpret;
+  cpu_set_interrupt_handler(state, ngrams_interrupt, NULL);
+  scheduler_add(&state->machine->scheduler, cycles_to_run, ngrams_stop, state->machine);
+
+  if (!origin) {
+    cpu_start_video(state);
+  }
+
+  state->machine->running = 1;
+  cpu_start_emulation(state);
+  ngrams_print(instructions);
+}
+
+int main(int argc, char **argv) {
+  if (argc > 1) file_to_open = argv[1];
+  if (argc > 2) cycles_to_run = strtoull(argv[2], NULL, 0);
+  if (argc > 3) origin = strtoul(argv[3], NULL, 0);
+
+  uint32_t file_size;
+  char *file_buffer = benchmark_load_file(file_to_open, origin, &file_size);
+
+  machine_state machine;
+  machine_init(&machine);
+  cpu_state state = cpu_init(&machine, file_buffer, file_size);
+  free(file_buffer);
+
+  if (origin) {
+    // CP/M warm boot halts, BDOS calls return immediately
+    cpu_write_byte(&state, 0x0000, HLT);
+    cpu_write_byte(&state, 0x0005, RET);
+    state.pc = origin;
+  }
+
+  ngrams_run(&state);
+  cpu_destroy(&state);
+  return 0;
+}
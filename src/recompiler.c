@@ -0,0 +1,256 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "cpu.h"
+
+// Translates the statically reachable code of a ROM to a C file with one function per block.
+// Usage: recompiler [rom] [output] [name] [origin]
+
+char *file_to_open = "../roms/invaders.rom";
+char *file_to_write = "../roms/invaders_aot.c";
+char *image_name = "invaders";
+uint32_t origin = 0;
+
+// Room for the operands of an instruction at the very end of memory
+uint8_t memory[0x10000 + 2];
+uint32_t rom_end;
+
+uint8_t leaders[0x10000];
+uint8_t leaders_changed;
+
+static const char *op_names[256] = {
+#define CPU_OP(name, ...) [name] = #name,
+#include "cpu_ops.h"
+#undef CPU_OP
+};
+
+uint8_t recompiler_supports(uint32_t address) {
+  uint8_t op_code = memory[address];
+  return op_names[op_code] && address + disassemble_byte_length[op_code] <= rom_end;
+}
+
+void recompiler_add_leader(uint32_t address) {
+  if (address < origin || address >= rom_end || leaders[address] || !recompiler_supports(address)) {
+    return;
+  }
+
+  leaders[address] = 1;
+  leaders_changed = 1;
+}
+
+uint16_t recompiler_operand(uint32_t address) {
+  return disassemble_byte_length[memory[address]] == 3 ? cpu_compose(memory[address + 2], memory[address + 1])
+                                                       : memory[address + 1];
+}
+
+// A block ends after a control transfer, before HLT or unsupported code, before another block or when it is full
+uint32_t recompiler_scan_block(uint32_t start, uint8_t *count, uint8_t *ends_block) {
+  uint32_t address = start;
+  *count = 0;
+  *ends_block = 0;
+
+  do {
+    uint8_t op_code = memory[address];
+    address += disassemble_byte_length[op_code];
+    (*count)++;
+    *ends_block = cpu_ends_block(op_code);
+  } while (!*ends_block && *count < CPU_BLOCK_MAX_OPS && recompiler_supports(address) && !leaders[address]);
+
+  return address;
+}
+
+uint32_t recompiler_last_op(uint32_t start, uint8_t count) {
+  uint32_t address = start;
+
+  for (uint8_t i = 1; i < count; i++) {
+    address += disassemble_byte_length[memory[address]];
+  }
+
+  return address;
+}
+
+void recompiler_add_successors(uint32_t last, uint32_t end, uint8_t ends_block) {
+  uint8_t op_code = memory[last];
+
+  if (!ends_block) {
+    recompiler_add_leader(end);
+    return;
+  }
+
+  switch (op_code) {
+    case JMP:
+      recompiler_add_leader(recompiler_operand(last));
+      break;
+
+    case JNZ: case JZ: case JNC: case JC: case JPO: case JPE: case JP: case JM:
+    case CALL: case CNZ: case CZ: case CNC: case CC: case CPO: case CPE: case CP: case CM:
+      recompiler_add_leader(recompiler_operand(last));
+      recompiler_add_leader(end);
+      break;
+
+    case RNZ: case RZ: case RNC: case RC: case RPO: case RPE: case RP: case RM:
+      recompiler_add_leader(end);
+      break;
+
+    case RST_0: case RST_1: case RST_2: case RST_3: case RST_4: case RST_5: case RST_6: case RST_7:
+      recompiler_add_leader(op_code & 0x38);
+      recompiler_add_leader(end);
+      break;
+
+    default:
+      break;
+  }
+}
+
+void recompiler_discover() {
+  recompiler_add_leader(origin);
+
+  for (uint32_t vector = 0; vector < 0x40; vector += 8) {
+    recompiler_add_leader(vector);
+  }
+
+  while (leaders_changed) {
+    leaders_changed = 0;
+
+    for (uint32_t start = origin; start < rom_end; start++) {
+      if (!leaders[start]) {
+        continue;
+      }
+
+      uint8_t count, ends_block;
+      uint32_t end = recompiler_scan_block(start, &count, &ends_block);
+      recompiler_add_successors(recompiler_last_op(start, count), end, ends_block);
+    }
+  }
+}
+
+uint8_t recompiler_writes_memory(uint8_t op_code) {
+  switch (op_code) {
+    case STAX_B: case STAX_D: case SHLD: case STA: case INR_M: case DCR_M: case MVI_M_D8:
+    case MOV_M_B: case MOV_M_C: case MOV_M_D: case MOV_M_E: case MOV_M_H: case MOV_M_L: case MOV_M_A:
+    case PUSH_B: case PUSH_D: case PUSH_H: case PUSH_PSW: case XTHL:
+      return 1;
+
+    default:
+      return 0;
+  }
+}
+
+void recompiler_emit_block(FILE *out, uint32_t start, uint32_t *size, uint32_t *guard) {
+  uint8_t count, ends_block;
+  uint32_t end = recompiler_scan_block(start, &count, &ends_block);
+  uint32_t address = start;
+  uint32_t cycles = 0;
+
+  fprintf(out, "static void aot_block_%04X(cpu_state *state) {\n", start);
+
+  for (uint8_t i = 0; i < count; i++) {
+    uint8_t op_code = memory[address];
+    uint8_t length = disassemble_byte_length[op_code];
+    uint16_t imm = length == 1 ? 0 : recompiler_operand(address);
+
+    fprintf(out, "  // 0x%04X: ", address);
+    if (length == 3) {
+      fprintf(out, disassemble_table[op_code], memory[address + 2], memory[address + 1]);
+    } else {
+      fprintf(out, disassemble_table[op_code], memory[address + 1]);
+    }
+    fprintf(out, "\n");
+
+    address += length;
+    *guard = cycles;
+    cycles += cycles_per_instruction[op_code];
+
+    fprintf(out, "  state->pc = 0x%04X;\n", address & 0xFFFF);
+
+    if (cycles_per_instruction_taken[op_code] != cycles_per_instruction[op_code]) {
+      fprintf(out, "  state->cycles += aot_%s(state, 0x%04X) ? %u : %u;\n", op_names[op_code], imm,
+              cycles_per_instruction_taken[op_code], cycles_per_instruction[op_code]);
+    } else {
+      fprintf(out, "  aot_%s(state, 0x%04X);\n", op_names[op_code], imm);
+      fprintf(out, "  state->cycles += %u;\n", cycles_per_instruction[op_code]);
+    }
+
+    if (recompiler_writes_memory(op_code) && i + 1 < count) {
+      fprintf(out, "  AOT_CHECK_WRITE(0x%04X);\n", start);
+    }
+  }
+
+  fprintf(out, "}\n\n");
+  *size = end - start;
+}
+
+void recompile() {
+  FILE *out = fopen(file_to_write, "wb");
+
+  if (!out) {
+    printf("FILE COULD NOT BE WRITTEN: %s\n", file_to_write);
+    exit(1);
+  }
+
+  recompiler_discover();
+
+  fprintf(out, "// Generated by the recompiler from %s, do not edit\n\n", file_to_open);
+  fprintf(out, "#include \"aot.h\"\n\n");
+
+  fprintf(out, "static const uint8_t aot_rom[%u] = {", rom_end - origin);
+  for (uint32_t address = origin; address < rom_end; address++) {
+    fprintf(out, "%s0x%02X,", (address - origin) % 16 ? " " : "\n  ", memory[address]);
+  }
+  fprintf(out, "\n};\n\n");
+
+  uint32_t block_count = 0;
+  uint32_t sizes[0x10000];
+  uint32_t guards[0x10000];
+
+  for (uint32_t start = origin; start < rom_end; start++) {
+    if (leaders[start]) {
+      recompiler_emit_block(out, start, &sizes[start], &guards[start]);
+      block_count++;
+    }
+  }
+
+  fprintf(out, "static const cpu_aot_block aot_blocks[%u] = {\n", block_count);
+  for (uint32_t start = origin; start < rom_end; start++) {
+    if (leaders[start]) {
+      fprintf(out, "  {0x%04X, %u, %u, aot_block_%04X},\n", start, sizes[start], guards[start], start);
+    }
+  }
+  fprintf(out, "};\n\n");
+
+  fprintf(out, "const cpu_aot_image aot_image_%s = {\"%s\", 0x%04X, %u, aot_rom, aot_blocks, %u};\n", image_name,
+          image_name, origin, rom_end - origin, block_count);
+
+  fclose(out);
+  printf("%s: %u blocks written to %s\n", file_to_open, block_count, file_to_write);
+}
+
+int main(int argc, char **argv) {
+  if (argc > 1) file_to_open = argv[1];
+  if (argc > 2) file_to_write = argv[2];
+  if (argc > 3) image_name = argv[3];
+  if (argc > 4) origin = strtoul(argv[4], NULL, 0);
+
+  FILE *file = fopen(file_to_open, "rb");
+
+  if (!file) {
+    printf("FILE COULD NOT BE LOADED: %s\n", file_to_open);
+    return 1;
+  }
+
+  fseek(file, 0, SEEK_END);
+  uint32_t file_size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+
+  if (origin + file_size > 0x10000) {
+    printf("FILE DOES NOT FIT IN MEMORY: %s\n", file_to_open);
+    return 1;
+  }
+
+  fread(memory + origin, 1, file_size, file);
+  fclose(file);
+
+  rom_end = origin + file_size;
+  recompile();
+  return 0;
+}
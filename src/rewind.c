@@ -0,0 +1,261 @@
+#include "rewind.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <time.h>
+
+static uint64_t rewind_now_ns(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static rewind_entry *rewind_entry_at(rewind_state *rewind, uint32_t index) {
+  return &rewind->entries[(rewind->first + index) % rewind->max_entries];
+}
+
+static void rewind_drop_oldest(rewind_state *rewind) {
+  rewind->stored_bytes -= rewind_entry_at(rewind, 0)->size;
+  rewind->first = (rewind->first + 1) % rewind->max_entries;
+  rewind->count--;
+}
+
+// Live entries are contiguous from the oldest to write, going around the end of the buffer at most once
+static uint32_t rewind_reserve(rewind_state *rewind, uint32_t size) {
+  if (rewind->count == rewind->max_entries) {
+    rewind_drop_oldest(rewind);
+  }
+
+  while (rewind->count) {
+    uint32_t oldest = rewind_entry_at(rewind, 0)->offset;
+
+    if (oldest >= rewind->write) {
+      if (rewind->write + size <= oldest) {
+        return rewind->write;
+      }
+
+      rewind_drop_oldest(rewind);
+    } else if (rewind->write + size <= rewind->capacity) {
+      return rewind->write;
+    } else {
+      rewind->write = 0;
+    }
+  }
+
+  rewind->write = 0;
+  return 0;
+}
+
+// Stores the step from the newest state back to the one before it
+static void rewind_encode(rewind_state *rewind, const uint8_t *state) {
+  uint64_t start = rewind_now_ns();
+
+  if (!rewind->has_latest) {
+    memcpy(rewind->latest, state, rewind->state_size);
+    rewind->has_latest = 1;
+    return;
+  }
+
+  for (uint32_t i = 0; i < rewind->state_size; i++) {
+    rewind->delta[i] = state[i] ^ rewind->latest[i];
+  }
+
+  memcpy(rewind->latest, state, rewind->state_size);
+
+  // The worst case of the encoding leaves room to encode straight into the ring
+  uint32_t bound = rewind->state_size + rewind->state_size / 128 + 1;
+  uint32_t offset = rewind_reserve(rewind, bound);
+  uint32_t size = savestate_rle_encode(rewind->delta, rewind->state_size, rewind->buffer + offset, bound);
+
+  rewind_entry *entry = rewind_entry_at(rewind, rewind->count++);
+  entry->offset = offset;
+  entry->size = size;
+  rewind->write = offset + size;
+
+  rewind->stored_bytes += size;
+  rewind->deltas++;
+  rewind->encoded_bytes += size;
+  rewind->encode_ns += rewind_now_ns() - start;
+}
+
+static uint8_t *rewind_slot(rewind_state *rewind, uint32_t index) {
+  return rewind->slots + (size_t) (index % REWIND_SLOTS) * rewind->state_size;
+}
+
+// The encoder claims the oldest slot under the lock and encodes it without, so a push is never held up by it
+static void *rewind_run_encoder(void *param) {
+  rewind_state *rewind = param;
+  pthread_mutex_lock(&rewind->lock);
+
+  while (1) {
+    // Sleeping is set before the tail is read again and a push sets the tail before it reads sleeping, so one of
+    // them sees the other
+    __atomic_store_n(&rewind->sleeping, 1, __ATOMIC_SEQ_CST);
+
+    while (!rewind->stopping && rewind->slot_head == __atomic_load_n(&rewind->slot_tail, __ATOMIC_SEQ_CST)) {
+      pthread_cond_wait(&rewind->wake, &rewind->lock);
+    }
+
+    __atomic_store_n(&rewind->sleeping, 0, __ATOMIC_RELAXED);
+
+    if (rewind->stopping) {
+      break;
+    }
+
+    uint32_t head = rewind->slot_head;
+    rewind->encoding = 1;
+    pthread_mutex_unlock(&rewind->lock);
+
+    rewind_encode(rewind, rewind_slot(rewind, head));
+
+    pthread_mutex_lock(&rewind->lock);
+    rewind->encoding = 0;
+    __atomic_store_n(&rewind->slot_head, head + 1, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&rewind->wake);
+  }
+
+  pthread_mutex_unlock(&rewind->lock);
+  return NULL;
+}
+
+rewind_state *rewind_create(uint32_t capacity, uint32_t state_size) {
+  rewind_state *rewind = calloc(1, sizeof(rewind_state));
+  rewind->state_size = state_size;
+  rewind->slots = malloc((size_t) REWIND_SLOTS * state_size);
+  rewind->latest = malloc(state_size);
+  rewind->delta = malloc(state_size);
+
+  if (capacity < state_size + state_size / 128 + 1) {
+    printf("REWIND CAPACITY IS TOO SMALL FOR ONE FRAME\n");
+    exit(1);
+  }
+
+  // An unchanged frame still takes two bytes per run of zeros
+  rewind->capacity = capacity;
+  rewind->buffer = malloc(capacity);
+  rewind->max_entries = capacity / (2 * (state_size / 130 + 1)) + 1;
+  rewind->entries = malloc(rewind->max_entries * sizeof(rewind_entry));
+
+  pthread_mutex_init(&rewind->lock, NULL);
+  pthread_cond_init(&rewind->wake, NULL);
+
+  if (pthread_create(&rewind->thread, NULL, rewind_run_encoder, rewind) != 0) {
+    printf("REWIND THREAD COULD NOT BE CREATED\n");
+    exit(1);
+  }
+
+  return rewind;
+}
+
+void rewind_destroy(rewind_state *rewind) {
+  pthread_mutex_lock(&rewind->lock);
+  rewind->stopping = 1;
+  pthread_cond_broadcast(&rewind->wake);
+  pthread_mutex_unlock(&rewind->lock);
+  pthread_join(rewind->thread, NULL);
+
+  pthread_mutex_destroy(&rewind->lock);
+  pthread_cond_destroy(&rewind->wake);
+
+  free(rewind->slots);
+  free(rewind->latest);
+  free(rewind->delta);
+  free(rewind->buffer);
+  free(rewind->entries);
+  free(rewind);
+}
+
+uint32_t rewind_pending(rewind_state *rewind) {
+  return rewind->slot_tail - __atomic_load_n(&rewind->slot_head, __ATOMIC_ACQUIRE);
+}
+
+void rewind_push(rewind_state *rewind, cpu_state *state) {
+  uint64_t start = rewind_now_ns();
+  uint32_t tail = rewind->slot_tail;
+
+  if (rewind_pending(rewind) == REWIND_SLOTS) {
+    rewind->dropped++;
+    return;
+  }
+
+  savestate_save(state, rewind_slot(rewind, tail), rewind->state_size);
+
+  __atomic_store_n(&rewind->slot_tail, tail + 1, __ATOMIC_SEQ_CST);
+
+  // The lock is only taken to wake the encoder, not while it keeps up
+  if (__atomic_load_n(&rewind->sleeping, __ATOMIC_SEQ_CST)) {
+    pthread_mutex_lock(&rewind->lock);
+    pthread_cond_broadcast(&rewind->wake);
+    pthread_mutex_unlock(&rewind->lock);
+  }
+
+  rewind->frames++;
+  rewind->push_ns += rewind_now_ns() - start;
+}
+
+void rewind_wait(rewind_state *rewind) {
+  pthread_mutex_lock(&rewind->lock);
+
+  while (rewind->slot_head != rewind->slot_tail) {
+    pthread_cond_wait(&rewind->wake, &rewind->lock);
+  }
+
+  pthread_mutex_unlock(&rewind->lock);
+}
+
+// Encodes the pending slots on the calling thread instead of waiting for the encoder to get to them. Only a slot
+// the encoder is in the middle of is waited for.
+static void rewind_take_over(rewind_state *rewind) {
+  pthread_mutex_lock(&rewind->lock);
+
+  while (rewind->encoding) {
+    pthread_cond_wait(&rewind->wake, &rewind->lock);
+  }
+
+  while (rewind->slot_head != rewind->slot_tail) {
+    rewind_encode(rewind, rewind_slot(rewind, rewind->slot_head));
+    __atomic_store_n(&rewind->slot_head, rewind->slot_head + 1, __ATOMIC_RELEASE);
+    rewind->taken_over++;
+  }
+
+  pthread_mutex_unlock(&rewind->lock);
+}
+
+uint8_t rewind_step(rewind_state *rewind, cpu_state *state) {
+  rewind_take_over(rewind);
+
+  if (!rewind->count) {
+    return 0;
+  }
+
+  rewind_entry *entry = rewind_entry_at(rewind, --rewind->count);
+
+  if (savestate_rle_decode(rewind->buffer + entry->offset, entry->size, rewind->delta, rewind->state_size) !=
+      rewind->state_size) {
+    printf("REWIND ENTRY IS CORRUPT\n");
+    exit(1);
+  }
+
+  for (uint32_t i = 0; i < rewind->state_size; i++) {
+    rewind->latest[i] ^= rewind->delta[i];
+  }
+
+  rewind->write = entry->offset;
+  rewind->stored_bytes -= entry->size;
+  return savestate_load(state, rewind->latest, rewind->state_size);
+}
+
+double rewind_seconds(rewind_state *rewind) {
+  return rewind->count / 60.0;
+}
+
+void rewind_print_info(rewind_state *rewind) {
+  uint64_t deltas = rewind->deltas ? rewind->deltas : 1;
+  uint64_t frames = rewind->frames ? rewind->frames : 1;
+
+  printf("Rewind: %u frames (%.1f s) in %u of %u KiB | %.0f bytes per frame | push %.2f us, encode %.2f us per "
+         "frame | %" PRIu64 " dropped, %" PRIu64 " encoded by rewind_step\n",
+         rewind->count, rewind_seconds(rewind), rewind->stored_bytes / 1024, rewind->capacity / 1024,
+         (double) rewind->encoded_bytes / deltas, rewind->push_ns / 1000.0 / frames,
+         rewind->encode_ns / 1000.0 / deltas, rewind->dropped, rewind->taken_over);
+}
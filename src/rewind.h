@@ -0,0 +1,80 @@
+#pragma once
+
+#include <pthread.h>
+
+#include "savestate.h"
+
+// Frame by frame history of one machine in a fixed amount of memory. The newest state is kept whole and every
+// older frame as the run-length encoded XOR of it with the frame after, so stepping back undoes one delta and the
+// oldest frames are dropped without touching the others. The emulation thread only copies a savestate into a
+// slot and signals a background thread, which sleeps on a condition variable until there is one to encode.
+
+// A minute of Space Invaders takes well under this
+#define REWIND_DEFAULT_CAPACITY (4 << 20)
+// States waiting for the encoder, a frame is dropped rather than waited for when they are all taken
+#define REWIND_SLOTS 8
+
+typedef struct {
+  uint32_t offset;
+  uint32_t size;
+} rewind_entry;
+
+typedef struct {
+  uint32_t state_size;
+
+  // Written by the emulation thread at tail, read by the encoder at head
+  uint8_t *slots;
+  uint32_t slot_head;
+  uint32_t slot_tail;
+
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  uint8_t stopping;
+  // Set while the encoder works on the slot at head outside the lock, and while it waits for a slot
+  uint8_t encoding;
+  uint8_t sleeping;
+
+  // Newest state, the deltas lead back from it
+  uint8_t *latest;
+  uint8_t has_latest;
+  uint8_t *delta;
+
+  // Encoded deltas in a circular buffer, entries from oldest at first to newest
+  uint8_t *buffer;
+  uint32_t capacity;
+  uint32_t write;
+  rewind_entry *entries;
+  uint32_t max_entries;
+  uint32_t first;
+  uint32_t count;
+  uint32_t stored_bytes;
+
+  // Frames pushed and deltas encoded, with the time the emulation thread and the encoder spent on them
+  uint64_t frames;
+  uint64_t deltas;
+  uint64_t dropped;
+  // Slots rewind_step encoded itself rather than wait for the encoder
+  uint64_t taken_over;
+  uint64_t encoded_bytes;
+  uint64_t push_ns;
+  uint64_t encode_ns;
+} rewind_state;
+
+rewind_state *rewind_create(uint32_t capacity, uint32_t state_size);
+void rewind_destroy(rewind_state *rewind);
+
+// Frames pushed that the encoder has not stored yet, a push drops its frame at REWIND_SLOTS. Call from the
+// emulation thread
+uint32_t rewind_pending(rewind_state *rewind);
+// Never waits for the encoder, call once per frame from the emulation thread
+void rewind_push(rewind_state *rewind, cpu_state *state);
+// Until the encoder has stored every pushed frame
+void rewind_wait(rewind_state *rewind);
+// Loads the frame before the newest one and makes it the newest, 0 when there is none. Encodes the frames still
+// pending itself instead of waiting for the encoder
+uint8_t rewind_step(rewind_state *rewind, cpu_state *state);
+
+// Seconds of history at 60 frames per second
+double rewind_seconds(rewind_state *rewind);
+void rewind_print_info(rewind_state *rewind);
@@ -0,0 +1,92 @@
+#include <inttypes.h>
+
+#include "benchmark.h"
+#include "rewind.h"
+
+// Plays Space Invaders while pushing every frame into the rewind buffer, then steps back and checks every frame
+// it comes back to against a full copy taken while playing.
+// Usage: rewind_benchmark [frames] [capacity KiB] [checked frames]
+
+void end_frame(void *context, cpu_state *state) {
+  *(uint8_t *) context = 1;
+  state->machine->running = 0;
+}
+
+// On the screen interrupts of the scheduler like the emulator, a frame ends right after its RST 2
+void run_frame(cpu_state *state, uint32_t frame, uint8_t *frame_ended) {
+  benchmark_set_keys(state->machine, frame, BENCHMARK_COIN_FRAME, frame);
+
+  *frame_ended = 0;
+  state->machine->running = 1;
+  cpu_start_emulation(state);
+
+  if (!*frame_ended) {
+    exit(1);
+  }
+}
+
+int main(int argc, char **argv) {
+  uint32_t frames = argc > 1 ? strtoul(argv[1], NULL, 0) : 7200;
+  uint32_t capacity = argc > 2 ? strtoul(argv[2], NULL, 0) << 10 : REWIND_DEFAULT_CAPACITY;
+  uint32_t checked = argc > 3 ? strtoul(argv[3], NULL, 0) : 600;
+
+  uint32_t file_size;
+  char *file_buffer = benchmark_load_file("../roms/invaders.rom", 0, &file_size);
+
+  machine_state machine;
+  machine_init(&machine);
+  cpu_state state = cpu_init(&machine, file_buffer, file_size);
+  machine_map_memory(state.memory, machine_load_rom(state.memory->arena, (uint8_t *) file_buffer, file_size));
+  free(file_buffer);
+
+  uint8_t frame_ended;
+  cpu_set_frame_handler(&state, end_frame, &frame_ended);
+  cpu_start_video(&state);
+
+  uint32_t size = savestate_size(&state);
+  checked = checked < frames ? checked : frames;
+  uint8_t *expected = malloc((size_t) checked * size);
+  uint8_t *actual = malloc(size);
+  rewind_state *rewind = rewind_create(capacity, size);
+
+  clock_t start_time = clock();
+
+  for (uint32_t frame = 0; frame < frames; frame++) {
+    run_frame(&state, frame, &frame_ended);
+
+    // Frames come much faster than real time here, the encoder keeps up with every one of them at 60 per second
+    if (rewind_pending(rewind) == REWIND_SLOTS) {
+      rewind_wait(rewind);
+    }
+
+    rewind_push(rewind, &state);
+
+    if (frame >= frames - checked) {
+      savestate_save(&state, expected + (size_t) (frame - (frames - checked)) * size, size);
+    }
+  }
+
+  double seconds = (double) (clock() - start_time) / CLOCKS_PER_SEC;
+  printf("%u frames in %.2f s\n", frames, seconds);
+  rewind_print_info(rewind);
+
+  // The newest frame is the one the machine is in, stepping back starts with the one before it. Frames the encoder
+  // has not got to yet are encoded by the first step
+  uint32_t differences = 0;
+  uint32_t steps = 0;
+
+  for (uint32_t i = checked - 1; i > 0 && rewind_step(rewind, &state); i--) {
+    savestate_save(&state, actual, size);
+    differences += memcmp(actual, expected + (size_t) (i - 1) * size, size) != 0;
+    steps++;
+  }
+
+  printf("%u frames stepped back | %" PRIu64 " pending frames encoded by rewind_step | %u differ\n", steps, rewind->taken_over,
+         differences);
+
+  rewind_destroy(rewind);
+  free(expected);
+  free(actual);
+  cpu_destroy(&state);
+  return differences != 0 || steps != checked - 1;
+}
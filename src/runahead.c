@@ -0,0 +1,161 @@
+#include "runahead.h"
+
+#include <stdio.h>
+#include <time.h>
+
+static uint64_t runahead_now_ns(clockid_t clock) {
+  struct timespec now;
+  clock_gettime(clock, &now);
+  return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+// Ends the speculation after its last frame, or as soon as a newer snapshot came
+static void runahead_end_frame(void *context, cpu_state *state) {
+  runahead_state *runahead = context;
+
+  if (++runahead->frames_run == runahead->frames ||
+      __atomic_load_n(&runahead->requested, __ATOMIC_ACQUIRE) != runahead->started) {
+    state->machine->running = 0;
+  }
+}
+
+// 0 when it was cut short
+static uint8_t runahead_speculate(runahead_state *runahead) {
+  runahead->frames_run = 0;
+  runahead->machine.running = 1;
+  cpu_start_emulation(&runahead->state);
+  return runahead->frames_run == runahead->frames;
+}
+
+static void *runahead_run_worker(void *param) {
+  runahead_state *runahead = param;
+  pthread_mutex_lock(&runahead->lock);
+
+  while (1) {
+    while (!runahead->stopping && runahead->started == runahead->requested) {
+      pthread_cond_wait(&runahead->wake, &runahead->lock);
+    }
+
+    if (runahead->stopping) {
+      break;
+    }
+
+    uint64_t request = runahead->requested;
+    runahead->started = request;
+    savestate_load(&runahead->state, runahead->snapshot, runahead->state_size);
+    pthread_mutex_unlock(&runahead->lock);
+
+    uint64_t start = runahead_now_ns(CLOCK_THREAD_CPUTIME_ID);
+    uint8_t finished = runahead_speculate(runahead);
+    uint64_t worker_ns = runahead_now_ns(CLOCK_THREAD_CPUTIME_ID) - start;
+
+    pthread_mutex_lock(&runahead->lock);
+    runahead->worker_ns += worker_ns;
+
+    if (finished) {
+      memcpy(runahead->video, runahead->memory.data + MACHINE_VIDEO_ADDRESS, MACHINE_VIDEO_SIZE);
+      memcpy(runahead->keys, runahead->machine.keys, sizeof(runahead->keys));
+      runahead->has_video = 1;
+      runahead->speculations++;
+    } else {
+      runahead->superseded++;
+    }
+
+    runahead->finished = request;
+    pthread_cond_broadcast(&runahead->wake);
+  }
+
+  pthread_mutex_unlock(&runahead->lock);
+  return NULL;
+}
+
+runahead_state *runahead_create(cpu_state *source, uint32_t frames) {
+  runahead_state *runahead = calloc(1, sizeof(runahead_state));
+  runahead->source = source;
+  runahead->frames = frames;
+
+  machine_init(&runahead->machine);
+  memory_init(&runahead->memory, source->memory->arena);
+  memory_copy(&runahead->memory, source->memory);
+  runahead->state = cpu_init_memory(&runahead->machine, &runahead->memory);
+  cpu_set_frame_handler(&runahead->state, runahead_end_frame, runahead);
+  cpu_start_video(&runahead->state);
+  runahead->state_size = savestate_size(source);
+  runahead->snapshot = malloc(runahead->state_size);
+
+  pthread_mutex_init(&runahead->lock, NULL);
+  pthread_cond_init(&runahead->wake, NULL);
+
+  if (pthread_create(&runahead->thread, NULL, runahead_run_worker, runahead) != 0) {
+    printf("RUNAHEAD THREAD COULD NOT BE CREATED\n");
+    exit(1);
+  }
+
+  return runahead;
+}
+
+void runahead_destroy(runahead_state *runahead) {
+  pthread_mutex_lock(&runahead->lock);
+  runahead->stopping = 1;
+  pthread_cond_broadcast(&runahead->wake);
+  pthread_mutex_unlock(&runahead->lock);
+  pthread_join(runahead->thread, NULL);
+
+  pthread_mutex_destroy(&runahead->lock);
+  pthread_cond_destroy(&runahead->wake);
+  cpu_destroy(&runahead->state);
+  memory_destroy(&runahead->memory);
+  free(runahead->snapshot);
+  free(runahead);
+}
+
+void runahead_request(runahead_state *runahead) {
+  uint64_t start = runahead_now_ns(CLOCK_MONOTONIC);
+
+  pthread_mutex_lock(&runahead->lock);
+  savestate_save(runahead->source, runahead->snapshot, runahead->state_size);
+  __atomic_store_n(&runahead->requested, runahead->requested + 1, __ATOMIC_RELEASE);
+  pthread_cond_broadcast(&runahead->wake);
+  pthread_mutex_unlock(&runahead->lock);
+
+  runahead->request_ns += runahead_now_ns(CLOCK_MONOTONIC) - start;
+}
+
+void runahead_wait(runahead_state *runahead) {
+  pthread_mutex_lock(&runahead->lock);
+
+  while (runahead->finished != runahead->requested) {
+    pthread_cond_wait(&runahead->wake, &runahead->lock);
+  }
+
+  pthread_mutex_unlock(&runahead->lock);
+}
+
+uint8_t runahead_present(runahead_state *runahead, const uint8_t *keys, uint8_t *video) {
+  uint8_t presented = 0;
+  pthread_mutex_lock(&runahead->lock);
+
+  if (runahead->has_video && memcmp(runahead->keys, keys, sizeof(runahead->keys)) == 0) {
+    memcpy(video, runahead->video, MACHINE_VIDEO_SIZE);
+    runahead->presented++;
+    presented = 1;
+  } else if (runahead->has_video) {
+    runahead->discarded++;
+  }
+
+  pthread_mutex_unlock(&runahead->lock);
+  return presented;
+}
+
+// Every frame shown ahead is seen that many frames sooner, the worker time is against the 60 frames of a second
+void runahead_print_info(runahead_state *runahead) {
+  uint64_t requests = runahead->requested ? runahead->requested : 1;
+  uint64_t shown = runahead->presented + runahead->discarded;
+
+  printf("Run-ahead: %u frames, %.1f ms sooner on %.1f%% of frames shown | %lu speculations, %lu cut short, %lu "
+         "discarded for input | snapshot %.2f us, worker %.1f us per frame, %.1f%% of a core\n",
+         runahead->frames, runahead->frames * 1000.0 / 60, 100.0 * runahead->presented / (shown ? shown : 1),
+         (unsigned long) runahead->speculations, (unsigned long) runahead->superseded,
+         (unsigned long) runahead->discarded, runahead->request_ns / 1000.0 / requests,
+         runahead->worker_ns / 1000.0 / requests, runahead->worker_ns * 60 / 1e7 / requests);
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <pthread.h>
+
+#include "savestate.h"
+
+// Hides input latency by showing the game a few frames ahead of where it is. After every real frame the machine
+// is snapshotted and a copy of it, sharing its ROM, runs the frames ahead on a worker thread with the keys of the
+// snapshot and the same screen interrupts. The display shows the video RAM of the last speculative frame as long
+// as the keys are still the ones it was run with, and the frame of the machine itself otherwise.
+
+#define RUNAHEAD_DEFAULT_FRAMES 2
+
+typedef struct {
+  cpu_state *source;
+  uint32_t frames;
+
+  // The speculative machine, only touched by the worker after creation
+  machine_state machine;
+  memory_map memory;
+  cpu_state state;
+  uint32_t state_size;
+  // Frames the running speculation got through
+  uint32_t frames_run;
+
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  uint8_t stopping;
+
+  // Newest snapshot and its number, a speculation that sees a newer one stops and starts over from it
+  uint8_t *snapshot;
+  uint64_t requested;
+  uint64_t started;
+  uint64_t finished;
+
+  // Video RAM of the last finished speculation and the keys it was run with
+  uint8_t video[MACHINE_VIDEO_SIZE];
+  uint8_t keys[10];
+  uint8_t has_video;
+
+  // Speculations finished and cut short, frames shown ahead and thrown away for a change of keys, with the time
+  // the emulation thread spent snapshotting and the CPU time of the worker
+  uint64_t speculations;
+  uint64_t superseded;
+  uint64_t presented;
+  uint64_t discarded;
+  uint64_t request_ns;
+  uint64_t worker_ns;
+} runahead_state;
+
+// The source must outlive the run-ahead, its copy takes pages of the same arena
+runahead_state *runahead_create(cpu_state *source, uint32_t frames);
+void runahead_destroy(runahead_state *runahead);
+
+// Call at the end of every real frame from the emulation thread
+void runahead_request(runahead_state *runahead);
+// Until the speculation of the newest request has finished
+void runahead_wait(runahead_state *runahead);
+// Copies the speculative frame into video, 0 when there is none or it was run with other keys than these
+uint8_t runahead_present(runahead_state *runahead, const uint8_t *keys, uint8_t *video);
+
+void runahead_print_info(runahead_state *runahead);
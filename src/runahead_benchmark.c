@@ -0,0 +1,102 @@
+#include "benchmark.h"
+#include "runahead.h"
+
+// Plays Space Invaders with keys held for a few frames at a time, running ahead after every frame. Every frame
+// shown ahead is kept until the machine gets there and compared with its video RAM, which must match whenever the
+// keys did not change in between.
+// Usage: runahead_benchmark [frames] [frames ahead]
+
+#define HELD_FRAMES 16
+
+void set_keys(machine_state *machine, uint32_t frame) {
+  benchmark_set_keys(machine, frame, BENCHMARK_COIN_FRAME, frame / HELD_FRAMES);
+}
+
+void end_frame(void *context, cpu_state *state) {
+  state->machine->running = 0;
+}
+
+// On the screen interrupts of the scheduler, like the emulator and the speculative machine
+void run_frame(cpu_state *state) {
+  state->machine->running = 1;
+  cpu_start_emulation(state);
+}
+
+// Whether the keys stayed the same from the frame after first up to last
+uint8_t keys_held(uint32_t first, uint32_t last) {
+  for (uint32_t frame = first + 1; frame <= last; frame++) {
+    if ((frame / HELD_FRAMES != first / HELD_FRAMES) || frame == 30 || frame == 35 || frame == 50 || frame == 55) {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+int main(int argc, char **argv) {
+  uint32_t frames = argc > 1 ? strtoul(argv[1], NULL, 0) : 3600;
+  uint32_t ahead = argc > 2 ? strtoul(argv[2], NULL, 0) : RUNAHEAD_DEFAULT_FRAMES;
+
+  uint32_t file_size;
+  char *file_buffer = benchmark_load_file("../roms/invaders.rom", 0, &file_size);
+
+  machine_state machine;
+  machine_init(&machine);
+  cpu_state state = cpu_init(&machine, file_buffer, file_size);
+  machine_map_memory(state.memory, machine_load_rom(state.memory->arena, (uint8_t *) file_buffer, file_size));
+  free(file_buffer);
+  cpu_set_frame_handler(&state, end_frame, NULL);
+  cpu_start_video(&state);
+
+  runahead_state *runahead = runahead_create(&state, ahead);
+
+  // Frames shown ahead by the frame the machine reaches them at
+  uint8_t *predicted = malloc((size_t) (ahead + 1) * MACHINE_VIDEO_SIZE);
+  uint32_t *predicted_at = malloc((ahead + 1) * sizeof(uint32_t));
+  uint8_t *predicted_valid = calloc(ahead + 1, 1);
+  uint32_t matched = 0;
+  uint32_t mispredicted = 0;
+  uint32_t wrong = 0;
+
+  clock_t start_time = clock();
+  set_keys(&machine, 0);
+
+  for (uint32_t frame = 0; frame < frames; frame++) {
+    run_frame(&state);
+    uint32_t slot = (frame + 1) % (ahead + 1);
+
+    if (predicted_valid[slot] && predicted_at[slot] + ahead == frame + 1) {
+      uint8_t same = memcmp(predicted + (size_t) slot * MACHINE_VIDEO_SIZE,
+                            state.memory->data + MACHINE_VIDEO_ADDRESS, MACHINE_VIDEO_SIZE) == 0;
+      matched += same;
+      mispredicted += !same;
+      wrong += !same && keys_held(predicted_at[slot], frame);
+    }
+
+    predicted_valid[slot] = 0;
+    runahead_request(runahead);
+    runahead_wait(runahead);
+
+    // The player presses keys for the next frame while this one is shown
+    set_keys(&machine, frame + 1);
+    uint32_t target = (frame + 1 + ahead) % (ahead + 1);
+
+    if (runahead_present(runahead, machine.keys, predicted + (size_t) target * MACHINE_VIDEO_SIZE)) {
+      predicted_at[target] = frame + 1;
+      predicted_valid[target] = 1;
+    }
+  }
+
+  double seconds = (double) (clock() - start_time) / CLOCKS_PER_SEC;
+  printf("%u frames in %.2f s, run-ahead included\n", frames, seconds);
+  runahead_print_info(runahead);
+  printf("%u frames shown ahead came true | %u did not, %u of them with the same keys\n", matched, mispredicted,
+         wrong);
+
+  runahead_destroy(runahead);
+  free(predicted);
+  free(predicted_at);
+  free(predicted_valid);
+  cpu_destroy(&state);
+  return wrong != 0;
+}
@@ -0,0 +1,282 @@
+#include "savestate.h"
+
+#include <stdio.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define SAVESTATE_MAX_LITERAL 128
+#define SAVESTATE_MIN_RUN 3
+#define SAVESTATE_MAX_RUN (SAVESTATE_MIN_RUN + 127)
+
+static uint32_t savestate_ram_size(uint32_t pages) {
+  return __builtin_popcount(pages) * MEMORY_PAGE_SIZE;
+}
+
+uint32_t savestate_size(cpu_state *state) {
+  return sizeof(savestate_header) + savestate_ram_size(state->memory->private_pages);
+}
+
+uint32_t savestate_save(cpu_state *state, uint8_t *buffer, uint32_t size) {
+  uint32_t pages = state->memory->private_pages;
+
+  if (size < savestate_size(state)) {
+    return 0;
+  }
+
+  savestate_header header = {0};
+  header.magic = SAVESTATE_MAGIC;
+  header.version = SAVESTATE_VERSION;
+  header.pages = pages;
+  header.size = savestate_ram_size(pages);
+  header.cycles = state->cycles;
+
+  header.psw = cpu_get_psw(state);
+  header.bc = state->bc;
+  header.de = state->de;
+  header.hl = state->hl;
+  header.sp = state->sp;
+  header.pc = state->pc;
+
+  header.interrupt_enable = state->interrupt_enable;
+  header.interrupt = state->interrupt;
+  header.halted = state->halted;
+
+  header.shift_offset = state->machine->shift_offset;
+  header.shift0 = state->machine->shift0;
+  header.shift1 = state->machine->shift1;
+  memcpy(header.keys, state->machine->keys, sizeof(header.keys));
+
+  memcpy(buffer, &header, sizeof(header));
+  uint8_t *ram = buffer + sizeof(header);
+
+  for (uint32_t page = 0; page < MEMORY_PAGES; page++) {
+    if (pages >> page & 1) {
+      memcpy(ram, state->data + (page << MEMORY_PAGE_SHIFT), MEMORY_PAGE_SIZE);
+      ram += MEMORY_PAGE_SIZE;
+    }
+  }
+
+  return sizeof(header) + header.size;
+}
+
+static uint8_t savestate_check_header(const savestate_header *header, uint32_t size) {
+  return size >= sizeof(savestate_header) && header->magic == SAVESTATE_MAGIC &&
+         header->version == SAVESTATE_VERSION && header->size == size - sizeof(savestate_header);
+}
+
+uint32_t savestate_compress(const uint8_t *buffer, uint32_t size, uint8_t *output, uint32_t output_size) {
+  savestate_header header;
+  memcpy(&header, buffer, size < sizeof(header) ? size : sizeof(header));
+
+  if (!savestate_check_header(&header, size) || header.flags & SAVESTATE_COMPRESSED ||
+      output_size < sizeof(header)) {
+    return 0;
+  }
+
+  uint32_t encoded = savestate_rle_encode(buffer + sizeof(header), header.size, output + sizeof(header),
+                                          output_size - sizeof(header));
+
+  if (!encoded && header.size) {
+    return 0;
+  }
+
+  header.flags |= SAVESTATE_COMPRESSED;
+  header.size = encoded;
+  memcpy(output, &header, sizeof(header));
+
+  return sizeof(header) + encoded;
+}
+
+uint8_t savestate_load(cpu_state *state, const uint8_t *buffer, uint32_t size) {
+  savestate_header header;
+  memcpy(&header, buffer, size < sizeof(header) ? size : sizeof(header));
+
+  if (!savestate_check_header(&header, size) || header.pages != state->memory->private_pages) {
+    return 0;
+  }
+
+  const uint8_t *ram = buffer + sizeof(header);
+  uint32_t ram_size = savestate_ram_size(header.pages);
+  uint8_t decoded[0x10000];
+
+  if (header.flags & SAVESTATE_COMPRESSED) {
+    if (savestate_rle_decode(ram, header.size, decoded, ram_size) != ram_size) {
+      return 0;
+    }
+
+    ram = decoded;
+  } else if (header.size != ram_size) {
+    return 0;
+  }
+
+  cpu_load_pages(state, header.pages, ram);
+  cpu_set_psw(state, header.psw);
+  state->bc = header.bc;
+  state->de = header.de;
+  state->hl = header.hl;
+  state->sp = header.sp;
+  state->pc = header.pc;
+  state->cycles = header.cycles;
+
+  state->interrupt_enable = header.interrupt_enable;
+  state->interrupt = header.interrupt;
+  state->halted = header.halted;
+  state->stop_reason = 0;
+
+  state->machine->shift_offset = header.shift_offset;
+  state->machine->shift0 = header.shift0;
+  state->machine->shift1 = header.shift1;
+  memcpy(state->machine->keys, header.keys, sizeof(header.keys));
+
+  // The screen interrupts follow the cycle counter
+  if (state->video) {
+    cpu_start_video(state);
+  }
+
+  return 1;
+}
+
+uint8_t savestate_write_file(const char *path, const uint8_t *buffer, uint32_t size) {
+  FILE *file = fopen(path, "wb");
+
+  if (!file) {
+    return 0;
+  }
+
+  uint8_t written = fwrite(buffer, 1, size, file) == size;
+  return fclose(file) == 0 && written;
+}
+
+#ifdef _WIN32
+// Without mmap the file is read into a buffer of its own
+uint8_t savestate_load_file(cpu_state *state, const char *path) {
+  FILE *file = fopen(path, "rb");
+
+  if (!file) {
+    return 0;
+  }
+
+  fseek(file, 0, SEEK_END);
+  long size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  uint8_t loaded = 0;
+
+  if (size > 0) {
+    uint8_t *buffer = malloc(size);
+
+    if (buffer && fread(buffer, 1, size, file) == (size_t) size) {
+      loaded = savestate_load(state, buffer, size);
+    }
+
+    free(buffer);
+  }
+
+  fclose(file);
+  return loaded;
+}
+#else
+uint8_t savestate_load_file(cpu_state *state, const char *path) {
+  int fd = open(path, O_RDONLY);
+
+  if (fd < 0) {
+    return 0;
+  }
+
+  struct stat file_stat;
+  uint8_t loaded = 0;
+
+  if (fstat(fd, &file_stat) == 0 && file_stat.st_size > 0 && file_stat.st_size <= UINT32_MAX) {
+    void *buffer = mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    if (buffer != MAP_FAILED) {
+      loaded = savestate_load(state, buffer, file_stat.st_size);
+      munmap(buffer, file_stat.st_size);
+    }
+  }
+
+  close(fd);
+  return loaded;
+}
+#endif
+
+// A control byte below 0x80 copies that many bytes plus one, from 0x80 on it repeats the next byte
+// SAVESTATE_MIN_RUN more times than its low bits say
+uint32_t savestate_rle_encode(const uint8_t *input, uint32_t size, uint8_t *output, uint32_t output_size) {
+  uint32_t written = 0;
+  uint32_t position = 0;
+
+  while (position < size) {
+    uint32_t start = position;
+
+    // Literals run up to the next three equal bytes
+    while (position < size && position - start < SAVESTATE_MAX_LITERAL &&
+           !(position + 2 < size && input[position] == input[position + 1] && input[position] == input[position + 2])) {
+      position++;
+    }
+
+    if (position > start) {
+      if (written + 1 + position - start > output_size) {
+        return 0;
+      }
+
+      output[written++] = position - start - 1;
+      memcpy(output + written, input + start, position - start);
+      written += position - start;
+    }
+
+    if (position + 2 < size && input[position] == input[position + 1] && input[position] == input[position + 2]) {
+      uint32_t run = SAVESTATE_MIN_RUN;
+
+      while (position + run < size && run < SAVESTATE_MAX_RUN && input[position + run] == input[position]) {
+        run++;
+      }
+
+      if (written + 2 > output_size) {
+        return 0;
+      }
+
+      output[written++] = 0x80 | (run - SAVESTATE_MIN_RUN);
+      output[written++] = input[position];
+      position += run;
+    }
+  }
+
+  return written;
+}
+
+uint32_t savestate_rle_decode(const uint8_t *input, uint32_t size, uint8_t *output, uint32_t output_size) {
+  uint32_t written = 0;
+  uint32_t position = 0;
+
+  while (position < size) {
+    uint8_t control = input[position++];
+
+    if (control < 0x80) {
+      uint32_t literal = control + 1;
+
+      if (position + literal > size || written + literal > output_size) {
+        return 0;
+      }
+
+      memcpy(output + written, input + position, literal);
+      position += literal;
+      written += literal;
+    } else {
+      uint32_t run = (control & 0x7F) + SAVESTATE_MIN_RUN;
+
+      if (position == size || written + run > output_size) {
+        return 0;
+      }
+
+      memset(output + written, input[position++], run);
+      written += run;
+    }
+  }
+
+  return written;
+}
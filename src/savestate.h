@@ -0,0 +1,63 @@
+#pragma once
+
+#include "cpu.h"
+#include "machine.h"
+
+// Snapshots of one machine: the registers, the interrupt state, the devices and the RAM, never the ROM. A state is
+// a header followed by the pages of RAM the map owns, so saving and loading are a few copies of 4 KiB and can run
+// every frame. Fields are in host byte order.
+
+#define SAVESTATE_MAGIC 0x30383038
+#define SAVESTATE_VERSION 1
+
+enum SavestateFlags {
+  // The pages are run-length encoded, see savestate_compress
+  SAVESTATE_COMPRESSED = 0x1,
+};
+
+typedef struct {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t flags;
+  // Pages of RAM that follow in ascending order, a state only loads into a map owning the same pages
+  uint32_t pages;
+  // Bytes after the header
+  uint32_t size;
+
+  uint64_t cycles;
+
+  uint16_t psw;
+  uint16_t bc;
+  uint16_t de;
+  uint16_t hl;
+  uint16_t sp;
+  uint16_t pc;
+
+  uint8_t interrupt_enable;
+  uint8_t interrupt;
+  uint8_t halted;
+
+  uint8_t shift_offset;
+  uint8_t shift0;
+  uint8_t shift1;
+  uint8_t keys[10];
+
+  uint8_t reserved[4];
+} savestate_header;
+
+// Bytes a state of this machine takes uncompressed
+uint32_t savestate_size(cpu_state *state);
+// Return the bytes written, 0 when the buffer is too small
+uint32_t savestate_save(cpu_state *state, uint8_t *buffer, uint32_t size);
+uint32_t savestate_compress(const uint8_t *buffer, uint32_t size, uint8_t *output, uint32_t output_size);
+// Takes both forms, returns 0 and leaves the machine alone when the state is not one of this version and layout
+uint8_t savestate_load(cpu_state *state, const uint8_t *buffer, uint32_t size);
+
+uint8_t savestate_write_file(const char *path, const uint8_t *buffer, uint32_t size);
+// Loads straight from a read-only mapping of the file
+uint8_t savestate_load_file(cpu_state *state, const char *path);
+
+// Runs of three or more equal bytes become two bytes, everything else is copied with one byte every 128. Return
+// the bytes written, 0 when the output is too small or the input is not a valid encoding
+uint32_t savestate_rle_encode(const uint8_t *input, uint32_t size, uint8_t *output, uint32_t output_size);
+uint32_t savestate_rle_decode(const uint8_t *input, uint32_t size, uint8_t *output, uint32_t output_size);
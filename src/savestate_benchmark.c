@@ -0,0 +1,123 @@
+#include "benchmark.h"
+#include "savestate.h"
+
+// Plays Space Invaders, saves a state halfway and checks that the second half replays identically from the plain
+// state, the compressed one and a file, then prints how long saving, compressing and loading take.
+// Usage: savestate_benchmark [frames] [iterations]
+
+#define SAVESTATE_FILE "savestate.tmp"
+
+void end_frame(void *context, cpu_state *state) {
+  *(uint8_t *) context = 1;
+  state->machine->running = 0;
+}
+
+// On the screen interrupts of the scheduler like the emulator, a frame ends right after its RST 2. A loaded state
+// schedules them again from its cycle counter
+void run_frames(cpu_state *state, uint32_t first, uint32_t last) {
+  uint8_t frame_ended;
+  cpu_set_frame_handler(state, end_frame, &frame_ended);
+
+  for (uint32_t frame = first; frame < last; frame++) {
+    benchmark_set_keys(state->machine, frame, BENCHMARK_COIN_FRAME, frame);
+
+    frame_ended = 0;
+    state->machine->running = 1;
+    cpu_start_emulation(state);
+
+    if (!frame_ended) {
+      exit(1);
+    }
+  }
+}
+
+uint8_t replays(cpu_state *state, const uint8_t *expected, uint32_t size, uint32_t first, uint32_t last) {
+  static uint8_t actual[0x20000];
+  run_frames(state, first, last);
+  return savestate_save(state, actual, sizeof(actual)) == size && !memcmp(actual, expected, size);
+}
+
+int main(int argc, char **argv) {
+  uint32_t frames = argc > 1 ? strtoul(argv[1], NULL, 0) : 1200;
+  uint32_t iterations = argc > 2 ? strtoul(argv[2], NULL, 0) : 100000;
+
+  uint32_t file_size;
+  char *file_buffer = benchmark_load_file("../roms/invaders.rom", 0, &file_size);
+
+  machine_state machine;
+  machine_init(&machine);
+  cpu_state state = cpu_init(&machine, file_buffer, file_size);
+  machine_map_memory(state.memory, machine_load_rom(state.memory->arena, (uint8_t *) file_buffer, file_size));
+  free(file_buffer);
+  cpu_start_video(&state);
+
+  uint32_t size = savestate_size(&state);
+  uint8_t *saved = malloc(size);
+  uint8_t *compressed = malloc(2 * size);
+  uint8_t *expected = malloc(size);
+  uint8_t *scratch = malloc(size);
+
+  run_frames(&state, 0, frames / 2);
+  savestate_save(&state, saved, size);
+  uint32_t compressed_size = savestate_compress(saved, size, compressed, 2 * size);
+
+  run_frames(&state, frames / 2, frames);
+  savestate_save(&state, expected, size);
+
+  uint8_t plain = savestate_load(&state, saved, size) && replays(&state, expected, size, frames / 2, frames);
+  uint8_t packed = savestate_load(&state, compressed, compressed_size) &&
+                   replays(&state, expected, size, frames / 2, frames);
+  uint8_t file = savestate_write_file(SAVESTATE_FILE, compressed, compressed_size) &&
+                 savestate_load_file(&state, SAVESTATE_FILE) && replays(&state, expected, size, frames / 2, frames);
+  remove(SAVESTATE_FILE);
+
+  double start_time = benchmark_wall_seconds();
+
+  for (uint32_t i = 0; i < iterations; i++) {
+    savestate_save(&state, scratch, size);
+  }
+
+  double save_seconds = benchmark_wall_seconds() - start_time;
+  start_time = benchmark_wall_seconds();
+
+  for (uint32_t i = 0; i < iterations; i++) {
+    compressed_size = savestate_compress(saved, size, compressed, 2 * size);
+  }
+
+  double compress_seconds = benchmark_wall_seconds() - start_time;
+  start_time = benchmark_wall_seconds();
+
+  uint32_t loads = 0;
+
+  // Alternating between the halfway and the last state, so every load writes the bytes that differ
+  for (uint32_t i = 0; i < iterations; i++) {
+    loads += savestate_load(&state, i & 1 ? saved : expected, size);
+  }
+
+  double load_seconds = benchmark_wall_seconds() - start_time;
+  start_time = benchmark_wall_seconds();
+
+  for (uint32_t i = 0; i < iterations; i++) {
+    loads += savestate_load(&state, i & 1 ? compressed : expected, i & 1 ? compressed_size : size);
+  }
+
+  double decompress_seconds = benchmark_wall_seconds() - start_time;
+
+  if (loads != 2 * iterations) {
+    printf("STATES DID NOT LOAD\n");
+    return 1;
+  }
+
+  printf("%u bytes, %u compressed | replays from state %s, compressed %s, file %s\n", size, compressed_size,
+         plain ? "ok" : "DIFFER", packed ? "ok" : "DIFFER", file ? "ok" : "DIFFER");
+  printf("save %.2f us | compress %.2f us | load %.2f us | load compressed %.2f us\n",
+         save_seconds / iterations * 1e6, compress_seconds / iterations * 1e6, load_seconds / iterations * 1e6,
+         decompress_seconds / iterations * 1e6);
+
+  free(saved);
+  free(compressed);
+  free(expected);
+  free(scratch);
+  cpu_destroy(&state);
+  return !(plain && packed && file);
+}
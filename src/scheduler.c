@@ -0,0 +1,98 @@
+#include "scheduler.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static uint8_t scheduler_before(const scheduler_event *first, const scheduler_event *second) {
+  return first->cycle < second->cycle || (first->cycle == second->cycle && first->order < second->order);
+}
+
+static void scheduler_swap(scheduler_state *scheduler, uint32_t first, uint32_t second) {
+  scheduler_event event = scheduler->events[first];
+  scheduler->events[first] = scheduler->events[second];
+  scheduler->events[second] = event;
+}
+
+static void scheduler_sift_up(scheduler_state *scheduler, uint32_t index) {
+  while (index && scheduler_before(&scheduler->events[index], &scheduler->events[(index - 1) / 2])) {
+    scheduler_swap(scheduler, index, (index - 1) / 2);
+    index = (index - 1) / 2;
+  }
+}
+
+static void scheduler_sift_down(scheduler_state *scheduler, uint32_t index) {
+  while (1) {
+    uint32_t first = index;
+    uint32_t left = 2 * index + 1;
+    uint32_t right = left + 1;
+
+    if (left < scheduler->count && scheduler_before(&scheduler->events[left], &scheduler->events[first])) {
+      first = left;
+    }
+
+    if (right < scheduler->count && scheduler_before(&scheduler->events[right], &scheduler->events[first])) {
+      first = right;
+    }
+
+    if (first == index) {
+      return;
+    }
+
+    scheduler_swap(scheduler, index, first);
+    index = first;
+  }
+}
+
+static scheduler_event scheduler_pop(scheduler_state *scheduler) {
+  scheduler_event event = scheduler->events[0];
+  scheduler->events[0] = scheduler->events[--scheduler->count];
+  scheduler_sift_down(scheduler, 0);
+  return event;
+}
+
+void scheduler_init(scheduler_state *scheduler) {
+  scheduler->count = 0;
+  scheduler->added = 0;
+  scheduler->fired = 0;
+}
+
+void scheduler_add(scheduler_state *scheduler, uint64_t cycle, scheduler_callback callback, void *context) {
+  if (scheduler->count == SCHEDULER_MAX_EVENTS) {
+    printf("TOO MANY SCHEDULED EVENTS\n");
+    exit(1);
+  }
+
+  scheduler_event *event = &scheduler->events[scheduler->count];
+  event->cycle = cycle;
+  event->order = scheduler->added++;
+  event->callback = callback;
+  event->context = context;
+  scheduler_sift_up(scheduler, scheduler->count++);
+}
+
+uint32_t scheduler_remove(scheduler_state *scheduler, scheduler_callback callback, void *context) {
+  uint32_t kept = 0;
+
+  for (uint32_t i = 0; i < scheduler->count; i++) {
+    if (scheduler->events[i].callback != callback || scheduler->events[i].context != context) {
+      scheduler->events[kept++] = scheduler->events[i];
+    }
+  }
+
+  uint32_t removed = scheduler->count - kept;
+  scheduler->count = kept;
+
+  for (uint32_t i = kept / 2; i-- > 0;) {
+    scheduler_sift_down(scheduler, i);
+  }
+
+  return removed;
+}
+
+void scheduler_run(scheduler_state *scheduler, uint64_t cycle) {
+  while (scheduler->count && scheduler->events[0].cycle <= cycle) {
+    scheduler_event event = scheduler_pop(scheduler);
+    scheduler->fired++;
+    event.callback(event.context, event.cycle);
+  }
+}
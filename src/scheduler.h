@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+
+// Events of one machine on guest time, kept in a min-heap by cycle. The emulation loop runs the CPU up to the
+// next event and fires every event that is due; events at the same cycle fire in the order they were added.
+// Callbacks may add events, periodic ones add themselves again.
+
+#define SCHEDULER_MAX_EVENTS 32
+#define SCHEDULER_NEVER UINT64_MAX
+
+typedef void (*scheduler_callback)(void *context, uint64_t cycle);
+
+typedef struct {
+  uint64_t cycle;
+  uint64_t order;
+  scheduler_callback callback;
+  void *context;
+} scheduler_event;
+
+typedef struct {
+  scheduler_event events[SCHEDULER_MAX_EVENTS];
+  uint32_t count;
+  uint64_t added;
+  uint64_t fired;
+} scheduler_state;
+
+void scheduler_init(scheduler_state *scheduler);
+void scheduler_add(scheduler_state *scheduler, uint64_t cycle, scheduler_callback callback, void *context);
+// Every pending event with this callback and context, returns how many there were
+uint32_t scheduler_remove(scheduler_state *scheduler, scheduler_callback callback, void *context);
+// Fires the events due at cycle in order, including the ones their callbacks add
+void scheduler_run(scheduler_state *scheduler, uint64_t cycle);
+
+static inline uint64_t scheduler_next(const scheduler_state *scheduler) {
+  return scheduler->count ? scheduler->events[0].cycle : SCHEDULER_NEVER;
+}